@@ -1,249 +1,1221 @@
-/*
- * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
- *
- * SPDX-License-Identifier: Apache-2.0
- */
-
-#include <stdio.h>
-#include <stdint.h>
-#include <stddef.h>
-#include <string.h>
-#include "esp_system.h"
-#include "nvs_flash.h"
-#include "esp_event.h"
-#include "esp_netif.h"
-#include "protocol_examples_common.h"
-#include "esp_log.h"
-#include "mqtt_client.h"
-#include "driver/gpio.h"
-
-// Configuration constants
-static const char *TAG = "mqtt5_dorra";
-static const char *MQTT_BROKER_URI = "mqtt://test.mosquitto.org";
-static const char *TOPIC_STATUS = "/dorra/status";
-static const char *TOPIC_CONTROL = "/dorra/control";
-
-// LED Configuration
-#define LED_GPIO_PIN    GPIO_NUM_2  // Built-in LED on most ESP32 boards
-#define LED_ON_LEVEL    1           // 1 for active high, 0 for active low
-
-// Message constants
-static const char *MSG_CONNECTED = "ESP Connected";
-static const char *MSG_DISCONNECTED = "ESP Disconnected";
-static const char *MSG_OPEN_RESPONSE = "it's open";
-static const char *MSG_CLOSE_RESPONSE = "it's closed";
-static const char *CMD_OPEN = "open";
-static const char *CMD_CLOSE = "close";
-
-// Function prototypes
-static void log_error_if_nonzero(const char *message, int error_code);
-static void led_init(void);
-static void led_set_state(bool state);
-static void mqtt5_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
-static void handle_mqtt_connected(esp_mqtt_client_handle_t client);
-static void handle_mqtt_data(esp_mqtt_event_handle_t event, esp_mqtt_client_handle_t client);
-static void process_control_message(const char *data, int data_len, esp_mqtt_client_handle_t client);
-static void mqtt5_app_start(void);
-
-/**
- * @brief Log error if error code is non-zero
- */
-static void log_error_if_nonzero(const char *message, int error_code)
-{
-    if (error_code != 0) {
-        ESP_LOGE(TAG, "Last error %s: 0x%x", message, error_code);
-    }
-}
-
-/**
- * @brief Initialize LED GPIO
- */
-static void led_init(void)
-{
-    gpio_config_t led_config = {
-        .pin_bit_mask = (1ULL << LED_GPIO_PIN),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE
-    };
-    
-    ESP_ERROR_CHECK(gpio_config(&led_config));
-    
-    // Initialize LED to OFF state
-    led_set_state(false);
-    ESP_LOGI(TAG, "LED initialized on GPIO %d", LED_GPIO_PIN);
-}
-
-/**
- * @brief Set LED state
- * @param state true to turn LED on, false to turn LED off
- */
-static void led_set_state(bool state)
-{
-    gpio_set_level(LED_GPIO_PIN, state ? LED_ON_LEVEL : !LED_ON_LEVEL);
-    ESP_LOGI(TAG, "LED turned %s", state ? "ON" : "OFF");
-}
-
-/**
- * @brief Handle MQTT connected event
- */
-static void handle_mqtt_connected(esp_mqtt_client_handle_t client)
-{
-    int msg_id;
-    
-    ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-    
-    // Send connection status message
-    msg_id = esp_mqtt_client_publish(client, TOPIC_STATUS, MSG_CONNECTED, 0, 1, 0);
-    ESP_LOGI(TAG, "Published connection message to %s, msg_id=%d", TOPIC_STATUS, msg_id);
-    
-    // Subscribe to control topic
-    msg_id = esp_mqtt_client_subscribe(client, TOPIC_CONTROL, 1);
-    ESP_LOGI(TAG, "Subscribed to %s, msg_id=%d", TOPIC_CONTROL, msg_id);
-}
-
-/**
- * @brief Process control messages and send appropriate responses
- */
-static void process_control_message(const char *data, int data_len, esp_mqtt_client_handle_t client)
-{
-    int msg_id;
-    
-    ESP_LOGI(TAG, "Processing control message: %.*s", data_len, data);
-    
-    if (strncmp(data, CMD_OPEN, data_len) == 0) {
-        ESP_LOGI(TAG, "Command: OPEN received");
-        
-        // Turn LED ON
-        led_set_state(true);
-        
-        // Send response
-        msg_id = esp_mqtt_client_publish(client, TOPIC_STATUS, MSG_OPEN_RESPONSE, 0, 1, 0);
-        ESP_LOGI(TAG, "Sent OPEN response: '%s', msg_id=%d", MSG_OPEN_RESPONSE, msg_id);
-    }
-    else if (strncmp(data, CMD_CLOSE, data_len) == 0) {
-        ESP_LOGI(TAG, "Command: CLOSE received");
-        
-        // Turn LED OFF
-        led_set_state(false);
-        
-        // Send response
-        msg_id = esp_mqtt_client_publish(client, TOPIC_STATUS, MSG_CLOSE_RESPONSE, 0, 1, 0);
-        ESP_LOGI(TAG, "Sent CLOSE response: '%s', msg_id=%d", MSG_CLOSE_RESPONSE, msg_id);
-    }
-    else {
-        ESP_LOGW(TAG, "Unknown command received: %.*s", data_len, data);
-    }
-}
-
-/**
- * @brief Handle MQTT data received event
- */
-static void handle_mqtt_data(esp_mqtt_event_handle_t event, esp_mqtt_client_handle_t client)
-{
-    ESP_LOGI(TAG, "MQTT_EVENT_DATA - Message received!");
-    ESP_LOGI(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
-    ESP_LOGI(TAG, "DATA=%.*s", event->data_len, event->data);
-    
-    // Process messages from control topic
-    if (strncmp(event->topic, TOPIC_CONTROL, event->topic_len) == 0) {
-        process_control_message(event->data, event->data_len, client);
-    }
-}
-
-/**
- * @brief Event handler registered to receive MQTT events
- */
-static void mqtt5_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
-{
-    ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%" PRIi32, base, event_id);
-    esp_mqtt_event_handle_t event = event_data;
-    esp_mqtt_client_handle_t client = event->client;
-
-    switch ((esp_mqtt_event_id_t)event_id) {
-    case MQTT_EVENT_CONNECTED:
-        handle_mqtt_connected(client);
-        break;
-        
-    case MQTT_EVENT_DISCONNECTED:
-        ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
-        break;
-        
-    case MQTT_EVENT_PUBLISHED:
-        ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
-        break;
-        
-    case MQTT_EVENT_SUBSCRIBED:
-        ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
-        break;
-        
-    case MQTT_EVENT_DATA:
-        handle_mqtt_data(event, client);
-        break;
-        
-    case MQTT_EVENT_ERROR:
-        ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
-        ESP_LOGI(TAG, "MQTT5 return code is %d", event->error_handle->connect_return_code);
-        if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
-            log_error_if_nonzero("reported from esp-tls", event->error_handle->esp_tls_last_esp_err);
-            log_error_if_nonzero("reported from tls stack", event->error_handle->esp_tls_stack_err);
-            log_error_if_nonzero("captured as transport's socket errno", event->error_handle->esp_transport_sock_errno);
-            ESP_LOGI(TAG, "Last errno string (%s)", strerror(event->error_handle->esp_transport_sock_errno));
-        }
-        break;
-        
-    default:
-        ESP_LOGI(TAG, "Other event id:%d", event->event_id);
-        break;
-    }
-}
-
-/**
- * @brief Initialize and start MQTT5 client
- */
-static void mqtt5_app_start(void)
-{
-    esp_mqtt_client_config_t mqtt5_cfg = {
-        .broker.address.uri = MQTT_BROKER_URI,
-        .session.protocol_ver = MQTT_PROTOCOL_V_5,
-        .network.disable_auto_reconnect = false,
-        .session.last_will.topic = TOPIC_STATUS,
-        .session.last_will.msg = MSG_DISCONNECTED,
-        .session.last_will.msg_len = strlen(MSG_DISCONNECTED),
-        .session.last_will.qos = 1,
-        .session.last_will.retain = true,
-    };
-
-    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt5_cfg);
-    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt5_event_handler, NULL);
-    esp_mqtt_client_start(client);
-}
-
-/**
- * @brief Main application entry point
- */
-void app_main(void)
-{
-    ESP_LOGI(TAG, "[APP] Startup..");
-    ESP_LOGI(TAG, "[APP] Free memory: %" PRIu32 " bytes", esp_get_free_heap_size());
-    ESP_LOGI(TAG, "[APP] IDF version: %s", esp_get_idf_version());
-
-    // Set log levels
-    esp_log_level_set("*", ESP_LOG_INFO);
-    esp_log_level_set("mqtt_client", ESP_LOG_VERBOSE);
-
-    // Initialize system components
-    ESP_ERROR_CHECK(nvs_flash_init());
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-
-    // Initialize LED
-    led_init();
-
-    // Connect to WiFi
-    ESP_ERROR_CHECK(example_connect());
-
-    // Start MQTT client
-    mqtt5_app_start();
+/*
+ * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "config.h"
+#include "door_cmd.h"
+#include "spsc_ring.h"
+#include "binlog.h"
+#include "mqtt_reasm.h"
+#include "latency.h"
+#include "door_fsm.h"
+#include "door_inputs.h"
+#include "sensors.h"
+#include "cmd_dedup.h"
+#include "door_payload.h"
+#include "cmd_cbor.h"
+#include "cmd_json.h"
+#include "task_layout.h"
+#include "telemetry.h"
+#include "outbox.h"
+#include "journal.h"
+
+// Configuration constants
+static const char *TAG = "mqtt5_dorra";
+static const char *MQTT_BROKER_URI = "mqtt://test.mosquitto.org";
+static const char *TOPIC_STATUS = "/dorra/status";
+static const char *TOPIC_CONTROL = "/dorra/control";
+static const char *TOPIC_METRICS = "/dorra/metrics";
+static const char *TOPIC_METRICS_REQUEST = "/dorra/metrics/get";
+static const char *TOPIC_DOOR_STATE = "/dorra/door/state";
+static const char *TOPIC_DIAG = "/dorra/diag";
+
+// MQTT5 topic aliases of the publish topics; the broker may alias our subscriptions too
+#if CONFIG_DOOR_MQTT_TOPIC_ALIASES
+#define TOPIC_ALIAS(alias)          (alias)
+#define MQTT_TOPIC_ALIAS_MAXIMUM    4
+#else
+#define TOPIC_ALIAS(alias)          0
+#define MQTT_TOPIC_ALIAS_MAXIMUM    0
+#endif
+#define TOPIC_ALIAS_STATUS          TOPIC_ALIAS(1)
+#define TOPIC_ALIAS_METRICS         TOPIC_ALIAS(2)
+#define TOPIC_ALIAS_DOOR_STATE      TOPIC_ALIAS(3)
+
+// LED Configuration: lit while the door is not closed
+#define LED_GPIO_PIN    2           // Built-in LED on most ESP32 boards
+#define LED_ON_LEVEL    1           // 1 for active high, 0 for active low
+
+// Control task configuration
+#define CONTROL_TASK_STACK_SIZE     4096
+#define CONTROL_QUEUE_LENGTH        16          // must be a power of two
+#define CONTROL_MSG_MAX_LEN         128         // room for integrator JSON
+#define CONTROL_RESPONSE_TOPIC_MAX_LEN  64
+#define CONTROL_CORRELATION_MAX_LEN     32
+#define METRICS_MSG_MAX_LEN         1024
+#define DOOR_METRICS_MAX_LEN        256
+#define SENSOR_METRICS_MAX_LEN      160
+#define CORE_METRICS_MAX_LEN        64
+#define COMMAND_METRICS_MAX_LEN     128
+#define MQTT_METRICS_MAX_LEN        96
+#define OUTBOX_METRICS_MAX_LEN      128
+#define COALESCE_WINDOW_US          ((int64_t)CONFIG_DOOR_CMD_COALESCE_MS * 1000)
+#define AUTO_CLOSE_RETRY_MS         1000        // hold-open expired with an obstacle in the way
+#define DOOR_STATE_MSG_MAX_LEN      64
+#define NVS_KEY_DOOR_STATE          "door_state"    // door_state_t | position_pct << 8
+#define BOOT_TIMELINE_MAX_LEN       256
+
+// Message constants
+#if CONFIG_DOOR_COMPACT_PAYLOADS
+#define COMPACT_PAYLOADS            true
+static const char *MSG_CONNECTED = DOOR_PAYLOAD_COMPACT_CONNECTED;
+static const char *MSG_DISCONNECTED = DOOR_PAYLOAD_COMPACT_DISCONNECTED;
+#else
+#define COMPACT_PAYLOADS            false
+static const char *MSG_CONNECTED = DOOR_PAYLOAD_CONNECTED;
+static const char *MSG_DISCONNECTED = DOOR_PAYLOAD_DISCONNECTED;
+#endif
+
+typedef void (*cmd_handler_t)(hal_mqtt_client_t *client);
+
+typedef enum {
+    CONTROL_MSG_COMMAND,        // payload from the control topic
+    CONTROL_MSG_METRICS,        // metrics request, answered from the control task that owns the counters
+    CONTROL_MSG_CONNECTED,      // connection status to publish, which the MQTT task must not do itself
+} control_msg_kind_t;
+
+// Control message copied out of the MQTT event for the control task
+typedef struct {
+    control_msg_kind_t kind;
+    hal_mqtt_client_t *client;
+    int64_t rx_time_us;
+    int len;
+    char data[CONTROL_MSG_MAX_LEN];
+    // MQTT5 request/response: reply on response_topic (status topic if empty)
+    char response_topic[CONTROL_RESPONSE_TOPIC_MAX_LEN + 1];
+    int correlation_data_len;
+    char correlation_data[CONTROL_CORRELATION_MAX_LEN];
+} control_msg_t;
+
+static control_msg_t s_control_slots[CONTROL_QUEUE_LENGTH];
+static spsc_ring_t s_control_queue;
+static hal_task_t *s_control_task;
+HAL_TASK_STORAGE(s_control_task_storage, CONTROL_TASK_STACK_SIZE);
+static uint32_t s_control_dropped;
+static hal_mqtt_client_t *_Atomic s_mqtt_client; // set once the client is started, read by the control task
+static bool s_obstacle;                     // control task only
+static const control_msg_t *s_cmd_msg;  // command being executed, control task only
+static const cmd_params_t *s_cmd_params;    // its parameters, control task only
+static int64_t s_cmd_rx_time_us;    // arrival time of the command being executed
+static int64_t s_cmd_dispatch_time_us;
+static int64_t s_data_rx_time_us;   // arrival of the current DATA message, MQTT task only
+
+// Open/close coalescing, control task only
+static control_msg_t s_held_cmd;    // latest intent waiting for the window to end
+static bool s_cmd_held;
+static int64_t s_coalesce_until_us; // no open/close is executed before this time
+static uint32_t s_cmds_executed;    // open, close and stop commands run
+static uint32_t s_cmds_superseded;  // dropped in favour of a later one
+static uint32_t s_cmds_malformed;   // CBOR or JSON payloads that failed to decode
+
+// Hold-open parameter, control task only: close again once the door has rested this long
+static uint32_t s_hold_ms;          // armed when the current move ends
+static int64_t s_auto_close_us;     // 0 when no close is scheduled
+
+// Reconnect timing, MQTT task only; the reported values are atomic as the metrics read them on the control task
+static bool s_mqtt_connected;
+static int64_t s_disconnected_us;   // start of the current outage, 0 while connected
+static int64_t s_reconnected_us;    // end of the last outage until its first command arrives
+static _Atomic uint32_t s_reconnects;
+static _Atomic uint32_t s_offline_ms;       // length of the last outage
+static _Atomic int32_t s_first_cmd_ms = -1; // reconnect to first command of the last outage
+static _Atomic uint32_t s_sessions_resumed; // reconnects that kept the subscriptions
+static int s_subscribe_msg_id;      // last subscription of this boot, -1 once acknowledged
+
+// Door state saved for the next boot, control task only
+static uint16_t s_saved_door_state = UINT16_MAX;
+
+// Boot timeline: end of each stage, 0 until reached
+typedef enum {
+    BOOT_BINLOG,
+    BOOT_STORAGE,
+    BOOT_CONTROL,
+    BOOT_NETIF,
+    BOOT_WIFI,
+    BOOT_MQTT_START,
+    BOOT_MQTT_CONNECTED,
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+static const char *const s_boot_stage_names[BOOT_STAGE_COUNT] = {
+    [BOOT_BINLOG] = "binlog",
+    [BOOT_STORAGE] = "nvs",
+    [BOOT_CONTROL] = "control",
+    [BOOT_NETIF] = "netif",
+    [BOOT_WIFI] = "wifi",
+    [BOOT_MQTT_START] = "mqtt_start",
+    [BOOT_MQTT_CONNECTED] = "mqtt_connect",
+};
+static int64_t s_boot_start_us;     // app_main entry
+static int64_t s_boot_us[BOOT_STAGE_COUNT];
+
+// Core load, sampled per metrics request
+static uint32_t s_core_idle_prev[HAL_CORE_COUNT];
+static int64_t s_core_sample_us;
+
+// Function prototypes
+static void log_error_if_nonzero(const char *message, int error_code);
+static void led_init(void);
+static void led_set_state(bool state);
+static void boot_mark(boot_stage_t stage);
+static void boot_log_timeline(void);
+static door_state_t door_state_restore(uint8_t *position_pct);
+static void door_state_save(door_state_t to);
+static void mqtt5_event_handler(const hal_mqtt_event_t *event, void *handler_args);
+static void handle_mqtt_connected(hal_mqtt_client_t *client, bool session_present);
+static bool topic_equals(const hal_mqtt_event_t *event, const char *topic);
+static void handle_mqtt_data(const hal_mqtt_event_t *event, void *arg);
+static void process_control_message(const char *data, int data_len, hal_mqtt_client_t *client);
+static int publish_response(hal_mqtt_client_t *client);
+static void publish_metrics(hal_mqtt_client_t *client);
+static void handle_cmd_open(hal_mqtt_client_t *client);
+static void handle_cmd_close(hal_mqtt_client_t *client);
+static void handle_cmd_stop(hal_mqtt_client_t *client);
+static void handle_cmd_status(hal_mqtt_client_t *client);
+static int handle_door_event(hal_mqtt_client_t *client, door_event_t event);
+static void door_state_changed(door_state_t from, door_state_t to, uint32_t dwell_ms, void *arg);
+static void handle_door_input(const door_input_event_t *input);
+static void end_move_at_limit(int64_t now_us);
+static void handle_sensor_event(const sensor_event_t *event);
+static bool door_post(door_event_t event, int64_t now_us);
+static bool door_post_target(door_event_t event, uint8_t target_pct, int64_t now_us);
+static uint32_t auto_close_poll_ms(int64_t now_us);
+static void control_queue_push(const hal_mqtt_event_t *event);
+static void control_queue_post(control_msg_kind_t kind, hal_mqtt_client_t *client);
+static void run_queued_message(const control_msg_t *msg);
+static void run_control_message(const control_msg_t *msg);
+static void coalesce_control_message(const control_msg_t *msg);
+static uint32_t coalesce_poll_ms(int64_t now_us);
+static void control_task(void *arg);
+static esp_err_t control_task_start(void);
+static void oversized_begin(const hal_mqtt_event_t *first, void *arg);
+static void oversized_chunk(const char *data, int len, int offset, void *arg);
+static void oversized_end(bool complete, void *arg);
+static void mqtt5_app_start(void);
+
+// Command handlers, indexed by door_cmd_t; NULL entries are not implemented yet
+static const cmd_handler_t s_cmd_handlers[DOOR_CMD_COUNT] = {
+    [DOOR_CMD_OPEN] = handle_cmd_open,
+    [DOOR_CMD_CLOSE] = handle_cmd_close,
+    [DOOR_CMD_STOP] = handle_cmd_stop,
+    [DOOR_CMD_STATUS] = handle_cmd_status,
+};
+
+// Manual override button: stop a moving door, otherwise move it the other way
+static const door_event_t s_override_events[DOOR_STATE_COUNT] = {
+    [DOOR_CLOSED] = DOOR_EVT_OPEN,
+    [DOOR_OPENING] = DOOR_EVT_STOP,
+    [DOOR_OPEN] = DOOR_EVT_CLOSE,
+    [DOOR_CLOSING] = DOOR_EVT_STOP,
+    [DOOR_STOPPED] = DOOR_EVT_OPEN,
+    [DOOR_FAULT] = DOOR_EVT_STOP,
+};
+
+// No consumer for large payloads yet: they are streamed through and discarded
+static const mqtt_reasm_sink_t s_oversized_sink = {
+    .begin = oversized_begin,
+    .chunk = oversized_chunk,
+    .end = oversized_end,
+};
+
+/**
+ * @brief Log error if error code is non-zero
+ */
+static void log_error_if_nonzero(const char *message, int error_code)
+{
+    if (error_code != 0) {
+        ESP_LOGE(TAG, "Last error %s: 0x%x", message, error_code);
+    }
+}
+
+/**
+ * @brief Initialize LED GPIO
+ */
+static void led_init(void)
+{
+    ESP_ERROR_CHECK(hal_gpio_config_output(LED_GPIO_PIN));
+    
+    // Initialize LED to OFF state
+    led_set_state(false);
+    ESP_LOGI(TAG, "LED initialized on GPIO %d", LED_GPIO_PIN);
+}
+
+/**
+ * @brief Set LED state
+ * @param state true to turn LED on, false to turn LED off
+ */
+static void led_set_state(bool state)
+{
+    hal_gpio_set_level(LED_GPIO_PIN, state ? LED_ON_LEVEL : !LED_ON_LEVEL);
+    BINLOG(LED_STATE, state);
+}
+
+/**
+ * @brief Handle MQTT connected event
+ *
+ * Subscribes unless the broker resumed a session in which this boot's
+ * subscriptions were acknowledged; a session left over from before a
+ * reboot may hold other topics, so the first connect always subscribes.
+ */
+static void handle_mqtt_connected(hal_mqtt_client_t *client, bool session_present)
+{
+    int msg_id;
+    
+    ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+    s_mqtt_connected = true;
+    if (s_boot_us[BOOT_MQTT_CONNECTED] == 0) {
+        boot_mark(BOOT_MQTT_CONNECTED);
+        boot_log_timeline();
+    }
+    if (s_disconnected_us != 0) {
+        int64_t now = hal_time_us();
+        s_reconnects++;
+        s_offline_ms = (uint32_t)((now - s_disconnected_us) / 1000);
+        s_reconnected_us = now;
+        s_disconnected_us = 0;
+        BINLOG(MQTT_RECONNECTED, s_offline_ms);
+    }
+    
+    // Send connection status message; the will may have replaced it during the outage
+    control_queue_post(CONTROL_MSG_CONNECTED, client);
+
+    // State changes recorded while offline follow
+    outbox_connected(client);
+
+    if (session_present && s_subscribe_msg_id < 0) {
+        // Commands queued by the broker during the outage follow without a subscribe round trip
+        s_sessions_resumed++;
+        ESP_LOGI(TAG, "Session resumed, subscriptions kept");
+        return;
+    }
+    
+    // Subscribe to control topic
+    int control_msg_id = hal_mqtt_subscribe(client, TOPIC_CONTROL, 1);
+    ESP_LOGI(TAG, "Subscribed to %s, msg_id=%d", TOPIC_CONTROL, control_msg_id);
+
+    // Subscribe to metrics requests
+    msg_id = hal_mqtt_subscribe(client, TOPIC_METRICS_REQUEST, 0);
+    ESP_LOGI(TAG, "Subscribed to %s, msg_id=%d", TOPIC_METRICS_REQUEST, msg_id);
+    // 0 matches no acknowledgement, so a failed subscribe is repeated on the next connect
+    s_subscribe_msg_id = control_msg_id > 0 && msg_id > 0 ? msg_id : 0;
+}
+
+/**
+ * @brief Queue the door state as response to the current command and track it for ack latency
+ *
+ * Goes to the command's MQTT5 response topic with its correlation data echoed
+ * when the requester supplied one, to the status topic (aliased) otherwise.
+ * @return Message id of the response
+ */
+static int publish_response(hal_mqtt_client_t *client)
+{
+    char response[DOOR_STATE_MSG_MAX_LEN];
+    door_state_t state = door_fsm_state();
+    int len = door_payload_reply(response, sizeof(response), COMPACT_PAYLOADS, state, door_state_name(state));
+
+    const char *topic = TOPIC_STATUS;
+    hal_mqtt_publish_props_t props = { .topic_alias = TOPIC_ALIAS_STATUS };
+    if (s_cmd_msg != NULL && s_cmd_msg->response_topic[0] != '\0') {
+        topic = s_cmd_msg->response_topic;
+        props.topic_alias = 0;
+        props.correlation_data = s_cmd_msg->correlation_data;
+        props.correlation_data_len = s_cmd_msg->correlation_data_len;
+    }
+    int msg_id = hal_mqtt_enqueue_with_props(client, topic, response, len, 1, 0, &props);
+    latency_ack_expect(msg_id, s_cmd_rx_time_us);
+    return msg_id;
+}
+
+/**
+ * @brief Busy time of each core since the previous call, in ppm
+ * @return false if the platform keeps no run-time statistics
+ */
+static bool core_load_sample(uint32_t busy_ppm[HAL_CORE_COUNT])
+{
+    int64_t now = hal_time_us();
+    uint32_t elapsed_us = (uint32_t)(now - s_core_sample_us);
+    s_core_sample_us = now;
+
+    for (int core = 0; core < HAL_CORE_COUNT; core++) {
+        uint32_t idle;
+        if (!hal_core_idle_us(core, &idle)) {
+            return false;
+        }
+        // Unsigned differences survive a wrap of the idle counter
+        uint32_t idle_us = idle - s_core_idle_prev[core];
+        s_core_idle_prev[core] = idle;
+        busy_ppm[core] = idle_us >= elapsed_us ? 0 :
+                         (uint32_t)((uint64_t)(elapsed_us - idle_us) * 1000000 / elapsed_us);
+    }
+    return true;
+}
+
+/**
+ * @brief Render core load since the previous metrics request: {"load_ppm":[..]}, or null
+ */
+static void format_core_load(char *buf, size_t size)
+{
+    uint32_t busy_ppm[HAL_CORE_COUNT];
+    if (!core_load_sample(busy_ppm)) {
+        snprintf(buf, size, "null");
+        return;
+    }
+    int len = snprintf(buf, size, "{\"load_ppm\":[");
+    for (int core = 0; core < HAL_CORE_COUNT; core++) {
+        len += snprintf(buf + len, size - len, "%s%" PRIu32, core ? "," : "", busy_ppm[core]);
+    }
+    snprintf(buf + len, size - len, "]}");
+}
+
+/**
+ * @brief Publish latency histograms and door timings on the metrics topic; control task only
+ *
+ * The histograms and timings are read by the task that records them and the
+ * sensor statistics are copied under the sensor task's core lock, so a report
+ * is never taken in the middle of an update.
+ */
+static void publish_metrics(hal_mqtt_client_t *client)
+{
+    // Static: keeps the report off the control task stack
+    static char latency[METRICS_MSG_MAX_LEN];
+    static char door[DOOR_METRICS_MAX_LEN];
+    static char sensor[SENSOR_METRICS_MAX_LEN];
+    static char commands[COMMAND_METRICS_MAX_LEN];
+    static char cores[CORE_METRICS_MAX_LEN];
+    static char mqtt[MQTT_METRICS_MAX_LEN];
+    static char outbox[OUTBOX_METRICS_MAX_LEN];
+    static char payload[METRICS_MSG_MAX_LEN];
+    int latency_len = latency_format_json(latency, sizeof(latency));
+    int door_len = door_fsm_format_json(door, sizeof(door));
+    int sensor_len = sensors_format_json(sensor, sizeof(sensor));
+    snprintf(commands, sizeof(commands),
+             "{\"window_ms\":%d,\"executed\":%" PRIu32 ",\"superseded\":%" PRIu32 ",\"queue_full\":%" PRIu32
+             ",\"duplicates\":%" PRIu32 ",\"malformed\":%" PRIu32 "}",
+             CONFIG_DOOR_CMD_COALESCE_MS, s_cmds_executed, s_cmds_superseded, s_control_dropped,
+             cmd_dedup_suppressed(), s_cmds_malformed);
+    format_core_load(cores, sizeof(cores));
+    snprintf(mqtt, sizeof(mqtt), "{\"reconnects\":%" PRIu32 ",\"resumed\":%" PRIu32 ",\"offline_ms\":%" PRIu32
+             ",\"first_cmd_ms\":%" PRId32 "}", s_reconnects, s_sessions_resumed, s_offline_ms, s_first_cmd_ms);
+    int outbox_len = outbox_format_json(outbox, sizeof(outbox));
+    int len = -1;
+    if (latency_len > 0 && door_len > 0 && sensor_len > 0 && outbox_len > 0) {
+        // Door timings, sensing cost, command counters, core load, reconnects and the offline outbox
+        // become members of the latency object
+        len = snprintf(payload, sizeof(payload),
+                       "%.*s,\"door\":%s,\"sensor\":%s,\"commands\":%s,\"cores\":%s,\"mqtt\":%s,\"outbox\":%s}",
+                       latency_len - 1, latency, door, sensor, commands, cores, mqtt, outbox);
+        if (len >= (int)sizeof(payload)) {
+            len = -1;
+        }
+    }
+    if (len < 0) {
+        ESP_LOGE(TAG, "Metrics payload does not fit in %d bytes", METRICS_MSG_MAX_LEN);
+        return;
+    }
+    hal_mqtt_publish_props_t props = { .topic_alias = TOPIC_ALIAS_METRICS };
+    int msg_id = hal_mqtt_enqueue_with_props(client, TOPIC_METRICS, payload, len, 0, 0, &props);
+    ESP_LOGI(TAG, "Published metrics, msg_id=%d", msg_id);
+}
+
+/**
+ * @brief Record the end of a boot stage
+ */
+static void boot_mark(boot_stage_t stage)
+{
+    s_boot_us[stage] = hal_time_us();
+}
+
+/**
+ * @brief Log how long each boot stage took, and when the door became controllable and connected
+ */
+static void boot_log_timeline(void)
+{
+    char line[BOOT_TIMELINE_MAX_LEN];
+    int len = 0;
+    int64_t prev_us = s_boot_start_us;
+    for (int i = 0; i < BOOT_STAGE_COUNT && len < (int)sizeof(line); i++) {
+        int64_t us = s_boot_us[i] - prev_us;
+        len += snprintf(line + len, sizeof(line) - len, "%s%s %" PRId64 ".%" PRId64 " ms", i ? ", " : "",
+                        s_boot_stage_names[i], us / 1000, us % 1000 / 100);
+        prev_us = s_boot_us[i];
+    }
+    ESP_LOGI(TAG, "Boot timeline: %s", line);
+    ESP_LOGI(TAG, "Boot: local control after %" PRId64 " ms, connected after %" PRId64 " ms (app_main at %" PRId64 " ms)",
+             (s_boot_us[BOOT_CONTROL] - s_boot_start_us) / 1000, (s_boot_us[BOOT_MQTT_CONNECTED] - s_boot_start_us) / 1000,
+             s_boot_start_us / 1000);
+}
+
+/**
+ * @brief Door state at boot: a latched fault, then the limit switches, then the state saved before the reset
+ */
+static door_state_t door_state_restore(uint8_t *position_pct)
+{
+    // Without limit switches or a saved state the door can only be assumed closed
+    door_state_t state = DOOR_CLOSED;
+    *position_pct = 0;
+    uint16_t saved;
+    if (hal_nvs_get_u16(NVS_KEY_DOOR_STATE, &saved) == ESP_OK && (saved & 0xFF) < DOOR_STATE_COUNT) {
+        s_saved_door_state = saved;
+        state = (door_state_t)(saved & 0xFF);
+        *position_pct = (uint8_t)(saved >> 8);
+        ESP_LOGI(TAG, "Saved door state %s at %u %%", door_state_name(state), *position_pct);
+    }
+    if (state == DOOR_FAULT) {
+        // Stays latched across a reset until acknowledged with stop
+        return state;
+    }
+#if CONFIG_DOOR_LIMIT_SWITCHES
+    if (door_input_active(DOOR_INPUT_LIMIT_CLOSED)) {
+        return DOOR_CLOSED;
+    }
+    if (door_input_active(DOOR_INPUT_LIMIT_OPEN)) {
+        return DOOR_OPEN;
+    }
+    // Neither switch: somewhere in between, near the end the saved state names
+    *position_pct = state == DOOR_OPEN ? 100 : state == DOOR_CLOSED ? 0 : *position_pct;
+    state = DOOR_STOPPED;
+#endif
+    return state;
+}
+
+/**
+ * @brief Save the door state for the next boot; a moving door counts as stopped where it started
+ *
+ * Two NVS writes per move, from the control task.
+ */
+static void door_state_save(door_state_t to)
+{
+    door_state_t state = to == DOOR_OPENING || to == DOOR_CLOSING ? DOOR_STOPPED : to;
+    uint16_t value = (uint16_t)(state | door_fsm_position_pct(hal_time_us()) << 8);
+    if (value != s_saved_door_state && hal_nvs_set_u16(NVS_KEY_DOOR_STATE, value) == ESP_OK) {
+        s_saved_door_state = value;
+    }
+}
+
+/**
+ * @brief Publish a door state change (retained) and mirror it on the LED
+ */
+static void door_state_changed(door_state_t from, door_state_t to, uint32_t dwell_ms, void *arg)
+{
+    led_set_state(to != DOOR_CLOSED);
+    journal_append(JOURNAL_STATE, (uint8_t)(from << 4 | to), dwell_ms);
+    door_state_save(to);
+    if ((to == DOOR_OPEN || to == DOOR_STOPPED) && s_hold_ms != 0) {
+        // The move that asked for a hold has ended
+        s_auto_close_us = hal_time_us() + (int64_t)s_hold_ms * 1000;
+        s_hold_ms = 0;
+    } else if (to == DOOR_CLOSED || to == DOOR_FAULT) {
+        s_hold_ms = 0;
+        s_auto_close_us = 0;
+    }
+    hal_mqtt_client_t *client = atomic_load_explicit(&s_mqtt_client, memory_order_acquire);
+    bool offline = outbox_active();
+    if (client == NULL && !offline) {
+        return;
+    }
+
+    char payload[DOOR_STATE_MSG_MAX_LEN];
+    int len = door_payload_transition(payload, sizeof(payload), COMPACT_PAYLOADS, from, to,
+                                      door_state_name(from), door_state_name(to), dwell_ms);
+    if (offline) {
+        // Kept in flash and delivered in order once the broker is back
+        if (!outbox_post(TOPIC_DOOR_STATE, payload, len, true)) {
+            ESP_LOGW(TAG, "Outbox full, state change to %s not recorded", door_state_name(to));
+        }
+        return;
+    }
+    hal_mqtt_publish_props_t props = { .topic_alias = TOPIC_ALIAS_DOOR_STATE };
+    hal_mqtt_enqueue_with_props(client, TOPIC_DOOR_STATE, payload, len, 1, 1, &props);
+}
+
+/**
+ * @brief Post an event to the door state machine, refusing to close onto an obstacle
+ *
+ * Cancels any hold-open in progress.
+ * @param target_pct Percent open to stop at, 0 or 100 for full travel
+ * @return true if the state changed
+ */
+static bool door_post_target(door_event_t event, uint8_t target_pct, int64_t now_us)
+{
+    s_hold_ms = 0;
+    s_auto_close_us = 0;
+    if (event == DOOR_EVT_CLOSE && s_obstacle) {
+        ESP_LOGW(TAG, "Obstacle in the doorway, not closing");
+        return false;
+    }
+    return door_fsm_post_target(event, target_pct, now_us);
+}
+
+/**
+ * @brief door_post_target() with full travel
+ */
+static bool door_post(door_event_t event, int64_t now_us)
+{
+    return door_post_target(event, 100, now_us);
+}
+
+/**
+ * @brief Close the door when a hold-open has expired
+ * @return Milliseconds until the next check, HAL_WAIT_FOREVER if none is scheduled
+ */
+static uint32_t auto_close_poll_ms(int64_t now_us)
+{
+    if (s_auto_close_us == 0) {
+        return HAL_WAIT_FOREVER;
+    }
+    if (now_us < s_auto_close_us) {
+        return (uint32_t)((s_auto_close_us - now_us + 999) / 1000);
+    }
+    if (!door_post(DOOR_EVT_CLOSE, now_us) && s_obstacle) {
+        s_auto_close_us = now_us + AUTO_CLOSE_RETRY_MS * 1000;
+        return AUTO_CLOSE_RETRY_MS;
+    }
+    return HAL_WAIT_FOREVER;
+}
+
+/**
+ * @brief Feed a command to the door state machine and answer with the resulting state
+ *
+ * A position parameter turns open/close into a move to that position; a
+ * hold parameter closes the door again once it has rested that long.
+ * @return Message id of the response
+ */
+static int handle_door_event(hal_mqtt_client_t *client, door_event_t event)
+{
+    const cmd_params_t *params = s_cmd_params;
+    uint8_t target_pct = 100;
+    bool move = true;
+    if (params != NULL && (params->fields & CMD_PARAM_POSITION) && event != DOOR_EVT_STOP) {
+        uint8_t position_pct = door_fsm_position_pct(hal_time_us());
+        target_pct = params->position_pct;
+        event = target_pct > position_pct ? DOOR_EVT_OPEN : DOOR_EVT_CLOSE;
+        move = target_pct != position_pct || door_fsm_state() == DOOR_OPENING || door_fsm_state() == DOOR_CLOSING;
+    }
+    if (params != NULL && (params->fields & CMD_PARAM_SPEED) && params->speed_pct != 100) {
+        ESP_LOGD(TAG, "Relay drive runs at full speed, speed %u%% ignored", params->speed_pct);
+    }
+
+    if (move && door_post_target(event, target_pct, hal_time_us())) {
+        // The transition drove the relays synchronously
+        int64_t now = hal_time_us();
+        latency_record(LATENCY_DISPATCH_TO_GPIO, s_cmd_dispatch_time_us, now);
+        latency_record(LATENCY_RX_TO_GPIO, s_cmd_rx_time_us, now);
+        BINLOG(GPIO_LATENCY, now - s_cmd_rx_time_us);
+    }
+
+    if (params != NULL && params->hold_ms != 0 && event != DOOR_EVT_STOP) {
+        door_state_t state = door_fsm_state();
+        if (state == DOOR_OPENING || state == DOOR_CLOSING) {
+            s_hold_ms = params->hold_ms;
+        } else if (state == DOOR_OPEN || state == DOOR_STOPPED) {
+            s_auto_close_us = hal_time_us() + (int64_t)params->hold_ms * 1000;
+        }
+    }
+    return publish_response(client);
+}
+
+/**
+ * @brief Act on a debounced limit switch or override button change
+ */
+static void handle_door_input(const door_input_event_t *input)
+{
+    int64_t now = hal_time_us();
+    BINLOG(DOOR_INPUT, input->input, input->active, now - input->time_us);
+    if (!input->active) {
+        return;
+    }
+
+    switch (input->input) {
+    case DOOR_INPUT_LIMIT_OPEN:
+    case DOOR_INPUT_LIMIT_CLOSED:
+        if (door_input_active(DOOR_INPUT_LIMIT_OPEN) && door_input_active(DOOR_INPUT_LIMIT_CLOSED)) {
+            ESP_LOGW(TAG, "Both limit switches active");
+            door_fsm_post(DOOR_EVT_FAULT, now);
+        } else if (door_fsm_post(input->input == DOOR_INPUT_LIMIT_OPEN ?
+                                 DOOR_EVT_REACHED_OPEN : DOOR_EVT_REACHED_CLOSED, now)) {
+            latency_record(LATENCY_LIMIT_TO_STOP, input->time_us, hal_time_us());
+        }
+        break;
+    case DOOR_INPUT_OVERRIDE:
+        door_post(s_override_events[door_fsm_state()], now);
+        break;
+    }
+}
+
+/**
+ * @brief End a move that starts with the limit switch ahead of it already active
+ *
+ * A door reversed before its leaf left that switch gets no edge from it, and
+ * would run on into the travel timeout.
+ */
+static void end_move_at_limit(int64_t now_us)
+{
+    door_state_t state = door_fsm_state();
+    if (state == DOOR_OPENING && door_input_active(DOOR_INPUT_LIMIT_OPEN)) {
+        door_fsm_post(DOOR_EVT_REACHED_OPEN, now_us);
+    } else if (state == DOOR_CLOSING && door_input_active(DOOR_INPUT_LIMIT_CLOSED)) {
+        door_fsm_post(DOOR_EVT_REACHED_CLOSED, now_us);
+    }
+}
+
+/**
+ * @brief Track the obstacle state and reverse a closing door
+ */
+static void handle_sensor_event(const sensor_event_t *event)
+{
+    s_obstacle = event->obstacle;
+    if (event->obstacle && door_fsm_post(DOOR_EVT_OBSTACLE, hal_time_us())) {
+        ESP_LOGW(TAG, "Obstacle at %" PRIu32 " mm, reopening", event->distance_mm);
+        journal_append(JOURNAL_OBSTRUCTION, door_fsm_state(), event->distance_mm);
+    }
+}
+
+/**
+ * @brief Handle "open": start opening (reverses a closing door)
+ */
+static void handle_cmd_open(hal_mqtt_client_t *client)
+{
+    BINLOG(CMD_OPEN);
+    int msg_id = handle_door_event(client, DOOR_EVT_OPEN);
+    BINLOG(RESP_OPEN, msg_id);
+}
+
+/**
+ * @brief Handle "close": start closing (reverses an opening door)
+ */
+static void handle_cmd_close(hal_mqtt_client_t *client)
+{
+    BINLOG(CMD_CLOSE);
+    int msg_id = handle_door_event(client, DOOR_EVT_CLOSE);
+    BINLOG(RESP_CLOSE, msg_id);
+}
+
+/**
+ * @brief Handle "stop": halt the motor, or acknowledge a fault
+ */
+static void handle_cmd_stop(hal_mqtt_client_t *client)
+{
+    BINLOG(CMD_STOP);
+    int msg_id = handle_door_event(client, DOOR_EVT_STOP);
+    BINLOG(RESP_STOP, msg_id);
+}
+
+/**
+ * @brief Handle "status": report current state without actuating
+ */
+static void handle_cmd_status(hal_mqtt_client_t *client)
+{
+    int msg_id = publish_response(client);
+    BINLOG(RESP_STATUS, msg_id);
+}
+
+/**
+ * @brief Decode a control payload: CBOR map or JSON object with parameters, or ASCII keyword
+ * @return false if a CBOR payload is malformed
+ */
+static bool decode_control_message(const char *data, int len, cmd_params_t *params)
+{
+    if (cmd_cbor_detect(data, len)) {
+        return cmd_cbor_decode(data, len, params);
+    }
+    if (cmd_json_detect(data, len)) {
+        return cmd_json_decode(data, len, params);
+    }
+    memset(params, 0, sizeof(*params));
+    params->cmd = door_cmd_lookup(data, len);
+    return true;
+}
+
+/**
+ * @brief Command of a queued message, DOOR_CMD_UNKNOWN if it does not decode
+ */
+static door_cmd_t control_msg_cmd(const control_msg_t *msg)
+{
+    cmd_params_t params;
+    return decode_control_message(msg->data, msg->len, &params) ? params.cmd : DOOR_CMD_UNKNOWN;
+}
+
+/**
+ * @brief Process control messages and send appropriate responses
+ */
+static void process_control_message(const char *data, int data_len, hal_mqtt_client_t *client)
+{
+    BINLOG(CTRL_MSG, data_len);
+
+    cmd_params_t params;
+    if (!decode_control_message(data, data_len, &params)) {
+        s_cmds_malformed++;
+        ESP_LOGW(TAG, "Malformed command payload (%d bytes)", data_len);
+        return;
+    }
+    door_cmd_t cmd = params.cmd;
+    if (cmd == DOOR_CMD_UNKNOWN) {
+        ESP_LOGW(TAG, "Unknown command received: %.*s", data_len, data);
+        return;
+    }
+    if (s_cmd_handlers[cmd] == NULL) {
+        ESP_LOGW(TAG, "Command '%s' not supported yet", door_cmd_name(cmd));
+        return;
+    }
+    if (params.fields != 0) {
+        BINLOG(CMD_PARAMS, cmd, params.fields, params.position_pct, params.hold_ms);
+    }
+    if (params.fields & CMD_PARAM_REQUESTER) {
+        ESP_LOGD(TAG, "'%s' requested by %.*s", door_cmd_name(cmd), params.requester_len, params.requester);
+    }
+    s_cmd_params = &params;
+    s_cmd_handlers[cmd](client);
+    s_cmd_params = NULL;
+}
+
+/**
+ * @brief Execute one queued command with its timing context
+ */
+static void run_control_message(const control_msg_t *msg)
+{
+    s_cmd_msg = msg;
+    s_cmd_rx_time_us = msg->rx_time_us;
+    s_cmd_dispatch_time_us = hal_time_us();
+    latency_record(LATENCY_RX_TO_DISPATCH, s_cmd_rx_time_us, s_cmd_dispatch_time_us);
+    process_control_message(msg->data, msg->len, msg->client);
+    s_cmd_msg = NULL;
+}
+
+/**
+ * @brief Collapse bursts of open/close commands to the latest intent
+ *
+ * An open or close arriving within CONFIG_DOOR_CMD_COALESCE_MS of the last
+ * one executed is held instead of run; a later command replaces it and only
+ * the survivor actuates and is answered when the window ends, so a toggle
+ * storm moves the relays at most once per window. A lone command runs
+ * without delay. Stop is never held and discards a held command.
+ */
+static void coalesce_control_message(const control_msg_t *msg)
+{
+    door_cmd_t cmd = control_msg_cmd(msg);
+    if (cmd != DOOR_CMD_OPEN && cmd != DOOR_CMD_CLOSE && cmd != DOOR_CMD_STOP) {
+        run_control_message(msg);
+        return;
+    }
+    if (s_cmd_held) {
+        s_cmds_superseded++;
+        BINLOG(CMD_SUPERSEDED, control_msg_cmd(&s_held_cmd), cmd);
+        s_cmd_held = false;
+    }
+    if (cmd == DOOR_CMD_STOP || hal_time_us() >= s_coalesce_until_us) {
+        s_cmds_executed++;
+        run_control_message(msg);
+        s_coalesce_until_us = hal_time_us() + COALESCE_WINDOW_US;
+    } else {
+        // The ring slot is reused, so the held command is copied out
+        s_held_cmd = *msg;
+        s_cmd_held = true;
+    }
+}
+
+/**
+ * @brief Run the held command once its window has ended
+ * @return Milliseconds until it is due, HAL_WAIT_FOREVER if none is held
+ */
+static uint32_t coalesce_poll_ms(int64_t now_us)
+{
+    if (!s_cmd_held) {
+        return HAL_WAIT_FOREVER;
+    }
+    if (now_us < s_coalesce_until_us) {
+        return (uint32_t)((s_coalesce_until_us - now_us + 999) / 1000);
+    }
+    s_cmd_held = false;
+    s_cmds_executed++;
+    run_control_message(&s_held_cmd);
+    s_coalesce_until_us = hal_time_us() + COALESCE_WINDOW_US;
+    return HAL_WAIT_FOREVER;
+}
+
+/**
+ * @brief Copy a control message into the control queue and wake the control task
+ *
+ * Runs in the MQTT task; never blocks so the client can keep receiving.
+ */
+static void control_queue_push(const hal_mqtt_event_t *event)
+{
+    if (event->data_len > CONTROL_MSG_MAX_LEN) {
+        ESP_LOGW(TAG, "Control message too long (%d bytes), dropped", event->data_len);
+        return;
+    }
+    if (event->response_topic_len > CONTROL_RESPONSE_TOPIC_MAX_LEN ||
+        event->correlation_data_len > CONTROL_CORRELATION_MAX_LEN) {
+        ESP_LOGW(TAG, "Response topic or correlation data too long, dropped");
+        return;
+    }
+
+    control_msg_t *msg = spsc_ring_reserve(&s_control_queue);
+    if (msg == NULL) {
+        s_control_dropped++;
+        ESP_LOGW(TAG, "Control queue full, message dropped (%" PRIu32 " total)", s_control_dropped);
+        return;
+    }
+    if (cmd_dedup_seen(event)) {
+        // The slot is not committed and is reused by the next message
+        ESP_LOGW(TAG, "Redelivered command (msg_id=%d), suppressed", event->msg_id);
+        return;
+    }
+    msg->kind = CONTROL_MSG_COMMAND;
+    msg->client = event->client;
+    msg->rx_time_us = s_data_rx_time_us;
+    msg->len = event->data_len;
+    memcpy(msg->data, event->data, event->data_len);
+    msg->response_topic[0] = '\0';
+    if (event->response_topic != NULL) {
+        memcpy(msg->response_topic, event->response_topic, event->response_topic_len);
+        msg->response_topic[event->response_topic_len] = '\0';
+    }
+    msg->correlation_data_len = 0;
+    if (event->correlation_data != NULL) {
+        memcpy(msg->correlation_data, event->correlation_data, event->correlation_data_len);
+        msg->correlation_data_len = event->correlation_data_len;
+    }
+    spsc_ring_commit(&s_control_queue);
+
+    hal_task_notify(s_control_task);
+}
+
+/**
+ * @brief Queue a request without a payload for the control task; MQTT task, never blocks
+ */
+static void control_queue_post(control_msg_kind_t kind, hal_mqtt_client_t *client)
+{
+    control_msg_t *msg = spsc_ring_reserve(&s_control_queue);
+    if (msg == NULL) {
+        s_control_dropped++;
+        ESP_LOGW(TAG, "Control queue full, request dropped (%" PRIu32 " total)", s_control_dropped);
+        return;
+    }
+    msg->kind = kind;
+    msg->client = client;
+    msg->rx_time_us = hal_time_us();
+    msg->len = 0;
+    spsc_ring_commit(&s_control_queue);
+
+    hal_task_notify(s_control_task);
+}
+
+/**
+ * @brief Run one message taken from the control queue
+ */
+static void run_queued_message(const control_msg_t *msg)
+{
+    switch (msg->kind) {
+    case CONTROL_MSG_COMMAND:
+        coalesce_control_message(msg);
+        break;
+    case CONTROL_MSG_METRICS:
+        publish_metrics(msg->client);
+        break;
+    case CONTROL_MSG_CONNECTED: {
+        int msg_id = hal_mqtt_publish(msg->client, TOPIC_STATUS, MSG_CONNECTED, 0, 1, 0);
+        ESP_LOGI(TAG, "Published connection message to %s, msg_id=%d", TOPIC_STATUS, msg_id);
+        break;
+    }
+    }
+}
+
+/**
+ * @brief Control task: act on switch inputs, then queued commands and requests, and run the door and coalescing timers
+ */
+static void control_task(void *arg)
+{
+    for (;;) {
+        control_msg_t *msg;
+        door_input_event_t input;
+        // Inputs first: a limit switch must stop the motor before any command runs
+        while (door_inputs_next(hal_time_us(), &input)) {
+            handle_door_input(&input);
+        }
+        sensor_event_t sensor;
+        while (sensors_next(&sensor)) {
+            handle_sensor_event(&sensor);
+        }
+        latency_process_acks();
+        while ((msg = spsc_ring_peek(&s_control_queue)) != NULL) {
+            run_queued_message(msg);
+            spsc_ring_release(&s_control_queue);
+        }
+        int64_t now = hal_time_us();
+        uint32_t wait_ms = coalesce_poll_ms(now);
+        uint32_t close_ms = auto_close_poll_ms(hal_time_us());
+        // After everything that can start a move
+        end_move_at_limit(hal_time_us());
+        uint32_t fsm_ms = door_fsm_poll(hal_time_us());
+        uint32_t inputs_ms = door_inputs_poll_ms(now);
+        wait_ms = close_ms < wait_ms ? close_ms : wait_ms;
+        wait_ms = fsm_ms < wait_ms ? fsm_ms : wait_ms;
+        wait_ms = inputs_ms < wait_ms ? inputs_ms : wait_ms;
+        int64_t due_us = hal_time_us() + (int64_t)wait_ms * 1000;
+        if (!hal_task_wait_notify(wait_ms) && wait_ms != 0 && wait_ms != HAL_WAIT_FOREVER) {
+            // Woken by the deadline: how late the loop runs relay and travel timing
+            latency_record(LATENCY_TIMER_LATE, due_us, hal_time_us());
+        }
+    }
+}
+
+/**
+ * @brief door_inputs_init() for hal_run_on_core()
+ */
+static esp_err_t control_inputs_init(void *arg)
+{
+    return door_inputs_init();
+}
+
+/**
+ * @brief sensors_start() for hal_run_on_core()
+ */
+static esp_err_t control_sensors_start(void *consumer)
+{
+    return sensors_start(consumer);
+}
+
+/**
+ * @brief Start the door inputs and state machine, the control queue and its consumer task
+ *
+ * Inputs and sensor are set up on the control core so their interrupts are
+ * handled there, away from Wi-Fi (task_layout.h).
+ */
+static esp_err_t control_task_start(void)
+{
+    esp_err_t err = hal_run_on_core(TASK_CONTROL_CORE, control_inputs_init, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint8_t position_pct;
+    door_state_t initial = door_state_restore(&position_pct);
+    err = door_fsm_init(initial, position_pct, door_state_changed, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (journal_start(initial) != ESP_OK) {
+        ESP_LOGW(TAG, "Door event journal unavailable");
+    }
+    latency_init();
+    spsc_ring_init(&s_control_queue, s_control_slots, sizeof(control_msg_t), CONTROL_QUEUE_LENGTH);
+    s_control_task = hal_task_create_static(control_task, "door_ctrl", &s_control_task_storage, NULL,
+                                     TASK_CONTROL_PRIORITY, TASK_CONTROL_CORE);
+    if (s_control_task == NULL) {
+        return ESP_FAIL;
+    }
+    // Edges queued before the consumer was set are picked up on this wake-up
+    door_inputs_set_consumer(s_control_task);
+    hal_task_notify(s_control_task);
+    uint32_t busy_ppm[HAL_CORE_COUNT];
+    core_load_sample(busy_ppm);     // start of the first load interval
+    return hal_run_on_core(TASK_CONTROL_CORE, control_sensors_start, s_control_task);
+}
+
+/**
+ * @brief Oversized message sink: start of stream
+ */
+static void oversized_begin(const hal_mqtt_event_t *first, void *arg)
+{
+    ESP_LOGW(TAG, "Streaming %d byte message on %.*s to sink",
+             first->total_data_len, first->topic_len, first->topic);
+}
+
+/**
+ * @brief Oversized message sink: one fragment
+ */
+static void oversized_chunk(const char *data, int len, int offset, void *arg)
+{
+    ESP_LOGD(TAG, "Oversized fragment offset=%d len=%d", offset, len);
+}
+
+/**
+ * @brief Oversized message sink: end of stream
+ */
+static void oversized_end(bool complete, void *arg)
+{
+    ESP_LOGW(TAG, "Oversized message %s", complete ? "discarded" : "interrupted");
+}
+
+/**
+ * @brief Exact comparison of an event topic with a NUL-terminated topic
+ */
+static bool topic_equals(const hal_mqtt_event_t *event, const char *topic)
+{
+    return event->topic_len == (int)strlen(topic) &&
+           strncmp(event->topic, topic, event->topic_len) == 0;
+}
+
+/**
+ * @brief Handle a complete MQTT message (after reassembly)
+ */
+static void handle_mqtt_data(const hal_mqtt_event_t *event, void *arg)
+{
+    BINLOG(MQTT_DATA, event->topic_len, event->data_len);
+
+    // Process messages from control topic
+    if (topic_equals(event, TOPIC_CONTROL)) {
+        if (s_reconnected_us != 0) {
+            s_first_cmd_ms = (int32_t)((s_data_rx_time_us - s_reconnected_us) / 1000);
+            s_reconnected_us = 0;
+        }
+        control_queue_push(event);
+    }
+    else if (topic_equals(event, TOPIC_METRICS_REQUEST)) {
+        control_queue_post(CONTROL_MSG_METRICS, event->client);
+    }
+}
+
+/**
+ * @brief Event handler registered to receive MQTT events
+ */
+static void mqtt5_event_handler(const hal_mqtt_event_t *event, void *handler_args)
+{
+    hal_mqtt_client_t *client = event->client;
+
+    switch (event->event_id) {
+    case HAL_MQTT_EVENT_CONNECTED:
+        handle_mqtt_connected(client, event->session_present);
+        break;
+        
+    case HAL_MQTT_EVENT_DISCONNECTED:
+        ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+        // Failed reconnect attempts report DISCONNECTED too
+        if (s_mqtt_connected) {
+            s_mqtt_connected = false;
+            s_disconnected_us = hal_time_us();
+        }
+        mqtt_reasm_reset();
+        outbox_disconnected();
+        break;
+        
+    case HAL_MQTT_EVENT_PUBLISHED:
+        latency_ack_received(event->msg_id, hal_time_us());
+        outbox_published(event->msg_id);
+        hal_task_notify(s_control_task);
+        BINLOG(MQTT_PUBLISHED, event->msg_id);
+        break;
+        
+    case HAL_MQTT_EVENT_SUBSCRIBED:
+        ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+        if (event->msg_id == s_subscribe_msg_id) {
+            // Acknowledged in order, so every subscription of this boot is in place
+            s_subscribe_msg_id = -1;
+        }
+        break;
+        
+    case HAL_MQTT_EVENT_DATA:
+        if (event->current_data_offset == 0) {
+            s_data_rx_time_us = hal_time_us();
+        }
+        mqtt_reasm_feed(event);
+        break;
+        
+    case HAL_MQTT_EVENT_ERROR:
+        ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
+        ESP_LOGI(TAG, "MQTT5 return code is %d", event->connect_return_code);
+        if (event->transport_error) {
+            log_error_if_nonzero("reported from esp-tls", event->tls_last_err);
+            log_error_if_nonzero("reported from tls stack", event->tls_stack_err);
+            log_error_if_nonzero("captured as transport's socket errno", event->sock_errno);
+            ESP_LOGI(TAG, "Last errno string (%s)", strerror(event->sock_errno));
+        }
+        break;
+        
+    default:
+        ESP_LOGI(TAG, "Other event id:%d", event->raw_event_id);
+        break;
+    }
+}
+
+/**
+ * @brief Initialize and start MQTT5 client
+ */
+static void mqtt5_app_start(void)
+{
+    hal_mqtt_config_t mqtt5_cfg = {
+        .broker_uri = MQTT_BROKER_URI,
+        .lwt_topic = TOPIC_STATUS,
+        .lwt_msg = MSG_DISCONNECTED,
+        .lwt_qos = 1,
+        .lwt_retain = true,
+        .topic_alias_maximum = MQTT_TOPIC_ALIAS_MAXIMUM,
+        .session_expiry_s = CONFIG_DOOR_MQTT_SESSION_EXPIRY_S,
+        .reconnect_base_ms = CONFIG_DOOR_MQTT_BACKOFF_BASE_MS,
+        .reconnect_max_ms = CONFIG_DOOR_MQTT_BACKOFF_MAX_MS,
+    };
+
+    mqtt_reasm_init(handle_mqtt_data, &s_oversized_sink, NULL);
+    hal_mqtt_client_t *client = hal_mqtt_start(&mqtt5_cfg, mqtt5_event_handler, NULL);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "Failed to start MQTT client");
+    }
+    atomic_store_explicit(&s_mqtt_client, client, memory_order_release);
+}
+
+/**
+ * @brief Main application entry point
+ */
+void app_main(void)
+{
+    s_boot_start_us = hal_time_us();
+    ESP_LOGI(TAG, "[APP] Startup..");
+    ESP_LOGI(TAG, "[APP] Free memory: %" PRIu32 " bytes", hal_free_heap_size());
+    ESP_LOGI(TAG, "[APP] IDF version: %s", hal_platform_version());
+
+    // Set log levels
+    esp_log_level_set("*", ESP_LOG_INFO);
+    esp_log_level_set("mqtt_client", ESP_LOG_VERBOSE);
+
+    // Deferred logging first so the command path never formats on the console
+    ESP_ERROR_CHECK(binlog_start());
+    boot_mark(BOOT_BINLOG);
+
+    // NVS holds the last door state; the rest of the platform is only needed by the network
+    ESP_ERROR_CHECK(hal_storage_init());
+    boot_mark(BOOT_STORAGE);
+
+    // Initialize LED
+    led_init();
+
+    // Recover the offline outbox before the first door state change
+    ESP_ERROR_CHECK(outbox_start());
+
+    // Local control (buttons, limit switches, sensor) runs from here on, while the network comes up
+    ESP_ERROR_CHECK(control_task_start());
+    boot_mark(BOOT_CONTROL);
+
+    // Initialize netif and the default event loop
+    ESP_ERROR_CHECK(hal_platform_init());
+    boot_mark(BOOT_NETIF);
+
+    // Connect to WiFi
+    ESP_ERROR_CHECK(hal_network_connect());
+    boot_mark(BOOT_WIFI);
+
+    // Start MQTT client
+    mqtt5_app_start();
+    boot_mark(BOOT_MQTT_START);
+
+    // Periodic task and heap diagnostics
+    if (CONFIG_DOOR_DIAG_PERIOD_S > 0 && s_mqtt_client != NULL) {
+        ESP_ERROR_CHECK(telemetry_start(s_mqtt_client, TOPIC_DIAG));
+    }
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file backoff.h
+ * @brief Exponential reconnect backoff with full jitter
+ *
+ * The n-th consecutive failure waits a uniformly random time in
+ * [0, min(max_ms, base_ms * 2^n)]. Randomising the whole interval, rather
+ * than adding a little jitter to a fixed schedule, spreads a building full
+ * of doors that lost the broker at the same moment evenly over the window
+ * instead of having them retry in lockstep.
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t base_ms;       // ceiling of the first delay, non-zero
+    uint32_t max_ms;        // ceiling once doubled enough times
+    uint32_t ceiling_ms;    // of the next delay, 0 after a reset
+} backoff_t;
+
+/**
+ * @brief Start over with the base ceiling, e.g. once connected
+ */
+static inline void backoff_reset(backoff_t *backoff)
+{
+    backoff->ceiling_ms = 0;
+}
+
+/**
+ * @brief Delay before the next attempt; doubles the ceiling for the one after
+ * @param random Uniformly distributed 32-bit value
+ */
+static inline uint32_t backoff_next_ms(backoff_t *backoff, uint32_t random)
+{
+    uint32_t ceiling = backoff->ceiling_ms;
+    if (ceiling == 0) {
+        ceiling = backoff->base_ms < backoff->max_ms ? backoff->base_ms : backoff->max_ms;
+    }
+    backoff->ceiling_ms = ceiling > backoff->max_ms / 2 ? backoff->max_ms : ceiling * 2;
+    return (uint32_t)((uint64_t)random * ((uint64_t)ceiling + 1) >> 32);
+}
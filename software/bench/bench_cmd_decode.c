@@ -0,0 +1,237 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file bench_cmd_decode.c
+ * @brief Host benchmark: decode cost of an ASCII command keyword versus CBOR and JSON commands
+ *
+ * Decodes each payload the way process_control_message() does (door_cmd_lookup() for a
+ * keyword, cmd_cbor_decode() / cmd_json_decode() for a map) and reports ns per message and
+ * payload bytes. With -DBENCH_CJSON the JSON payloads are also parsed with cJSON into a tree
+ * and the same members extracted with the same checks, counting its heap allocations.
+ *
+ * Build and run:
+ *     cc -std=gnu11 -O2 -Isoftware software/door_cmd.c software/cmd_cbor.c software/cmd_json.c \
+ *        software/bench/bench_cmd_decode.c -o bench_cmd_decode
+ *     ./bench_cmd_decode [iterations]
+ * adding "-DBENCH_CJSON -I<cJSON dir> <cJSON dir>/cJSON.c" for the cJSON comparison (e.g. the
+ * copy in ESP-IDF components/json/cJSON).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cmd_cbor.h"
+#include "cmd_json.h"
+#if BENCH_CJSON
+#include "cJSON.h"
+#endif
+
+typedef enum {
+    FORMAT_ASCII,
+    FORMAT_CBOR,
+    FORMAT_JSON,
+    FORMAT_CJSON,
+} format_t;
+
+typedef struct {
+    const char *name;
+    const char *data;
+    int len;
+    format_t format;
+} payload_t;
+
+// {0: "open"}
+static const char s_cbor_cmd[] = "\xa1\x00\x64open";
+// {0: 0, 1: 50, 2: 80, 3: 10000, 4: "lobby-panel"}
+static const char s_cbor_full[] = "\xa5\x00\x00\x01\x18\x32\x02\x18\x50\x03\x19\x27\x10\x04\x6blobby-panel";
+static const char s_json_cmd[] = "{\"cmd\":\"open\",\"hold_s\":10}";
+static const char s_json_full[] = "{\"cmd\":\"open\",\"position\":50,\"speed\":80,\"hold_s\":10,"
+                                  "\"requester\":\"lobby-panel\",\"site\":{\"building\":3,\"zones\":[1,2]}}";
+
+static unsigned long s_allocs;
+
+#if BENCH_CJSON
+static void *counting_malloc(size_t size)
+{
+    s_allocs++;
+    return malloc(size);
+}
+
+/**
+ * @brief Value of a number member that is a non-negative integer up to max, as cmd_json.c requires
+ */
+static bool cjson_uint(const cJSON *item, double max, uint32_t *value)
+{
+    if (!cJSON_IsNumber(item) || item->valuedouble < 0 || item->valuedouble > max ||
+        item->valuedouble != (double)(uint32_t)item->valuedouble) {
+        return false;
+    }
+    *value = (uint32_t)item->valuedouble;
+    return true;
+}
+
+/**
+ * @brief Store the value of a known member with the checks of cmd_json.c
+ * @return false if it has the wrong type or is out of range
+ */
+static bool cjson_apply_member(const cJSON *item, cmd_params_t *params)
+{
+    uint32_t value;
+    int key;
+    if (strcmp(item->string, "cmd") == 0) {
+        if (!cJSON_IsString(item)) {
+            return false;
+        }
+        params->cmd = door_cmd_lookup(item->valuestring, strlen(item->valuestring));
+        return params->cmd != DOOR_CMD_UNKNOWN;
+    } else if (strcmp(item->string, "position") == 0) {
+        if (!cjson_uint(item, 100, &value)) {
+            return false;
+        }
+        params->position_pct = (uint8_t)value;
+        key = CMD_KEY_POSITION;
+    } else if (strcmp(item->string, "speed") == 0) {
+        if (!cjson_uint(item, 100, &value) || value < 1) {
+            return false;
+        }
+        params->speed_pct = (uint8_t)value;
+        key = CMD_KEY_SPEED;
+    } else if (strcmp(item->string, "hold_s") == 0) {
+        if (!cjson_uint(item, UINT32_MAX / 1000, &value)) {
+            return false;
+        }
+        params->hold_ms = value * 1000;
+        key = CMD_KEY_HOLD;
+    } else if (strcmp(item->string, "hold_ms") == 0) {
+        if (!cjson_uint(item, UINT32_MAX, &value)) {
+            return false;
+        }
+        params->hold_ms = value;
+        key = CMD_KEY_HOLD;
+    } else if (strcmp(item->string, "requester") == 0) {
+        if (!cJSON_IsString(item) || strlen(item->valuestring) > CMD_REQUESTER_MAX_LEN) {
+            return false;
+        }
+        params->requester = item->valuestring;
+        params->requester_len = (uint8_t)strlen(item->valuestring);
+        key = CMD_KEY_REQUESTER;
+    } else {
+        return true;
+    }
+    params->fields |= 1u << key;
+    return true;
+}
+
+/**
+ * @brief The same extraction as cmd_json_decode(), on a cJSON tree
+ *
+ * Members are applied in payload order, so a repeated one overrides as it does there.
+ * cJSON also takes integral numbers written with a fraction or exponent, which
+ * cmd_json.c rejects; the bench payloads have none.
+ * @return The tree, which params->requester points into and the caller deletes; NULL if rejected
+ */
+static cJSON *cjson_decode(const char *data, int len, cmd_params_t *params)
+{
+    memset(params, 0, sizeof(*params));
+    params->cmd = DOOR_CMD_UNKNOWN;
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!cJSON_IsObject(root)) {
+        cJSON_Delete(root);
+        return NULL;
+    }
+    const cJSON *item;
+    cJSON_ArrayForEach(item, root) {
+        if (!cjson_apply_member(item, params)) {
+            cJSON_Delete(root);
+            return NULL;
+        }
+    }
+    if (params->cmd == DOOR_CMD_UNKNOWN) {
+        cJSON_Delete(root);
+        return NULL;
+    }
+    return root;
+}
+#endif
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double run(const payload_t *payload, long iterations)
+{
+    volatile unsigned sink = 0;
+    int64_t start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        cmd_params_t params = { .cmd = DOOR_CMD_UNKNOWN };
+        bool ok = true;
+#if BENCH_CJSON
+        cJSON *tree = NULL;
+#endif
+        switch (payload->format) {
+        case FORMAT_ASCII:
+            params.cmd = door_cmd_lookup(payload->data, payload->len);
+            break;
+        case FORMAT_CBOR:
+            ok = cmd_cbor_decode(payload->data, payload->len, &params);
+            break;
+        case FORMAT_JSON:
+            ok = cmd_json_decode(payload->data, payload->len, &params);
+            break;
+        case FORMAT_CJSON:
+#if BENCH_CJSON
+            tree = cjson_decode(payload->data, payload->len, &params);
+            ok = tree != NULL;
+#endif
+            break;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s: decode failed\n", payload->name);
+            exit(1);
+        }
+        // Use every parameter, and the requester while the cJSON tree still holds it
+        sink += params.cmd + params.fields + params.position_pct + params.speed_pct + params.hold_ms;
+        sink += params.requester_len != 0 ? (unsigned char)params.requester[0] : 0;
+#if BENCH_CJSON
+        cJSON_Delete(tree);
+#endif
+    }
+    (void)sink;
+    return (double)(now_ns() - start) / iterations;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 10000000;
+    const payload_t payloads[] = {
+        { "ascii \"open\"", "open", 4, FORMAT_ASCII },
+        { "ascii \"status\"", "status", 6, FORMAT_ASCII },
+        { "cbor command only", s_cbor_cmd, sizeof(s_cbor_cmd) - 1, FORMAT_CBOR },
+        { "cbor all parameters", s_cbor_full, sizeof(s_cbor_full) - 1, FORMAT_CBOR },
+        { "json command, hold", s_json_cmd, sizeof(s_json_cmd) - 1, FORMAT_JSON },
+        { "json all, nested", s_json_full, sizeof(s_json_full) - 1, FORMAT_JSON },
+#if BENCH_CJSON
+        { "cJSON command, hold", s_json_cmd, sizeof(s_json_cmd) - 1, FORMAT_CJSON },
+        { "cJSON all, nested", s_json_full, sizeof(s_json_full) - 1, FORMAT_CJSON },
+#endif
+    };
+
+#if BENCH_CJSON
+    cJSON_Hooks hooks = { .malloc_fn = counting_malloc, .free_fn = free };
+    cJSON_InitHooks(&hooks);
+#endif
+    printf("%ld decodes per payload\n", iterations);
+    for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++) {
+        s_allocs = 0;
+        double ns = run(&payloads[i], iterations);
+        printf("%-22s %3d bytes  %6.1f ns/msg  %5.1f allocations/msg\n", payloads[i].name, payloads[i].len,
+               ns, (double)s_allocs / iterations);
+    }
+    return 0;
+}
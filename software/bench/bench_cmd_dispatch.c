@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file bench_cmd_dispatch.c
+ * @brief Host micro-benchmark: door_cmd_lookup() versus the legacy strncmp chain
+ *
+ * Build and run:
+ *     cc -std=gnu11 -O2 -Isoftware software/door_cmd.c software/bench/bench_cmd_dispatch.c -o bench_cmd_dispatch
+ *     ./bench_cmd_dispatch [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "door_cmd.h"
+
+static const char *const s_legacy_keywords[DOOR_CMD_COUNT] = {
+#define LEGACY_KEYWORD(id, keyword, first) [DOOR_CMD_##id] = keyword,
+    DOOR_CMD_TABLE(LEGACY_KEYWORD)
+#undef LEGACY_KEYWORD
+};
+
+// Mixed workload: every command, prefixes, near misses and garbage
+static const char *const s_payloads[] = {
+    "open", "close", "stop", "hold", "lock", "unlock", "status", "calibrate",
+    "op", "closed", "OPEN", "", "garbage-payload", "unlocked", "c", "stat",
+};
+
+#define PAYLOAD_COUNT (sizeof(s_payloads) / sizeof(s_payloads[0]))
+
+static volatile unsigned s_sink;
+
+/**
+ * @brief The pre-table dispatcher: strncmp against each keyword in turn
+ */
+static door_cmd_t legacy_lookup(const char *data, int len)
+{
+    for (int i = 0; i < DOOR_CMD_COUNT; i++) {
+        if (strncmp(data, s_legacy_keywords[i], len) == 0) {
+            return (door_cmd_t)i;
+        }
+    }
+    return DOOR_CMD_UNKNOWN;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double run(door_cmd_t (*lookup)(const char *, int), const int *lens, long iterations)
+{
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        unsigned k = (unsigned)i % PAYLOAD_COUNT;
+        s_sink += (unsigned)lookup(s_payloads[k], lens[k]);
+    }
+    return (now_ns() - start) / (double)iterations;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 50000000L;
+    int lens[PAYLOAD_COUNT];
+    int legacy_mismatches = 0;
+
+    for (unsigned k = 0; k < PAYLOAD_COUNT; k++) {
+        lens[k] = (int)strlen(s_payloads[k]);
+        if (legacy_lookup(s_payloads[k], lens[k]) != door_cmd_lookup(s_payloads[k], lens[k])) {
+            legacy_mismatches++;
+        }
+    }
+
+    // Warm up caches and branch predictors before timing
+    run(legacy_lookup, lens, iterations / 10);
+    run(door_cmd_lookup, lens, iterations / 10);
+
+    double legacy_ns = run(legacy_lookup, lens, iterations);
+    double table_ns = run(door_cmd_lookup, lens, iterations);
+
+    printf("payloads:           %zu (%d classified differently by the legacy chain)\n",
+           PAYLOAD_COUNT, legacy_mismatches);
+    printf("legacy strncmp:     %.2f ns/dispatch\n", legacy_ns);
+    printf("door_cmd_lookup:    %.2f ns/dispatch\n", table_ns);
+    printf("speedup:            %.2fx\n", legacy_ns / table_ns);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file bench_status_bytes.c
+ * @brief Host benchmark: bytes on the wire for status traffic, full topics and text versus
+ *        MQTT5 topic aliases and compact payloads
+ *
+ * Replays the publishes of a number of door cycles on one connection (connection message,
+ * then per cycle: open, close and status replies and four state changes) and counts the
+ * MQTT5 PUBLISH packet bytes, encoded with door_payload.h exactly as the firmware does.
+ * PUBACKs and TCP/IP headers are the same for every variant and not counted.
+ *
+ * Build and run:
+ *     cc -std=gnu11 -O2 -Isoftware software/bench/bench_status_bytes.c -o bench_status_bytes
+ *     ./bench_status_bytes [cycles]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "door_payload.h"
+
+#define TOPIC_STATUS        "/dorra/status"
+#define TOPIC_DOOR_STATE    "/dorra/door/state"
+#define TOPIC_ALIAS_COUNT   4           // per-topic "alias already sent" flags
+#define PROPERTY_TOPIC_ALIAS_LEN    3   // identifier 0x23 plus two-byte value
+
+// As door_state_name()
+static const char *const s_state_names[DOOR_STATE_COUNT] = {
+    "closed", "opening", "open", "closing", "stopped", "fault",
+};
+
+typedef struct {
+    const char *name;
+    bool aliases;
+    bool compact;
+    bool alias_sent[TOPIC_ALIAS_COUNT];
+    unsigned long packets;
+    unsigned long bytes;
+} variant_t;
+
+static size_t varint_len(size_t value)
+{
+    return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+/**
+ * @brief Account for one PUBLISH: fixed header, topic, packet id, properties, payload
+ */
+static void publish(variant_t *variant, const char *topic, int alias, size_t payload_len)
+{
+    size_t topic_len = strlen(topic);
+    size_t props_len = 0;
+    if (variant->aliases) {
+        props_len = PROPERTY_TOPIC_ALIAS_LEN;
+        if (variant->alias_sent[alias]) {
+            topic_len = 0;
+        }
+        variant->alias_sent[alias] = true;
+    }
+    size_t remaining = 2 + topic_len + 2 + varint_len(props_len) + props_len + payload_len;
+    variant->packets++;
+    variant->bytes += 1 + varint_len(remaining) + remaining;
+}
+
+static void reply(variant_t *variant, door_state_t state)
+{
+    char buf[64];
+    int len = door_payload_reply(buf, sizeof(buf), variant->compact, state, s_state_names[state]);
+    publish(variant, TOPIC_STATUS, 1, (size_t)len);
+}
+
+static void transition(variant_t *variant, door_state_t from, door_state_t to, uint32_t dwell_ms)
+{
+    char buf[64];
+    int len = door_payload_transition(buf, sizeof(buf), variant->compact, from, to,
+                                      s_state_names[from], s_state_names[to], dwell_ms);
+    publish(variant, TOPIC_DOOR_STATE, 3, (size_t)len);
+}
+
+static void run(variant_t *variant, long cycles)
+{
+    const char *connected = variant->compact ? DOOR_PAYLOAD_COMPACT_CONNECTED : DOOR_PAYLOAD_CONNECTED;
+    // The connection message goes out before any alias is set up
+    bool aliases = variant->aliases;
+    variant->aliases = false;
+    publish(variant, TOPIC_STATUS, 1, strlen(connected));
+    variant->aliases = aliases;
+
+    for (long i = 0; i < cycles; i++) {
+        transition(variant, DOOR_CLOSED, DOOR_OPENING, 45000);
+        reply(variant, DOOR_OPENING);
+        transition(variant, DOOR_OPENING, DOOR_OPEN, 6012);
+        reply(variant, DOOR_OPEN);
+        transition(variant, DOOR_OPEN, DOOR_CLOSING, 12480);
+        reply(variant, DOOR_CLOSING);
+        transition(variant, DOOR_CLOSING, DOOR_CLOSED, 5987);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long cycles = argc > 1 ? atol(argv[1]) : 1000;
+    variant_t variants[] = {
+        { .name = "full topics, text" },
+        { .name = "topic aliases, text", .aliases = true },
+        { .name = "full topics, compact", .compact = true },
+        { .name = "topic aliases, compact", .aliases = true, .compact = true },
+    };
+    size_t count = sizeof(variants) / sizeof(variants[0]);
+
+    printf("%ld door cycles, 7 publishes each\n", cycles);
+    for (size_t i = 0; i < count; i++) {
+        run(&variants[i], cycles);
+        printf("%-24s %9lu bytes  %6.1f bytes/publish  %5.1f%%\n", variants[i].name, variants[i].bytes,
+               (double)variants[i].bytes / variants[i].packets, 100.0 * variants[i].bytes / variants[0].bytes);
+    }
+    return 0;
+}
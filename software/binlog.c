@@ -0,0 +1,146 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "config.h"
+#include "hal.h"
+#include "binlog.h"
+#include "spsc_ring.h"
+#include "task_layout.h"
+
+#define BINLOG_DRAIN_TASK_STACK_SIZE    3072
+#define BINLOG_DRAIN_PERIOD_MS          10
+
+static const char *TAG = "binlog";
+
+#if CONFIG_DOOR_BINLOG
+
+static binlog_record_t s_slots[HAL_CORE_COUNT][CONFIG_DOOR_BINLOG_RING_SLOTS];
+static spsc_ring_t s_rings[HAL_CORE_COUNT];
+static uint16_t s_seq[HAL_CORE_COUNT];
+static uint32_t s_dropped[HAL_CORE_COUNT];
+static bool s_started;
+HAL_TASK_STORAGE(s_drain_task_storage, BINLOG_DRAIN_TASK_STACK_SIZE);
+
+/**
+ * @brief Serialise one record into a wire frame
+ */
+static void encode_frame(const binlog_record_t *rec, uint8_t *frame)
+{
+    uint8_t sum = 0;
+
+    frame[0] = BINLOG_FRAME_MAGIC0;
+    frame[1] = BINLOG_FRAME_MAGIC1;
+    memcpy(&frame[2], rec, sizeof(*rec));
+    for (size_t i = 0; i < sizeof(*rec); i++) {
+        sum += frame[2 + i];
+    }
+    frame[2 + sizeof(*rec)] = sum;
+}
+
+/**
+ * @brief Drain task: copy records from every core's ring to the console
+ */
+static void binlog_drain_task(void *arg)
+{
+    uint8_t frame[BINLOG_FRAME_SIZE];
+
+    for (;;) {
+        bool wrote = false;
+        for (int core = 0; core < HAL_CORE_COUNT; core++) {
+            binlog_record_t *rec;
+            while ((rec = spsc_ring_peek(&s_rings[core])) != NULL) {
+                encode_frame(rec, frame);
+                spsc_ring_release(&s_rings[core]);
+                fwrite(frame, 1, sizeof(frame), stdout);
+                wrote = true;
+            }
+        }
+        if (wrote) {
+            fflush(stdout);
+        }
+        hal_task_wait_notify(BINLOG_DRAIN_PERIOD_MS);
+    }
+}
+
+esp_err_t binlog_start(void)
+{
+    for (int core = 0; core < HAL_CORE_COUNT; core++) {
+        spsc_ring_init(&s_rings[core], s_slots[core], sizeof(binlog_record_t), CONFIG_DOOR_BINLOG_RING_SLOTS);
+    }
+    s_started = true;
+
+    if (hal_task_create_static(binlog_drain_task, "binlog", &s_drain_task_storage, NULL,
+                        TASK_BINLOG_PRIORITY, TASK_NET_CORE) == NULL) {
+        ESP_LOGE(TAG, "Failed to create drain task");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Binary logging enabled, %d slots per core", CONFIG_DOOR_BINLOG_RING_SLOTS);
+    return ESP_OK;
+}
+
+void binlog_write(binlog_id_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    if (!s_started) {
+        return;
+    }
+
+    // Masking interrupts on this core makes its ring single-producer
+    uint32_t state = hal_core_lock();
+    int core = hal_core_id();
+    uint16_t seq = s_seq[core]++;
+    binlog_record_t *rec = spsc_ring_reserve(&s_rings[core]);
+    if (rec == NULL) {
+        s_dropped[core]++;
+    } else {
+        rec->timestamp_us = (uint32_t)hal_time_us();
+        rec->id = (uint8_t)id;
+        rec->core = (uint8_t)core;
+        rec->seq = seq;
+        rec->args[0] = a0;
+        rec->args[1] = a1;
+        rec->args[2] = a2;
+        rec->args[3] = a3;
+        spsc_ring_commit(&s_rings[core]);
+    }
+    hal_core_unlock(state);
+}
+
+uint32_t binlog_dropped(void)
+{
+    uint32_t total = 0;
+    for (int core = 0; core < HAL_CORE_COUNT; core++) {
+        total += s_dropped[core];
+    }
+    return total;
+}
+
+#else // !CONFIG_DOOR_BINLOG
+
+static const char *const s_formats[BINLOG_FORMAT_COUNT] = {
+#define BINLOG_FORMAT_ENTRY(id, format) [BINLOG_##id] = format,
+    BINLOG_FORMAT_TABLE(BINLOG_FORMAT_ENTRY)
+#undef BINLOG_FORMAT_ENTRY
+};
+
+esp_err_t binlog_start(void)
+{
+    return ESP_OK;
+}
+
+void binlog_write(binlog_id_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    char line[128];
+    snprintf(line, sizeof(line), s_formats[id], a0, a1, a2, a3);
+    ESP_LOGI(TAG, "%s", line);
+}
+
+uint32_t binlog_dropped(void)
+{
+    return 0;
+}
+
+#endif // CONFIG_DOOR_BINLOG
@@ -0,0 +1,96 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file binlog.h
+ * @brief Deferred binary logging for the command path
+ *
+ * BINLOG(id, args...) stores a format id and up to four 32-bit arguments in
+ * a per-core ring; no formatting or console I/O happens in the caller. A
+ * low-priority task drains the rings to stdout as binary frames:
+ *
+ *     0xB1 0x7E | binlog_record_t (24 bytes, little endian) | checksum
+ *
+ * where checksum is the 8-bit sum of the record bytes. Frames may be
+ * interleaved with ordinary text logs; tools/binlog_decode.c re-creates the
+ * text using the format table below. With CONFIG_DOOR_BINLOG disabled the
+ * same calls are formatted immediately through ESP_LOGI.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <inttypes.h>
+#include "hal.h"
+
+/**
+ * Format table: X(id, printf format). All arguments are passed as uint32_t,
+ * so only 32-bit conversions may be used. Append new entries at the end so
+ * ids of existing captures stay valid.
+ */
+#define BINLOG_FORMAT_TABLE(X)                                                              \
+    X(MQTT_DATA,        "MQTT_EVENT_DATA topic_len=%" PRIu32 " data_len=%" PRIu32)          \
+    X(MQTT_PUBLISHED,   "MQTT_EVENT_PUBLISHED, msg_id=%" PRId32)                            \
+    X(CTRL_MSG,         "Processing control message: len=%" PRIu32)                         \
+    X(CMD_OPEN,         "Command: OPEN received")                                           \
+    X(CMD_CLOSE,        "Command: CLOSE received")                                          \
+    X(LED_STATE,        "LED turned on=%" PRIu32)                                           \
+    X(GPIO_LATENCY,     "Receive-to-GPIO latency: %" PRIu32 " us")                          \
+    X(RESP_OPEN,        "Sent OPEN response, msg_id=%" PRId32)                              \
+    X(RESP_CLOSE,       "Sent CLOSE response, msg_id=%" PRId32)                             \
+    X(RESP_STATUS,      "Sent STATUS response, msg_id=%" PRId32)                            \
+    X(CMD_STOP,         "Command: STOP received")                                           \
+    X(RESP_STOP,        "Sent STOP response, msg_id=%" PRId32)                              \
+    X(MOTOR_DIR,        "Motor relays: dir=%" PRIu32 " (0 off, 1 opening, 2 closing)")      \
+    X(DOOR_STATE,       "Door state %" PRIu32 " -> %" PRIu32 " after %" PRIu32 " ms")           \
+    X(DOOR_INPUT,       "Input %" PRIu32 " active=%" PRIu32 ", %" PRIu32 " us after the edge")  \
+    X(OBSTACLE,         "Obstacle=%" PRIu32 " at %" PRIu32 " mm")                          \
+    X(CMD_SUPERSEDED,   "Command %" PRIu32 " superseded by %" PRIu32 " before it ran")     \
+    X(CMD_PARAMS,       "Command %" PRIu32 " params 0x%" PRIx32 ": position %" PRIu32 "%%, hold %" PRIu32 " ms") \
+    X(MQTT_RECONNECTED, "MQTT reconnected after %" PRIu32 " ms offline")
+
+#define BINLOG_MAX_ARGS         4
+#define BINLOG_FRAME_MAGIC0     0xB1
+#define BINLOG_FRAME_MAGIC1     0x7E
+
+typedef enum {
+#define BINLOG_ENUM_ENTRY(id, format) BINLOG_##id,
+    BINLOG_FORMAT_TABLE(BINLOG_ENUM_ENTRY)
+#undef BINLOG_ENUM_ENTRY
+    BINLOG_FORMAT_COUNT
+} binlog_id_t;
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint8_t id;
+    uint8_t core;
+    uint16_t seq;           // per-core, also advanced for dropped records
+    uint32_t args[BINLOG_MAX_ARGS];
+} binlog_record_t;
+
+#define BINLOG_FRAME_SIZE       (2 + sizeof(binlog_record_t) + 1)
+
+/**
+ * @brief Record a log event; unused arguments are zero
+ */
+#define BINLOG(id, ...) \
+    binlog_write(BINLOG_##id, BINLOG_ARGS_(0, ##__VA_ARGS__, 0, 0, 0, 0))
+#define BINLOG_ARGS_(unused, a0, a1, a2, a3, ...) \
+    (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3)
+
+/**
+ * @brief Set up the rings and start the drain task
+ *
+ * Events recorded before this call are discarded.
+ */
+esp_err_t binlog_start(void);
+
+/**
+ * @brief Record one event; safe from any task or ISR
+ */
+void binlog_write(binlog_id_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/**
+ * @brief Number of events lost because a ring was full
+ */
+uint32_t binlog_dropped(void);
@@ -0,0 +1,127 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "cmd_cbor.h"
+
+#define CBOR_UINT               0
+#define CBOR_NINT               1
+#define CBOR_BYTES              2
+#define CBOR_TEXT               3
+#define CBOR_MAP                5
+#define CBOR_SIMPLE             7
+#define CBOR_MAX_PAIRS          16
+
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+} cbor_reader_t;
+
+/**
+ * @brief Read an item head: major type and argument, up to 32 bits
+ */
+static bool read_head(cbor_reader_t *reader, uint8_t *major, uint32_t *arg)
+{
+    if (reader->pos >= reader->end) {
+        return false;
+    }
+    uint8_t initial = *reader->pos++;
+    uint8_t info = initial & 0x1F;
+    *major = initial >> 5;
+
+    if (info < 24) {
+        *arg = info;
+        return true;
+    }
+    if (info > 26) {
+        // 64-bit arguments, reserved values and indefinite lengths
+        return false;
+    }
+    int size = 1 << (info - 24);
+    if (reader->end - reader->pos < size) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value = (value << 8) | *reader->pos++;
+    }
+    *arg = value;
+    return true;
+}
+
+bool cmd_cbor_decode(const char *data, int len, cmd_params_t *params)
+{
+    cbor_reader_t reader = { (const uint8_t *)data, (const uint8_t *)data + len };
+    uint8_t major;
+    uint32_t pairs;
+
+    memset(params, 0, sizeof(*params));
+    params->cmd = DOOR_CMD_UNKNOWN;
+    if (!read_head(&reader, &major, &pairs) || major != CBOR_MAP || pairs > CBOR_MAX_PAIRS) {
+        return false;
+    }
+
+    bool have_cmd = false;
+    for (uint32_t i = 0; i < pairs; i++) {
+        uint32_t key;
+        uint32_t value;
+        if (!read_head(&reader, &major, &key) || major != CBOR_UINT ||
+            !read_head(&reader, &major, &value)) {
+            return false;
+        }
+        const char *text = NULL;
+        if (major == CBOR_BYTES || major == CBOR_TEXT) {
+            if ((uint32_t)(reader.end - reader.pos) < value) {
+                return false;
+            }
+            text = (const char *)reader.pos;
+            reader.pos += value;
+        } else if (major != CBOR_UINT && major != CBOR_NINT && major != CBOR_SIMPLE) {
+            return false;
+        }
+
+        switch (key) {
+        case CMD_KEY_COMMAND:
+            if (major == CBOR_UINT && value < DOOR_CMD_COUNT) {
+                params->cmd = (door_cmd_t)value;
+            } else if (major == CBOR_TEXT) {
+                params->cmd = door_cmd_lookup(text, (int)value);
+            }
+            if (params->cmd == DOOR_CMD_UNKNOWN) {
+                return false;
+            }
+            have_cmd = true;
+            break;
+        case CMD_KEY_POSITION:
+            if (major != CBOR_UINT || value > 100) {
+                return false;
+            }
+            params->position_pct = (uint8_t)value;
+            break;
+        case CMD_KEY_SPEED:
+            if (major != CBOR_UINT || value < 1 || value > 100) {
+                return false;
+            }
+            params->speed_pct = (uint8_t)value;
+            break;
+        case CMD_KEY_HOLD:
+            if (major != CBOR_UINT) {
+                return false;
+            }
+            params->hold_ms = value;
+            break;
+        case CMD_KEY_REQUESTER:
+            if (major != CBOR_TEXT || value > CMD_REQUESTER_MAX_LEN) {
+                return false;
+            }
+            params->requester = text;
+            params->requester_len = (uint8_t)value;
+            break;
+        default:
+            continue;       // unknown key, value already skipped
+        }
+        params->fields |= 1u << key;
+    }
+    return have_cmd && reader.pos == reader.end;
+}
@@ -0,0 +1,71 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file cmd_cbor.h
+ * @brief CBOR command payloads with parameters
+ *
+ * Besides the ASCII keywords, /dorra/control accepts a CBOR map (RFC 8949)
+ * with small unsigned integer keys:
+ *
+ *     0  command     uint (door_cmd_t value) or text keyword, e.g. "open"   required
+ *     1  position    uint, percent open to move to (0..100)
+ *     2  speed       uint, percent of full speed (1..100)
+ *     3  hold        uint, ms the door rests after the move before closing again (0 none)
+ *     4  requester   text, at most CMD_REQUESTER_MAX_LEN bytes
+ *
+ * e.g. {0: "open", 1: 50, 3: 10000} is A3 00 64 6F 70 65 6E 01 18 32 03 19 27 10.
+ * Unknown keys with scalar or string values are skipped for forward
+ * compatibility. Nested items, tags and indefinite lengths are rejected.
+ *
+ * A payload is CBOR when its first byte is a map head (0xA0..0xBF), which
+ * no ASCII keyword starts with. The decoder reads the payload in place:
+ * no copy, no allocation, and the requester points into the payload.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "door_cmd.h"
+
+#define CMD_REQUESTER_MAX_LEN   32
+
+typedef enum {
+    CMD_KEY_COMMAND,
+    CMD_KEY_POSITION,
+    CMD_KEY_SPEED,
+    CMD_KEY_HOLD,
+    CMD_KEY_REQUESTER,
+} cmd_key_t;
+
+// Bits of cmd_params_t.fields
+#define CMD_PARAM_POSITION      (1u << CMD_KEY_POSITION)
+#define CMD_PARAM_SPEED         (1u << CMD_KEY_SPEED)
+#define CMD_PARAM_HOLD          (1u << CMD_KEY_HOLD)
+#define CMD_PARAM_REQUESTER     (1u << CMD_KEY_REQUESTER)
+
+typedef struct {
+    door_cmd_t cmd;
+    uint8_t fields;             // CMD_PARAM_* present in the payload
+    uint8_t position_pct;
+    uint8_t speed_pct;
+    uint8_t requester_len;
+    uint32_t hold_ms;
+    const char *requester;      // points into the payload, not NUL terminated
+} cmd_params_t;
+
+/**
+ * @brief Whether a control payload is CBOR rather than an ASCII keyword
+ */
+static inline bool cmd_cbor_detect(const char *data, int len)
+{
+    return len > 0 && ((uint8_t)data[0] >> 5) == 5;
+}
+
+/**
+ * @brief Decode a CBOR command in place
+ * @param params Filled in; only valid while data is
+ * @return false if the payload is malformed, out of range or has no command
+ */
+bool cmd_cbor_decode(const char *data, int len, cmd_params_t *params);
@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "cmd_dedup.h"
+
+#define CMD_DEDUP_SLOTS         64      // must be a power of two
+#define FNV_OFFSET_BASIS        2166136261u
+#define FNV_PRIME               16777619u
+
+static uint32_t s_slots[CMD_DEDUP_SLOTS];   // 0 when free
+static uint32_t s_suppressed;
+
+static uint32_t fnv1a(uint32_t hash, const void *data, int len)
+{
+    const uint8_t *bytes = data;
+    for (int i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+bool cmd_dedup_seen(const hal_mqtt_event_t *event)
+{
+    if (event->msg_id == 0 && !event->has_seq) {
+        // QoS 0: never redelivered, and nothing to identify it by
+        return false;
+    }
+
+    uint32_t key = fnv1a(FNV_OFFSET_BASIS, &event->msg_id, sizeof(event->msg_id));
+    if (event->has_seq) {
+        key = fnv1a(key, &event->seq, sizeof(event->seq));
+    } else {
+        key = fnv1a(key, event->data, event->data_len);
+    }
+    key |= key == 0;                        // 0 marks a free slot
+
+    uint32_t *slot = &s_slots[key & (CMD_DEDUP_SLOTS - 1)];
+    if (*slot == key && (event->has_seq || event->dup)) {
+        s_suppressed++;
+        return true;
+    }
+    *slot = key;
+    return false;
+}
+
+uint32_t cmd_dedup_suppressed(void)
+{
+    return s_suppressed;
+}
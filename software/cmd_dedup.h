@@ -0,0 +1,36 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file cmd_dedup.h
+ * @brief De-duplication of redelivered QoS1 commands
+ *
+ * After a reconnect the broker may deliver a QoS1 command again that was
+ * already executed. Every command is identified by a 32-bit FNV-1a hash of
+ * its packet identifier and its MQTT5 "seq" user property (the payload
+ * stands in when the sender sets no sequence number). The hashes of recent
+ * commands are kept in a direct-mapped table in static memory, so a lookup
+ * is one slot compare; a newer command hashing to the same slot evicts the
+ * older one.
+ *
+ * Packet identifiers are recycled by the broker, so a command without a
+ * sequence number is only treated as a duplicate when it also has the DUP
+ * flag set. Not thread safe: call from the MQTT task only.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+/**
+ * @brief Check a control message against recent commands and remember it
+ * @return true if it is a redelivery of a command already seen
+ */
+bool cmd_dedup_seen(const hal_mqtt_event_t *event);
+
+/**
+ * @brief Number of redeliveries suppressed since boot
+ */
+uint32_t cmd_dedup_suppressed(void);
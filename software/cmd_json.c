@@ -0,0 +1,373 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "cmd_json.h"
+
+#define KEY_NONE                -1
+#define HOLD_S_MAX              (UINT32_MAX / 1000)
+
+typedef enum {
+    TOK_END,
+    TOK_BEGIN_OBJECT,
+    TOK_END_OBJECT,
+    TOK_BEGIN_ARRAY,
+    TOK_END_ARRAY,
+    TOK_COLON,
+    TOK_COMMA,
+    TOK_STRING,
+    TOK_NUMBER,
+    TOK_LITERAL,
+} json_tok_type_t;
+
+typedef struct {
+    json_tok_type_t type;
+    const char *start;          // string contents without the quotes
+    int len;
+    bool escaped;               // string contains escapes
+} json_tok_t;
+
+// What the grammar allows next
+typedef enum {
+    EXPECT_VALUE,
+    EXPECT_VALUE_OR_CLOSE,      // first element of an array
+    EXPECT_KEY,
+    EXPECT_KEY_OR_CLOSE,        // first member of an object
+    EXPECT_COLON,
+    EXPECT_NEXT,                // comma or close
+} json_expect_t;
+
+typedef struct {
+    const char *name;
+    int key;                    // cmd_key_t, or KEY_HOLD_S
+} json_member_t;
+
+#define KEY_HOLD_S              (CMD_KEY_REQUESTER + 1)
+
+static const json_member_t s_members[] = {
+    { "cmd", CMD_KEY_COMMAND },
+    { "position", CMD_KEY_POSITION },
+    { "speed", CMD_KEY_SPEED },
+    { "hold_s", KEY_HOLD_S },
+    { "hold_ms", CMD_KEY_HOLD },
+    { "requester", CMD_KEY_REQUESTER },
+};
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool is_hex(char c)
+{
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/**
+ * @brief Scan a string after its opening quote
+ * @return false on an unterminated string, bad escape or control character
+ */
+static bool scan_string(const char **pos, const char *end, json_tok_t *tok)
+{
+    const char *p = *pos;
+    tok->type = TOK_STRING;
+    tok->start = p;
+    tok->escaped = false;
+    while (p < end && *p != '"') {
+        if ((unsigned char)*p < 0x20) {
+            return false;
+        }
+        if (*p++ != '\\') {
+            continue;
+        }
+        tok->escaped = true;
+        if (p == end) {
+            return false;
+        }
+        char e = *p++;
+        if (e == 'u') {
+            if (end - p < 4 || !is_hex(p[0]) || !is_hex(p[1]) || !is_hex(p[2]) || !is_hex(p[3])) {
+                return false;
+            }
+            p += 4;
+        } else if (strchr("\"\\/bfnrt", e) == NULL || e == '\0') {
+            return false;
+        }
+    }
+    if (p == end) {
+        return false;
+    }
+    tok->len = (int)(p - tok->start);
+    *pos = p + 1;
+    return true;
+}
+
+/**
+ * @brief Scan a number: -?int(.digits)?([eE][+-]?digits)?
+ */
+static bool scan_number(const char **pos, const char *end, json_tok_t *tok)
+{
+    const char *p = *pos;
+    tok->type = TOK_NUMBER;
+    tok->start = p;
+    if (*p == '-') {
+        p++;
+    }
+    if (p == end || !is_digit(*p)) {
+        return false;
+    }
+    if (*p == '0') {
+        p++;
+    } else {
+        while (p < end && is_digit(*p)) {
+            p++;
+        }
+    }
+    if (p < end && *p == '.') {
+        if (++p == end || !is_digit(*p)) {
+            return false;
+        }
+        while (p < end && is_digit(*p)) {
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        if (++p < end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (p == end || !is_digit(*p)) {
+            return false;
+        }
+        while (p < end && is_digit(*p)) {
+            p++;
+        }
+    }
+    tok->len = (int)(p - tok->start);
+    *pos = p;
+    return true;
+}
+
+/**
+ * @brief Next token, skipping white space
+ * @return false on a lexical error
+ */
+static bool next_token(const char **pos, const char *end, json_tok_t *tok)
+{
+    const char *p = *pos;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    if (p == end) {
+        tok->type = TOK_END;
+        *pos = p;
+        return true;
+    }
+
+    switch (*p) {
+    case '{': tok->type = TOK_BEGIN_OBJECT; break;
+    case '}': tok->type = TOK_END_OBJECT; break;
+    case '[': tok->type = TOK_BEGIN_ARRAY; break;
+    case ']': tok->type = TOK_END_ARRAY; break;
+    case ':': tok->type = TOK_COLON; break;
+    case ',': tok->type = TOK_COMMA; break;
+    case '"':
+        *pos = p + 1;
+        return scan_string(pos, end, tok);
+    case 't':
+    case 'f':
+    case 'n': {
+        static const char *const literals[] = { "true", "false", "null" };
+        for (int i = 0; i < 3; i++) {
+            int n = (int)strlen(literals[i]);
+            if (end - p >= n && memcmp(p, literals[i], n) == 0) {
+                tok->type = TOK_LITERAL;
+                tok->start = p;
+                tok->len = n;
+                *pos = p + n;
+                return true;
+            }
+        }
+        return false;
+    }
+    default:
+        *pos = p;
+        return scan_number(pos, end, tok);
+    }
+    *pos = p + 1;
+    return true;
+}
+
+/**
+ * @brief Known top-level member named by a key token, KEY_NONE if none
+ */
+static int lookup_member(const json_tok_t *tok)
+{
+    if (tok->escaped) {
+        return KEY_NONE;
+    }
+    for (size_t i = 0; i < sizeof(s_members) / sizeof(s_members[0]); i++) {
+        const char *name = s_members[i].name;
+        if ((int)strlen(name) == tok->len && memcmp(name, tok->start, tok->len) == 0) {
+            return s_members[i].key;
+        }
+    }
+    return KEY_NONE;
+}
+
+/**
+ * @brief Value of a plain non-negative integer token, no fraction or exponent
+ * @return false if the token is not one or exceeds max
+ */
+static bool token_uint(const json_tok_t *tok, uint32_t max, uint32_t *value)
+{
+    if (tok->type != TOK_NUMBER) {
+        return false;
+    }
+    uint32_t v = 0;
+    for (int i = 0; i < tok->len; i++) {
+        char c = tok->start[i];
+        if (!is_digit(c) || v > (max - (uint32_t)(c - '0')) / 10) {
+            return false;
+        }
+        v = v * 10 + (uint32_t)(c - '0');
+    }
+    *value = v;
+    return true;
+}
+
+/**
+ * @brief Store the value of a known member
+ * @return false if it has the wrong type or is out of range
+ */
+static bool apply_member(int key, const json_tok_t *tok, cmd_params_t *params)
+{
+    uint32_t value;
+    switch (key) {
+    case CMD_KEY_COMMAND:
+        if (tok->type != TOK_STRING || tok->escaped) {
+            return false;
+        }
+        params->cmd = door_cmd_lookup(tok->start, tok->len);
+        return params->cmd != DOOR_CMD_UNKNOWN;
+    case CMD_KEY_POSITION:
+        if (!token_uint(tok, 100, &value)) {
+            return false;
+        }
+        params->position_pct = (uint8_t)value;
+        break;
+    case CMD_KEY_SPEED:
+        if (!token_uint(tok, 100, &value) || value < 1) {
+            return false;
+        }
+        params->speed_pct = (uint8_t)value;
+        break;
+    case KEY_HOLD_S:
+        if (!token_uint(tok, HOLD_S_MAX, &value)) {
+            return false;
+        }
+        params->hold_ms = value * 1000;
+        key = CMD_KEY_HOLD;
+        break;
+    case CMD_KEY_HOLD:
+        if (!token_uint(tok, UINT32_MAX, &value)) {
+            return false;
+        }
+        params->hold_ms = value;
+        break;
+    case CMD_KEY_REQUESTER:
+        if (tok->type != TOK_STRING || tok->len > CMD_REQUESTER_MAX_LEN) {
+            return false;
+        }
+        params->requester = tok->start;
+        params->requester_len = (uint8_t)tok->len;
+        break;
+    }
+    params->fields |= 1u << key;
+    return true;
+}
+
+bool cmd_json_decode(const char *data, int len, cmd_params_t *params)
+{
+    const char *pos = data;
+    const char *end = data + len;
+    uint32_t arrays = 0;        // bit n set: the container at depth n + 1 is an array
+    int depth = 0;
+    int member = KEY_NONE;      // known top-level member whose value comes next
+    bool have_cmd = false;
+    json_expect_t expect = EXPECT_VALUE;
+    json_tok_t tok;
+
+    memset(params, 0, sizeof(*params));
+    params->cmd = DOOR_CMD_UNKNOWN;
+
+    for (;;) {
+        if (!next_token(&pos, end, &tok)) {
+            return false;
+        }
+        bool in_array = depth > 0 && (arrays >> (depth - 1)) & 1;
+
+        switch (tok.type) {
+        case TOK_END:
+            // Complete only once the top-level object has closed
+            return depth == 0 && expect == EXPECT_NEXT && have_cmd;
+        case TOK_BEGIN_OBJECT:
+        case TOK_BEGIN_ARRAY:
+            if ((expect != EXPECT_VALUE && expect != EXPECT_VALUE_OR_CLOSE) || depth == CMD_JSON_MAX_DEPTH ||
+                (depth == 0 && tok.type != TOK_BEGIN_OBJECT) || member != KEY_NONE) {
+                return false;
+            }
+            if (tok.type == TOK_BEGIN_ARRAY) {
+                arrays |= 1u << depth;
+            } else {
+                arrays &= ~(1u << depth);
+            }
+            depth++;
+            expect = tok.type == TOK_BEGIN_ARRAY ? EXPECT_VALUE_OR_CLOSE : EXPECT_KEY_OR_CLOSE;
+            break;
+        case TOK_END_OBJECT:
+        case TOK_END_ARRAY:
+            if (depth == 0 || in_array != (tok.type == TOK_END_ARRAY) ||
+                (expect != EXPECT_NEXT && expect != (in_array ? EXPECT_VALUE_OR_CLOSE : EXPECT_KEY_OR_CLOSE))) {
+                return false;
+            }
+            depth--;
+            expect = EXPECT_NEXT;
+            break;
+        case TOK_COLON:
+            if (expect != EXPECT_COLON) {
+                return false;
+            }
+            expect = EXPECT_VALUE;
+            break;
+        case TOK_COMMA:
+            if (expect != EXPECT_NEXT || depth == 0) {
+                return false;
+            }
+            expect = in_array ? EXPECT_VALUE : EXPECT_KEY;
+            break;
+        case TOK_STRING:
+            if (expect == EXPECT_KEY || expect == EXPECT_KEY_OR_CLOSE) {
+                member = depth == 1 ? lookup_member(&tok) : KEY_NONE;
+                expect = EXPECT_COLON;
+                break;
+            }
+            // A string value
+            // fall through
+        case TOK_NUMBER:
+        case TOK_LITERAL:
+            if ((expect != EXPECT_VALUE && expect != EXPECT_VALUE_OR_CLOSE) || depth == 0) {
+                return false;
+            }
+            if (member != KEY_NONE) {
+                if (!apply_member(member, &tok, params)) {
+                    return false;
+                }
+                have_cmd |= member == CMD_KEY_COMMAND;
+                member = KEY_NONE;
+            }
+            expect = EXPECT_NEXT;
+            break;
+        }
+    }
+}
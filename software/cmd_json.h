@@ -0,0 +1,55 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file cmd_json.h
+ * @brief JSON command payloads for building-management integrations
+ *
+ * /dorra/control also accepts a JSON object with the same parameters as the
+ * CBOR map (cmd_cbor.h):
+ *
+ *     "cmd"        string keyword, e.g. "open"                      required
+ *     "position"   integer, percent open to move to (0..100)
+ *     "speed"      integer, percent of full speed (1..100)
+ *     "hold_s"     integer, seconds the door rests before closing again
+ *     "hold_ms"    integer, the same in milliseconds
+ *     "requester"  string, at most CMD_REQUESTER_MAX_LEN bytes as sent
+ *
+ * e.g. {"cmd":"open","hold_s":10}. Other members may hold any JSON value
+ * and are skipped. The tokenizer is a single non-recursive pass over the
+ * payload in place: nesting is tracked in a bit stack up to
+ * CMD_JSON_MAX_DEPTH, nothing is copied or allocated, and the requester
+ * points into the payload (escapes are not decoded).
+ *
+ * A payload is JSON when its first non-blank character is '{', which no
+ * ASCII keyword starts with.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "cmd_cbor.h"
+
+#define CMD_JSON_MAX_DEPTH      16
+
+/**
+ * @brief Whether a control payload is a JSON object rather than an ASCII keyword
+ */
+static inline bool cmd_json_detect(const char *data, int len)
+{
+    for (int i = 0; i < len; i++) {
+        char c = data[i];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+            return c == '{';
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Decode a JSON command in place
+ * @param params Filled in; only valid while data is
+ * @return false if the payload is not valid JSON, a known member is out of
+ *         range or of the wrong type, or there is no command
+ */
+bool cmd_json_decode(const char *data, int len, cmd_params_t *params);
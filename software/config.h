@@ -0,0 +1,47 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file config.h
+ * @brief Door controller build configuration
+ *
+ * On the target the CONFIG_DOOR_* values come from Kconfig.projbuild via
+ * sdkconfig.h. The host build has no sdkconfig, so the Kconfig defaults are
+ * repeated here.
+ */
+#pragma once
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#else
+#define CONFIG_DOOR_BINLOG                  1
+#define CONFIG_DOOR_BINLOG_RING_SLOTS       128
+#define CONFIG_DOOR_MQTT_REASM_ARENA_SIZE   2048
+#define CONFIG_DOOR_RELAY_OPEN_GPIO         26
+#define CONFIG_DOOR_RELAY_CLOSE_GPIO        27
+#define CONFIG_DOOR_RELAY_ACTIVE_LEVEL      1
+#define CONFIG_DOOR_RELAY_DEAD_TIME_MS      100
+#define CONFIG_DOOR_TRAVEL_TIME_MS          6000
+#define CONFIG_DOOR_LIMIT_SWITCHES          1
+#define CONFIG_DOOR_LIMIT_OPEN_GPIO         32
+#define CONFIG_DOOR_LIMIT_CLOSED_GPIO       33
+#define CONFIG_DOOR_OVERRIDE_GPIO           14
+#define CONFIG_DOOR_INPUT_ACTIVE_LEVEL      0
+#define CONFIG_DOOR_INPUT_DEBOUNCE_MS       20
+#define CONFIG_DOOR_SENSOR_TRIGGER_GPIO     5
+#define CONFIG_DOOR_SENSOR_ECHO_GPIO        18
+#define CONFIG_DOOR_SENSOR_RATE_HZ          10
+#define CONFIG_DOOR_SENSOR_MAX_RANGE_MM     2000
+#define CONFIG_DOOR_OBSTACLE_MM             300
+#define CONFIG_DOOR_CMD_COALESCE_MS         200
+#define CONFIG_DOOR_MQTT_TOPIC_ALIASES      1
+#define CONFIG_DOOR_MQTT_SESSION_EXPIRY_S   300
+#define CONFIG_DOOR_MQTT_BACKOFF_BASE_MS    500
+#define CONFIG_DOOR_MQTT_BACKOFF_MAX_MS     60000
+#define CONFIG_DOOR_OUTBOX                  1
+#define CONFIG_DOOR_OUTBOX_BATCH            8
+#define CONFIG_DOOR_JOURNAL                 1
+// CONFIG_DOOR_COMPACT_PAYLOADS is off by default
+#define CONFIG_DOOR_DIAG_PERIOD_S           60
+#endif
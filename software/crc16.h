@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file crc16.h
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) for records kept in flash
+ *
+ * Bitwise, to keep a table out of flash; records are short. Host tools that
+ * check millions of records build the byte table from crc16_ccitt(0, &i, 1).
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC16_INIT      0xFFFF
+
+/**
+ * @brief Continue a CRC over len bytes; start with CRC16_INIT
+ */
+static inline uint16_t crc16_ccitt(uint16_t crc, const void *data, size_t len)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(bytes[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (uint16_t)(crc << 1 ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "door_cmd.h"
+
+typedef struct {
+    const char *keyword;
+    unsigned char len;
+} door_cmd_entry_t;
+
+static const door_cmd_entry_t s_cmd_entries[DOOR_CMD_COUNT] = {
+#define DOOR_CMD_ENTRY(id, keyword, first) [DOOR_CMD_##id] = { keyword, sizeof(keyword) - 1 },
+    DOOR_CMD_TABLE(DOOR_CMD_ENTRY)
+#undef DOOR_CMD_ENTRY
+};
+
+door_cmd_t door_cmd_lookup(const char *data, int len)
+{
+    door_cmd_t cmd;
+
+    if (len <= 0) {
+        return DOOR_CMD_UNKNOWN;
+    }
+
+    switch (DOOR_CMD_HASH(len, data[0])) {
+#define DOOR_CMD_CASE(id, keyword, first) \
+    case DOOR_CMD_HASH(sizeof(keyword) - 1, first): cmd = DOOR_CMD_##id; break;
+    DOOR_CMD_TABLE(DOOR_CMD_CASE)
+#undef DOOR_CMD_CASE
+    default:
+        return DOOR_CMD_UNKNOWN;
+    }
+
+    // The hash only selects a candidate; confirm exact length and bytes
+    const door_cmd_entry_t *entry = &s_cmd_entries[cmd];
+    if (entry->len != len || memcmp(entry->keyword, data, len) != 0) {
+        return DOOR_CMD_UNKNOWN;
+    }
+    return cmd;
+}
+
+const char *door_cmd_name(door_cmd_t cmd)
+{
+    if (cmd >= DOOR_CMD_COUNT) {
+        return "unknown";
+    }
+    return s_cmd_entries[cmd].keyword;
+}
@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file door_cmd.h
+ * @brief Door control command table and payload lookup
+ */
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * Command table: X(id, keyword, first character of keyword).
+ *
+ * The lookup is a switch on DOOR_CMD_HASH(length, first byte), so two
+ * commands hashing to the same slot fail to compile (duplicate case label).
+ * Adding a command only requires a new row here plus a handler.
+ */
+#define DOOR_CMD_TABLE(X)                   \
+    X(OPEN,      "open",      'o')          \
+    X(CLOSE,     "close",     'c')          \
+    X(STOP,      "stop",      's')          \
+    X(HOLD,      "hold",      'h')          \
+    X(LOCK,      "lock",      'l')          \
+    X(UNLOCK,    "unlock",    'u')          \
+    X(STATUS,    "status",    's')          \
+    X(CALIBRATE, "calibrate", 'c')
+
+#define DOOR_CMD_HASH(len, first)   ((((unsigned)(len) << 1) + (unsigned char)(first)) & 0x0F)
+
+typedef enum {
+#define DOOR_CMD_ENUM_ENTRY(id, keyword, first) DOOR_CMD_##id,
+    DOOR_CMD_TABLE(DOOR_CMD_ENUM_ENTRY)
+#undef DOOR_CMD_ENUM_ENTRY
+    DOOR_CMD_COUNT,
+    DOOR_CMD_UNKNOWN = DOOR_CMD_COUNT
+} door_cmd_t;
+
+/**
+ * @brief Map a raw payload to a command
+ * @param data Payload bytes, need not be NUL terminated
+ * @param len Payload length; only an exact keyword match is accepted
+ * @return Matching command or DOOR_CMD_UNKNOWN
+ */
+door_cmd_t door_cmd_lookup(const char *data, int len);
+
+/**
+ * @brief Keyword of a command, "unknown" for DOOR_CMD_UNKNOWN
+ */
+const char *door_cmd_name(door_cmd_t cmd);
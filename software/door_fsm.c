@@ -0,0 +1,288 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include "config.h"
+#include "binlog.h"
+#include "motor_control.h"
+#include "door_fsm.h"
+
+#define TRAVEL_US       ((int64_t)CONFIG_DOOR_TRAVEL_TIME_MS * 1000)
+#define TIMEOUT_US      (TRAVEL_US * 3 / 2)     // one continuous run without reaching a limit switch
+#define NO_CHANGE       DOOR_STATE_COUNT
+#define NO_TARGET       -1
+
+typedef enum {
+    TIMING_OPENING,
+    TIMING_CLOSING,
+    TIMING_CYCLE,               // leaving DOOR_CLOSED until back in it
+    TIMING_COUNT
+} door_timing_id_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t last_ms;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint64_t total_ms;
+} door_timing_t;
+
+typedef struct {
+    const char *name;
+    motor_dir_t motor;          // entry action
+} door_state_desc_t;
+
+static const char *TAG = "door_fsm";
+
+static const door_state_desc_t s_states[DOOR_STATE_COUNT] = {
+    [DOOR_CLOSED]  = { "closed",  MOTOR_OFF },
+    [DOOR_OPENING] = { "opening", MOTOR_OPENING },
+    [DOOR_OPEN]    = { "open",    MOTOR_OFF },
+    [DOOR_CLOSING] = { "closing", MOTOR_CLOSING },
+    [DOOR_STOPPED] = { "stopped", MOTOR_OFF },
+    [DOOR_FAULT]   = { "fault",   MOTOR_OFF },
+};
+
+// Next state per (state, event); NO_CHANGE entries ignore the event
+static const uint8_t s_transitions[DOOR_STATE_COUNT][DOOR_EVT_COUNT] = {
+    //                 OPEN          CLOSE         STOP          REACHED_OPEN  REACHED_CLOSED  FAULT       OBSTACLE
+    [DOOR_CLOSED]  = { DOOR_OPENING, NO_CHANGE,    NO_CHANGE,    NO_CHANGE,    NO_CHANGE,      DOOR_FAULT, NO_CHANGE },
+    [DOOR_OPENING] = { NO_CHANGE,    DOOR_CLOSING, DOOR_STOPPED, DOOR_OPEN,    NO_CHANGE,      DOOR_FAULT, NO_CHANGE },
+    [DOOR_OPEN]    = { NO_CHANGE,    DOOR_CLOSING, NO_CHANGE,    NO_CHANGE,    NO_CHANGE,      DOOR_FAULT, NO_CHANGE },
+    [DOOR_CLOSING] = { DOOR_OPENING, NO_CHANGE,    DOOR_STOPPED, NO_CHANGE,    DOOR_CLOSED,    DOOR_FAULT, DOOR_OPENING },
+    [DOOR_STOPPED] = { DOOR_OPENING, DOOR_CLOSING, NO_CHANGE,    NO_CHANGE,    NO_CHANGE,      DOOR_FAULT, NO_CHANGE },
+    [DOOR_FAULT]   = { NO_CHANGE,    NO_CHANGE,    DOOR_STOPPED, NO_CHANGE,    NO_CHANGE,      NO_CHANGE,  NO_CHANGE },
+};
+
+static const char *const s_timing_names[TIMING_COUNT] = {
+    [TIMING_OPENING] = "opening",
+    [TIMING_CLOSING] = "closing",
+    [TIMING_CYCLE] = "cycle",
+};
+
+static door_state_t s_state;
+static int64_t s_entered_us;
+static int64_t s_cycle_start_us;
+static int64_t s_position_us;       // motor run time away from closed, 0..TRAVEL_US
+static int64_t s_accounted_us;      // motion before this time is folded into s_position_us
+static int64_t s_target_us = NO_TARGET;     // intermediate stop of the current move
+static door_timing_t s_timings[TIMING_COUNT];
+static door_state_cb_t s_cb;
+static void *s_cb_arg;
+
+/**
+ * @brief Estimated position, from the run time of the active direction
+ */
+static int64_t position_at(int64_t now_us)
+{
+    motor_dir_t dir = motor_active();
+    if (dir == MOTOR_OFF) {
+        return s_position_us;
+    }
+    int64_t since = motor_active_since_us();
+    int64_t moved = now_us - (since > s_accounted_us ? since : s_accounted_us);
+    int64_t position = s_position_us + (dir == MOTOR_OPENING ? moved : -moved);
+    return position < 0 ? 0 : position > TRAVEL_US ? TRAVEL_US : position;
+}
+
+static void timing_record(door_timing_id_t id, int64_t start_us, int64_t end_us)
+{
+    door_timing_t *timing = &s_timings[id];
+    uint32_t ms = (uint32_t)((end_us - start_us) / 1000);
+
+    timing->last_ms = ms;
+    timing->total_ms += ms;
+    if (timing->count == 0 || ms < timing->min_ms) {
+        timing->min_ms = ms;
+    }
+    if (ms > timing->max_ms) {
+        timing->max_ms = ms;
+    }
+    timing->count++;
+}
+
+/**
+ * @brief Leave the current state and run the entry action of the next one
+ */
+static void transition(door_state_t next, int64_t now_us)
+{
+    door_state_t prev = s_state;
+    uint32_t dwell_ms = (uint32_t)((now_us - s_entered_us) / 1000);
+
+    s_position_us = next == DOOR_OPEN ? TRAVEL_US : next == DOOR_CLOSED ? 0 : position_at(now_us);
+    s_accounted_us = now_us;
+    if (next != DOOR_OPENING && next != DOOR_CLOSING) {
+        s_target_us = NO_TARGET;
+    }
+
+    if (prev == DOOR_OPENING && next == DOOR_OPEN) {
+        timing_record(TIMING_OPENING, s_entered_us, now_us);
+    } else if (prev == DOOR_CLOSING && next == DOOR_CLOSED) {
+        timing_record(TIMING_CLOSING, s_entered_us, now_us);
+        if (s_cycle_start_us != 0) {
+            timing_record(TIMING_CYCLE, s_cycle_start_us, now_us);
+        }
+    }
+    if (prev == DOOR_CLOSED) {
+        s_cycle_start_us = now_us;
+    }
+
+    s_state = next;
+    s_entered_us = now_us;
+    motor_set(s_states[next].motor, now_us);
+    BINLOG(DOOR_STATE, prev, next, dwell_ms);
+
+    if (s_cb != NULL) {
+        s_cb(prev, next, dwell_ms, s_cb_arg);
+    }
+}
+
+esp_err_t door_fsm_init(door_state_t initial, uint8_t position_pct, door_state_cb_t cb, void *arg)
+{
+    s_cb = cb;
+    s_cb_arg = arg;
+    s_state = initial;
+    s_entered_us = hal_time_us();
+    s_cycle_start_us = 0;       // a cycle only counts from a closed door
+    if (initial == DOOR_OPEN || initial == DOOR_CLOSED) {
+        position_pct = initial == DOOR_OPEN ? 100 : 0;
+    }
+    s_position_us = TRAVEL_US * (position_pct > 100 ? 100 : position_pct) / 100;
+    ESP_LOGI(TAG, "Door starts %s at %u %%, travel time %d ms", door_state_name(initial), position_pct,
+             CONFIG_DOOR_TRAVEL_TIME_MS);
+    return motor_init();
+}
+
+bool door_fsm_post(door_event_t event, int64_t now_us)
+{
+    s_target_us = NO_TARGET;
+    door_state_t next = s_transitions[s_state][event];
+    if (next == NO_CHANGE) {
+        return false;
+    }
+    transition(next, now_us);
+    return true;
+}
+
+bool door_fsm_post_target(door_event_t event, uint8_t target_pct, int64_t now_us)
+{
+    bool changed = door_fsm_post(event, now_us);
+    if (target_pct > 0 && target_pct < 100 && (s_state == DOOR_OPENING || s_state == DOOR_CLOSING)) {
+        // Also applies when the door was already moving that way
+        s_target_us = TRAVEL_US * target_pct / 100;
+    }
+    return changed;
+}
+
+/**
+ * @brief Stop a move at its intermediate target
+ * @return Time the target is reached at the current speed, 0 if there is none or the motor is off
+ */
+static int64_t poll_target(int64_t now_us)
+{
+    if (s_target_us == NO_TARGET) {
+        return 0;
+    }
+    int64_t position = position_at(now_us);
+    int64_t remaining = s_state == DOOR_OPENING ? s_target_us - position : position - s_target_us;
+    if (remaining <= 0) {
+        door_fsm_post(DOOR_EVT_STOP, now_us);
+        return 0;
+    }
+    return motor_active() != MOTOR_OFF ? now_us + remaining : 0;
+}
+
+uint32_t door_fsm_poll(int64_t now_us)
+{
+    int64_t target_due_us;
+    int64_t due_us;
+    // An end of travel or a fault changes the state; go round again to poll the new one
+    for (;;) {
+        motor_poll(now_us);
+
+        target_due_us = poll_target(now_us);
+        due_us = motor_pending_due_us();
+        motor_dir_t dir = motor_active();
+#if CONFIG_DOOR_LIMIT_SWITCHES
+        // End of travel comes from the limit switches; running too long means one failed
+        if (dir != MOTOR_OFF) {
+            int64_t timeout_us = motor_active_since_us() + TIMEOUT_US;
+            if (now_us >= timeout_us) {
+                ESP_LOGW(TAG, "No limit switch after %d ms %s", (int)(TIMEOUT_US / 1000), s_states[s_state].name);
+                door_fsm_post(DOOR_EVT_FAULT, now_us);
+                continue;
+            }
+            due_us = timeout_us;
+        }
+#else
+        if (dir != MOTOR_OFF) {
+            int64_t position = position_at(now_us);
+            if (s_state == DOOR_OPENING && position >= TRAVEL_US) {
+                door_fsm_post(DOOR_EVT_REACHED_OPEN, now_us);
+                continue;
+            }
+            if (s_state == DOOR_CLOSING && position <= 0) {
+                door_fsm_post(DOOR_EVT_REACHED_CLOSED, now_us);
+                continue;
+            }
+            due_us = now_us + (dir == MOTOR_OPENING ? TRAVEL_US - position : position);
+        }
+#endif
+        break;
+    }
+
+    if (target_due_us != 0 && (due_us == 0 || target_due_us < due_us)) {
+        due_us = target_due_us;
+    }
+    if (due_us == 0) {
+        return HAL_WAIT_FOREVER;
+    }
+    // Round up so a wake-up never comes before the deadline
+    return due_us <= now_us ? 0 : (uint32_t)((due_us - now_us + 999) / 1000);
+}
+
+door_state_t door_fsm_state(void)
+{
+    return s_state;
+}
+
+uint8_t door_fsm_position_pct(int64_t now_us)
+{
+    return (uint8_t)(position_at(now_us) * 100 / TRAVEL_US);
+}
+
+const char *door_state_name(door_state_t state)
+{
+    return state < DOOR_STATE_COUNT ? s_states[state].name : "unknown";
+}
+
+int door_fsm_format_json(char *buf, size_t size)
+{
+    size_t len = 0;
+    int n = snprintf(buf, size, "{\"state\":\"%s\"", door_state_name(s_state));
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+    len = n;
+
+    for (int id = 0; id < TIMING_COUNT; id++) {
+        const door_timing_t *timing = &s_timings[id];
+        n = snprintf(buf + len, size - len,
+                     ",\"%s\":{\"n\":%" PRIu32 ",\"last\":%" PRIu32 ",\"min\":%" PRIu32
+                     ",\"max\":%" PRIu32 ",\"avg\":%" PRIu32 "}",
+                     s_timing_names[id], timing->count, timing->last_ms, timing->min_ms, timing->max_ms,
+                     timing->count ? (uint32_t)(timing->total_ms / timing->count) : 0);
+        if (n < 0 || (size_t)n >= size - len) {
+            return -1;
+        }
+        len += n;
+    }
+
+    if (len + 2 > size) {
+        return -1;
+    }
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return (int)len;
+}
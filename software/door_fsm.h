@@ -0,0 +1,105 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file door_fsm.h
+ * @brief Table-driven door state machine
+ *
+ * Events (commands, end of travel, faults) are looked up in a state x event
+ * table; the entry action of every state is the motor direction it drives.
+ * With CONFIG_DOOR_LIMIT_SWITCHES the switches end a move and a run 1.5x
+ * longer than CONFIG_DOOR_TRAVEL_TIME_MS is a fault. Without them, end of
+ * travel is derived from the time the motor has run, so an interrupted move
+ * resumes with the remaining distance only. The same position estimate lets
+ * a move stop at an intermediate target.
+ *
+ * Time spent opening, closing and on a full closed-to-closed cycle is
+ * recorded for tuning. Runs on the control task; door_fsm_poll() must be
+ * called again no later than the time it returns.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+
+typedef enum {
+    DOOR_CLOSED,
+    DOOR_OPENING,
+    DOOR_OPEN,
+    DOOR_CLOSING,
+    DOOR_STOPPED,
+    DOOR_FAULT,
+    DOOR_STATE_COUNT
+} door_state_t;
+
+typedef enum {
+    DOOR_EVT_OPEN,
+    DOOR_EVT_CLOSE,
+    DOOR_EVT_STOP,              // also acknowledges a fault
+    DOOR_EVT_REACHED_OPEN,
+    DOOR_EVT_REACHED_CLOSED,
+    DOOR_EVT_FAULT,
+    DOOR_EVT_OBSTACLE,          // reverses a closing door
+    DOOR_EVT_COUNT
+} door_event_t;
+
+/**
+ * @brief State change notification, called from the control task
+ * @param dwell_ms Time spent in the previous state
+ */
+typedef void (*door_state_cb_t)(door_state_t from, door_state_t to, uint32_t dwell_ms, void *arg);
+
+/**
+ * @brief Initialise the motor driver with the motor off
+ * @param initial DOOR_CLOSED, DOOR_OPEN, DOOR_STOPPED or DOOR_FAULT, as far as known at boot
+ * @param position_pct Estimated position when stopped or faulted; open and closed imply 100 and 0
+ */
+esp_err_t door_fsm_init(door_state_t initial, uint8_t position_pct, door_state_cb_t cb, void *arg);
+
+/**
+ * @brief Apply an event
+ * @return true if the state changed (and with it the motor outputs)
+ */
+bool door_fsm_post(door_event_t event, int64_t now_us);
+
+/**
+ * @brief Apply OPEN or CLOSE and stop the move at an intermediate position
+ *
+ * The target is dropped by the next event and by any state change other
+ * than the move itself.
+ * @param target_pct Percent open to stop at; 0 and 100 mean full travel
+ * @return true if the state changed
+ */
+bool door_fsm_post_target(door_event_t event, uint8_t target_pct, int64_t now_us);
+
+/**
+ * @brief Advance timers: relay dead time, intermediate target and end of travel
+ * @return Milliseconds until the next call is due, HAL_WAIT_FOREVER if idle
+ */
+uint32_t door_fsm_poll(int64_t now_us);
+
+/**
+ * @brief Current state
+ */
+door_state_t door_fsm_state(void);
+
+/**
+ * @brief Estimated position in percent open (0 closed, 100 open)
+ */
+uint8_t door_fsm_position_pct(int64_t now_us);
+
+/**
+ * @brief Lower-case state name, e.g. "opening"
+ */
+const char *door_state_name(door_state_t state);
+
+/**
+ * @brief Render state and transition timings:
+ *        {"state":..,"opening":{"n":..,"last":..,"min":..,"max":..,"avg":..},"closing":{..},"cycle":{..}}
+ *
+ * Control task only, like the transitions that update the timings.
+ * @return Length written (excluding NUL), or -1 if buf is too small
+ */
+int door_fsm_format_json(char *buf, size_t size);
@@ -0,0 +1,172 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "config.h"
+#include "spsc_ring.h"
+#include "door_inputs.h"
+
+#define DEBOUNCE_US         ((int64_t)CONFIG_DOOR_INPUT_DEBOUNCE_MS * 1000)
+#define INPUT_RING_SLOTS    32      // must be a power of two
+#define INPUT_UNUSED        -1
+
+typedef struct {
+    int pin;                    // INPUT_UNUSED if not fitted
+    // Interrupt handler only
+    int64_t last_edge_us;
+    // Consumer task only
+    bool active;
+    int64_t settle_due_us;      // 0 when no bounce window is open
+} door_input_state_t;
+
+static const char *TAG = "door_inputs";
+
+static door_input_state_t s_inputs[DOOR_INPUT_COUNT] = {
+#if CONFIG_DOOR_LIMIT_SWITCHES
+    [DOOR_INPUT_LIMIT_OPEN] = { .pin = CONFIG_DOOR_LIMIT_OPEN_GPIO },
+    [DOOR_INPUT_LIMIT_CLOSED] = { .pin = CONFIG_DOOR_LIMIT_CLOSED_GPIO },
+#else
+    [DOOR_INPUT_LIMIT_OPEN] = { .pin = INPUT_UNUSED },
+    [DOOR_INPUT_LIMIT_CLOSED] = { .pin = INPUT_UNUSED },
+#endif
+    [DOOR_INPUT_OVERRIDE] = { .pin = CONFIG_DOOR_OVERRIDE_GPIO },
+};
+
+static door_input_event_t s_event_slots[INPUT_RING_SLOTS];
+static spsc_ring_t s_events;
+static hal_task_t *volatile s_consumer;
+static volatile uint32_t s_bounces;
+static volatile uint32_t s_overflows;
+
+static bool level_active(int level)
+{
+    return level == CONFIG_DOOR_INPUT_ACTIVE_LEVEL;
+}
+
+/**
+ * @brief Any-edge interrupt: timestamp, drop bounce, queue the level
+ */
+static void input_isr(void *arg)
+{
+    door_input_state_t *input = arg;
+    int64_t now = hal_time_us();
+
+    if (now - input->last_edge_us < DEBOUNCE_US) {
+        // The consumer re-reads the pin when the window closes
+        s_bounces++;
+        return;
+    }
+    input->last_edge_us = now;
+
+    door_input_event_t *event = spsc_ring_reserve(&s_events);
+    if (event == NULL) {
+        s_overflows++;
+        return;
+    }
+    event->time_us = now;
+    event->input = (uint8_t)(input - s_inputs);
+    event->active = level_active(hal_gpio_get_level(input->pin));
+    spsc_ring_commit(&s_events);
+
+    hal_task_t *consumer = s_consumer;
+    if (consumer != NULL) {
+        hal_task_notify_from_isr(consumer);
+    }
+}
+
+esp_err_t door_inputs_init(void)
+{
+    spsc_ring_init(&s_events, s_event_slots, sizeof(door_input_event_t), INPUT_RING_SLOTS);
+
+    for (int i = 0; i < DOOR_INPUT_COUNT; i++) {
+        door_input_state_t *input = &s_inputs[i];
+        if (input->pin == INPUT_UNUSED) {
+            continue;
+        }
+        input->last_edge_us = -DEBOUNCE_US;
+        esp_err_t err = hal_gpio_config_input(input->pin, CONFIG_DOOR_INPUT_ACTIVE_LEVEL == 0, input_isr, input);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Input GPIO %d setup failed (%d)", input->pin, err);
+            return err;
+        }
+        input->active = level_active(hal_gpio_get_level(input->pin));
+    }
+    ESP_LOGI(TAG, "Limit switches on GPIO %d / %d, override on GPIO %d, debounce %d ms",
+             s_inputs[DOOR_INPUT_LIMIT_OPEN].pin, s_inputs[DOOR_INPUT_LIMIT_CLOSED].pin,
+             CONFIG_DOOR_OVERRIDE_GPIO, CONFIG_DOOR_INPUT_DEBOUNCE_MS);
+    return ESP_OK;
+}
+
+void door_inputs_set_consumer(hal_task_t *consumer)
+{
+    s_consumer = consumer;
+}
+
+/**
+ * @brief Record a new debounced state
+ * @return true if it differs from the previous one
+ */
+static bool input_update(door_input_t id, bool active, int64_t time_us, door_input_event_t *event)
+{
+    door_input_state_t *input = &s_inputs[id];
+    if (input->active == active) {
+        return false;
+    }
+    input->active = active;
+    event->time_us = time_us;
+    event->input = id;
+    event->active = active;
+    return true;
+}
+
+bool door_inputs_next(int64_t now_us, door_input_event_t *event)
+{
+    door_input_event_t *queued;
+    while ((queued = spsc_ring_peek(&s_events)) != NULL) {
+        door_input_event_t edge = *queued;
+        spsc_ring_release(&s_events);
+
+        s_inputs[edge.input].settle_due_us = edge.time_us + DEBOUNCE_US;
+        if (input_update(edge.input, edge.active, edge.time_us, event)) {
+            return true;
+        }
+    }
+
+    for (int i = 0; i < DOOR_INPUT_COUNT; i++) {
+        door_input_state_t *input = &s_inputs[i];
+        if (input->settle_due_us == 0 || now_us < input->settle_due_us) {
+            continue;
+        }
+        input->settle_due_us = 0;
+        if (input_update(i, level_active(hal_gpio_get_level(input->pin)), now_us, event)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t door_inputs_poll_ms(int64_t now_us)
+{
+    int64_t due_us = 0;
+    for (int i = 0; i < DOOR_INPUT_COUNT; i++) {
+        int64_t settle = s_inputs[i].settle_due_us;
+        if (settle != 0 && (due_us == 0 || settle < due_us)) {
+            due_us = settle;
+        }
+    }
+    if (due_us == 0) {
+        return HAL_WAIT_FOREVER;
+    }
+    return due_us <= now_us ? 0 : (uint32_t)((due_us - now_us + 999) / 1000);
+}
+
+bool door_input_active(door_input_t input)
+{
+    return s_inputs[input].active;
+}
+
+void door_inputs_counters(uint32_t *bounces, uint32_t *overflows)
+{
+    *bounces = s_bounces;
+    *overflows = s_overflows;
+}
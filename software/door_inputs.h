@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file door_inputs.h
+ * @brief Limit switch and manual override inputs
+ *
+ * Every input has an any-edge GPIO interrupt. The handler timestamps the
+ * edge, drops further edges within CONFIG_DOOR_INPUT_DEBOUNCE_MS (contact
+ * bounce), pushes the raw level into a lock-free SPSC ring and wakes the
+ * consumer task, so the first edge of a switch reaches the state machine
+ * without any polling delay. The consumer keeps the debounced state: it
+ * ignores edges that do not change it and re-reads the pin once the bounce
+ * window has passed, in case the last edge of a burst was the one dropped.
+ *
+ * All inputs must interrupt on the same core (the GPIO ISR service calls
+ * handlers one after another), which keeps the ring single-producer.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+typedef enum {
+    DOOR_INPUT_LIMIT_OPEN,
+    DOOR_INPUT_LIMIT_CLOSED,
+    DOOR_INPUT_OVERRIDE,        // manual push button
+    DOOR_INPUT_COUNT
+} door_input_t;
+
+typedef struct {
+    int64_t time_us;            // edge time taken in the interrupt handler
+    uint8_t input;              // door_input_t
+    bool active;
+} door_input_event_t;
+
+/**
+ * @brief Configure the input pins, read their initial levels and enable interrupts
+ *
+ * Edges are queued from now on; nobody is woken until a consumer is set.
+ */
+esp_err_t door_inputs_init(void);
+
+/**
+ * @brief Set the task woken on every accepted edge
+ */
+void door_inputs_set_consumer(hal_task_t *consumer);
+
+/**
+ * @brief Fetch the next debounced state change (consumer task)
+ * @return false when there is none
+ */
+bool door_inputs_next(int64_t now_us, door_input_event_t *event);
+
+/**
+ * @brief Milliseconds until the next bounce window closes, HAL_WAIT_FOREVER if none is open
+ */
+uint32_t door_inputs_poll_ms(int64_t now_us);
+
+/**
+ * @brief Debounced state of an input (consumer task)
+ */
+bool door_input_active(door_input_t input);
+
+/**
+ * @brief Edges dropped as bounce, and edges lost because the ring was full
+ */
+void door_inputs_counters(uint32_t *bounces, uint32_t *overflows);
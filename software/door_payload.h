@@ -0,0 +1,55 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file door_payload.h
+ * @brief Text and compact encodings of the status and door state payloads
+ *
+ * Text payloads are the readable defaults: the state name as a command
+ * reply, a JSON object per state change, and "ESP Connected" / "ESP
+ * Disconnected" on the status topic. With CONFIG_DOOR_COMPACT_PAYLOADS the
+ * firmware sends instead:
+ *
+ *     reply          one ASCII digit, the door_state_t value ('0' closed ... '5' fault)
+ *     state change   two digits (new state, previous state), then the dwell time
+ *                    in ms as decimal, e.g. "2160" = open after 160 ms opening
+ *     connection     "+" connected, "-" disconnected (last will)
+ *
+ * Header only, so the byte-count benchmark encodes exactly what the firmware does.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "door_fsm.h"
+
+#define DOOR_PAYLOAD_CONNECTED          "ESP Connected"
+#define DOOR_PAYLOAD_DISCONNECTED       "ESP Disconnected"
+#define DOOR_PAYLOAD_COMPACT_CONNECTED      "+"
+#define DOOR_PAYLOAD_COMPACT_DISCONNECTED   "-"
+
+/**
+ * @brief Command reply: state name, or one digit when compact
+ * @return Length written (excluding NUL), or -1 if buf is too small
+ */
+static inline int door_payload_reply(char *buf, size_t size, bool compact, door_state_t state, const char *name)
+{
+    int n = compact ? snprintf(buf, size, "%c", '0' + state) : snprintf(buf, size, "%s", name);
+    return n < 0 || (size_t)n >= size ? -1 : n;
+}
+
+/**
+ * @brief State change: {"state":..,"from":..,"ms":..}, or digits when compact
+ * @return Length written (excluding NUL), or -1 if buf is too small
+ */
+static inline int door_payload_transition(char *buf, size_t size, bool compact, door_state_t from, door_state_t to,
+                                          const char *from_name, const char *to_name, uint32_t dwell_ms)
+{
+    int n = compact ?
+            snprintf(buf, size, "%c%c%" PRIu32, '0' + to, '0' + from, dwell_ms) :
+            snprintf(buf, size, "{\"state\":\"%s\",\"from\":\"%s\",\"ms\":%" PRIu32 "}", to_name, from_name, dwell_ms);
+    return n < 0 || (size_t)n >= size ? -1 : n;
+}
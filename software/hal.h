@@ -0,0 +1,472 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file hal.h
+ * @brief Hardware/transport abstraction used by the door firmware
+ *
+ * The application only talks to GPIO, the MQTT client and network bring-up
+ * through this interface. hal_esp.c implements it on ESP-IDF (selected by
+ * ESP_PLATFORM); hal_posix.c implements it on Linux so the same control path
+ * can be run under perf/valgrind against a UDP broker stand-in.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_err.h"
+#include "esp_log.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+
+#define HAL_CORE_COUNT  SOC_CPU_CORES_NUM
+
+typedef StaticTask_t hal_task_tcb_t;
+typedef StackType_t hal_stack_t;
+#else
+#define HAL_CORE_COUNT  1
+
+// Threads keep their own control block and stack
+typedef struct {
+    int unused;
+} hal_task_tcb_t;
+typedef uint8_t hal_stack_t;
+
+// Host build: minimal esp_err / esp_log stand-ins so application code is shared as-is
+typedef int esp_err_t;
+
+#define ESP_OK      0
+#define ESP_FAIL    -1
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+void hal_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+void hal_log_level_set(const char *tag, esp_log_level_t level);
+void hal_abort_on_error(const char *expr, esp_err_t err, const char *file, int line);
+
+#define ESP_LOGE(tag, format, ...) hal_log_write(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) hal_log_write(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) hal_log_write(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) hal_log_write(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) hal_log_write(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#define esp_log_level_set(tag, level) hal_log_level_set(tag, level)
+
+#define ESP_ERROR_CHECK(x) do {                                         \
+        esp_err_t err_rc_ = (x);                                        \
+        if (err_rc_ != ESP_OK) {                                        \
+            hal_abort_on_error(#x, err_rc_, __FILE__, __LINE__);        \
+        }                                                               \
+    } while (0)
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* System                                                                    */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Bring up NVS, the only platform service local door control needs
+ */
+esp_err_t hal_storage_init(void);
+
+/**
+ * @brief Bring up the services the network needs (netif, default event loop)
+ */
+esp_err_t hal_platform_init(void);
+
+/**
+ * @brief Block until the network link is up
+ *
+ * The host backend waits DOOR_HOST_NET_DELAY_MS (default 0) in place of
+ * Wi-Fi association and DHCP.
+ */
+esp_err_t hal_network_connect(void);
+
+/**
+ * @brief Read a value saved with hal_nvs_set_u16()
+ * @return ESP_OK, or an error if it was never saved
+ */
+esp_err_t hal_nvs_get_u16(const char *key, uint16_t *value);
+
+/**
+ * @brief Save a value across reboots; costs a flash write, occasionally an erase
+ *
+ * Keys are at most 15 characters. The host backend keeps the values in
+ * $DOOR_HOST_FLASH_DIR/nvs.bin when that is set, in memory otherwise.
+ */
+esp_err_t hal_nvs_set_u16(const char *key, uint16_t value);
+
+/**
+ * @brief Currently free heap in bytes
+ */
+uint32_t hal_free_heap_size(void);
+
+/**
+ * @brief Lowest free heap since boot in bytes
+ */
+uint32_t hal_min_free_heap_size(void);
+
+/**
+ * @brief Human readable platform/SDK version string
+ */
+const char *hal_platform_version(void);
+
+/**
+ * @brief Version string of the running firmware image
+ */
+const char *hal_firmware_version(void);
+
+/**
+ * @brief Monotonic time in microseconds
+ */
+int64_t hal_time_us(void);
+
+/* ------------------------------------------------------------------------- */
+/* Tasks                                                                     */
+/* ------------------------------------------------------------------------- */
+
+#define HAL_CORE_ANY        -1
+#define HAL_WAIT_FOREVER    UINT32_MAX
+
+typedef struct hal_task hal_task_t;
+typedef void (*hal_task_fn_t)(void *arg);
+
+/**
+ * @brief Create a task, optionally pinned to a core
+ * @param core Core id, or HAL_CORE_ANY; ignored by the host backend
+ * @param priority FreeRTOS priority; ignored by the host backend
+ * @return Task handle, or NULL on failure
+ */
+hal_task_t *hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size,
+                            void *arg, int priority, int core);
+
+/**
+ * @brief Storage for a task that takes nothing from the heap
+ *
+ * Declare with HAL_TASK_STORAGE() at file scope and pass to
+ * hal_task_create_static().
+ */
+typedef struct {
+    hal_task_tcb_t tcb;
+    hal_stack_t *stack;
+    uint32_t stack_size;        // bytes
+} hal_task_storage_t;
+
+#ifdef ESP_PLATFORM
+#define HAL_TASK_STORAGE(name, stack_bytes)                                         \
+    static hal_stack_t name##_stack[(stack_bytes) / sizeof(hal_stack_t)];          \
+    static hal_task_storage_t name = { .stack = name##_stack, .stack_size = (stack_bytes) }
+#else
+#define HAL_TASK_STORAGE(name, stack_bytes)                                         \
+    static hal_task_storage_t name = { .stack_size = (stack_bytes) }
+#endif
+
+/**
+ * @brief hal_task_create() with a statically allocated stack and control block
+ * @param storage Declared with HAL_TASK_STORAGE(), used by one task only
+ */
+hal_task_t *hal_task_create_static(hal_task_fn_t fn, const char *name, hal_task_storage_t *storage,
+                                   void *arg, int priority, int core);
+
+/**
+ * @brief Wake a task blocked in hal_task_wait_notify()
+ */
+void hal_task_notify(hal_task_t *task);
+
+/**
+ * @brief hal_task_notify() for interrupt handlers; yields on exit if the task is now runnable
+ */
+void hal_task_notify_from_isr(hal_task_t *task);
+
+/**
+ * @brief Block the calling task until notified or the timeout expires
+ * @param timeout_ms Milliseconds, or HAL_WAIT_FOREVER
+ * @return true if a notification was received
+ */
+bool hal_task_wait_notify(uint32_t timeout_ms);
+
+/**
+ * @brief Index of the core the caller runs on
+ */
+int hal_core_id(void);
+
+typedef esp_err_t (*hal_core_fn_t)(void *arg);
+
+/**
+ * @brief Run a function on a core and wait for its result
+ *
+ * Interrupts are allocated on the core that installs them, so drivers set
+ * up through this have their handlers on that core. The host backend calls
+ * fn directly.
+ * @param core Core id, or HAL_CORE_ANY to run on the caller's core
+ */
+esp_err_t hal_run_on_core(int core, hal_core_fn_t fn, void *arg);
+
+/**
+ * @brief Cumulative time a core has spent in its idle task, in microseconds
+ *
+ * The counter wraps; callers use the difference between two samples. The
+ * host backend reports wall time not spent on the CPU by the process.
+ * @return false if the platform keeps no run-time statistics
+ */
+bool hal_core_idle_us(int core, uint32_t *idle_us);
+
+typedef struct {
+    const char *name;           // valid while the task exists
+    uint32_t id;                // unique per task, stable across calls
+    int core;                   // HAL_CORE_ANY if not pinned or unknown
+    int priority;
+    uint32_t run_time_us;       // cumulative, wraps; 0 without run-time statistics
+    uint32_t stack_free_min;    // lowest free stack ever in bytes; 0 if unknown
+} hal_task_info_t;
+
+/**
+ * @brief Snapshot of every task in the system
+ *
+ * Not reentrant: one task should own the call.
+ * @return Number of entries written, or -1 if tasks cannot be listed (more
+ *         than max tasks, or no trace facility)
+ */
+int hal_task_list(hal_task_info_t *tasks, int max);
+
+/**
+ * @brief Enter a short core-local critical section
+ *
+ * Masks interrupts on the calling core only, so no other task or ISR on this
+ * core can interleave and the caller cannot migrate; other cores keep running.
+ * The host backend serialises callers with a mutex instead.
+ * @return State to pass to hal_core_unlock()
+ */
+uint32_t hal_core_lock(void);
+
+/**
+ * @brief Leave the critical section entered with hal_core_lock()
+ */
+void hal_core_unlock(uint32_t state);
+
+/* ------------------------------------------------------------------------- */
+/* GPIO                                                                      */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Configure a pin as push-pull output without pulls or interrupts
+ */
+esp_err_t hal_gpio_config_output(int pin);
+
+/**
+ * @brief Drive an output pin
+ */
+void hal_gpio_set_level(int pin, int level);
+
+typedef void (*hal_gpio_isr_t)(void *arg);
+
+/**
+ * @brief Configure a pin as input, optionally with an any-edge interrupt
+ * @param pull_up Enable the internal pull-up (switches wired to ground)
+ * @param isr Interrupt handler, or NULL for a polled input; it runs in
+ *            interrupt context and must only use ISR-safe calls
+ */
+esp_err_t hal_gpio_config_input(int pin, bool pull_up, hal_gpio_isr_t isr, void *arg);
+
+/**
+ * @brief Read a pin; safe from interrupt handlers
+ */
+int hal_gpio_get_level(int pin);
+
+/* ------------------------------------------------------------------------- */
+/* Echo ranging                                                              */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Echo measurement callback, runs in interrupt context
+ * @param width_us Width of the echo pulse in microseconds
+ */
+typedef void (*hal_echo_cb_t)(uint32_t width_us, void *arg);
+
+/**
+ * @brief Set up hardware-timed trigger and echo capture for an HC-SR04 style sensor
+ *
+ * The trigger pulse is generated and the echo width measured by a timer
+ * peripheral (RMT on the ESP32), so no CPU time is spent timing edges.
+ * @param max_width_us Echoes longer than this (out of range) are not reported
+ */
+esp_err_t hal_echo_init(int trigger_pin, int echo_pin, uint32_t max_width_us, hal_echo_cb_t cb, void *arg);
+
+/**
+ * @brief Arm the capture and send one trigger pulse; returns immediately
+ *
+ * The callback fires once the echo has ended. No callback follows if there
+ * is no echo; the next trigger re-arms the capture.
+ */
+esp_err_t hal_echo_trigger(void);
+
+/* ------------------------------------------------------------------------- */
+/* Flash partitions                                                          */
+/* ------------------------------------------------------------------------- */
+
+#define HAL_FLASH_SECTOR_SIZE   4096
+
+typedef struct hal_flash hal_flash_t;
+
+/**
+ * @brief Open a data partition by label
+ *
+ * The host backend keeps each partition in memory, or in
+ * $DOOR_HOST_FLASH_DIR/<label>.bin when that is set so it survives a
+ * restart; it has DOOR_HOST_FLASH_SIZE bytes (default 64 KB).
+ * @return Partition handle, or NULL if there is no such partition
+ */
+hal_flash_t *hal_flash_open(const char *label);
+
+/**
+ * @brief Size of a partition in bytes, a multiple of HAL_FLASH_SECTOR_SIZE
+ */
+uint32_t hal_flash_size(const hal_flash_t *flash);
+
+esp_err_t hal_flash_read(hal_flash_t *flash, uint32_t offset, void *dst, size_t len);
+
+/**
+ * @brief Program bytes; like NOR flash this can only clear bits of erased (0xFF) bytes
+ */
+esp_err_t hal_flash_write(hal_flash_t *flash, uint32_t offset, const void *src, size_t len);
+
+/**
+ * @brief Erase whole sectors to 0xFF
+ * @param offset, len Multiples of HAL_FLASH_SECTOR_SIZE
+ */
+esp_err_t hal_flash_erase(hal_flash_t *flash, uint32_t offset, size_t len);
+
+/* ------------------------------------------------------------------------- */
+/* MQTT                                                                      */
+/* ------------------------------------------------------------------------- */
+
+typedef struct hal_mqtt_client hal_mqtt_client_t;
+
+typedef enum {
+    HAL_MQTT_EVENT_CONNECTED,
+    HAL_MQTT_EVENT_DISCONNECTED,
+    HAL_MQTT_EVENT_SUBSCRIBED,
+    HAL_MQTT_EVENT_PUBLISHED,
+    HAL_MQTT_EVENT_DATA,
+    HAL_MQTT_EVENT_ERROR,
+    HAL_MQTT_EVENT_OTHER
+} hal_mqtt_event_id_t;
+
+/**
+ * @brief Transport independent view of an MQTT client event
+ *
+ * Pointers are only valid for the duration of the event callback.
+ */
+typedef struct {
+    hal_mqtt_event_id_t event_id;
+    int raw_event_id;               // backend specific id, for logging
+    hal_mqtt_client_t *client;
+    int msg_id;
+    const char *topic;
+    int topic_len;
+    const char *data;
+    int data_len;
+    int current_data_offset;
+    int total_data_len;
+    // MQTT5 request/response properties of a DATA event (first fragment only)
+    const char *response_topic;
+    int response_topic_len;
+    const char *correlation_data;
+    int correlation_data_len;
+    // QoS1 redelivery flag and MQTT5 user property "seq" (unsigned decimal) of a DATA event
+    bool dup;
+    bool has_seq;
+    uint32_t seq;
+    // CONNECTED: the broker resumed the previous session (subscriptions kept)
+    bool session_present;
+    // MQTT_EVENT_ERROR details
+    int connect_return_code;
+    bool transport_error;
+    int tls_last_err;
+    int tls_stack_err;
+    int sock_errno;
+} hal_mqtt_event_t;
+
+/**
+ * @brief Optional MQTT5 properties of an outgoing publish
+ */
+typedef struct {
+    const char *correlation_data;
+    int correlation_data_len;
+    // Fixed alias for this topic, 0 for none. After the first publish on a
+    // connection only the alias is sent; dropped if the broker accepts fewer.
+    uint16_t topic_alias;
+} hal_mqtt_publish_props_t;
+
+typedef void (*hal_mqtt_event_cb_t)(const hal_mqtt_event_t *event, void *arg);
+
+typedef struct {
+    const char *broker_uri;
+    const char *lwt_topic;
+    const char *lwt_msg;
+    int lwt_qos;
+    bool lwt_retain;
+    uint16_t topic_alias_maximum;   // aliases the broker may use for topics it sends us, 0 for none
+    // Broker keeps the session (subscriptions, queued QoS1 messages) this long
+    // after a disconnect; 0 starts every connection clean
+    uint32_t session_expiry_s;
+    // Reconnect after a random delay up to base doubled per failed attempt,
+    // capped at max (backoff.h); base must be non-zero
+    uint32_t reconnect_base_ms;
+    uint32_t reconnect_max_ms;
+} hal_mqtt_config_t;
+
+/**
+ * @brief Create and start an MQTT 5 client
+ * @param cfg Broker and last-will configuration
+ * @param cb Callback invoked from the client task for every event
+ * @param arg Opaque pointer handed back to the callback
+ * @return Client handle, or NULL on failure
+ */
+hal_mqtt_client_t *hal_mqtt_start(const hal_mqtt_config_t *cfg, hal_mqtt_event_cb_t cb, void *arg);
+
+/**
+ * @brief Publish a message
+ *
+ * Safe from any task but the client's own: publishing from the event
+ * callback can deadlock with a publish in progress on another task. This
+ * applies to hal_mqtt_enqueue() and hal_mqtt_enqueue_with_props() too.
+ * @param len Payload length, 0 to use strlen(data)
+ * @return Message id (0 for QoS 0), or -1 on failure
+ */
+int hal_mqtt_publish(hal_mqtt_client_t *client, const char *topic, const char *data, int len, int qos, int retain);
+
+/**
+ * @brief Queue a message in the client outbox without waiting for the network
+ *
+ * Unlike hal_mqtt_publish() this never blocks on the socket; the MQTT task
+ * sends the message on its next iteration.
+ * @return Message id, or -1 on failure
+ */
+int hal_mqtt_enqueue(hal_mqtt_client_t *client, const char *topic, const char *data, int len, int qos, int retain);
+
+/**
+ * @brief hal_mqtt_enqueue() with MQTT5 publish properties
+ * @param props Properties for this message only, may be NULL
+ */
+int hal_mqtt_enqueue_with_props(hal_mqtt_client_t *client, const char *topic, const char *data, int len,
+                                int qos, int retain, const hal_mqtt_publish_props_t *props);
+
+/**
+ * @brief Subscribe to a topic
+ * @return Message id, or -1 on failure
+ */
+int hal_mqtt_subscribe(hal_mqtt_client_t *client, const char *topic, int qos);
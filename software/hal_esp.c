@@ -0,0 +1,677 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file hal_esp.c
+ * @brief ESP-IDF backend of the door HAL
+ */
+
+#ifdef ESP_PLATFORM
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_app_desc.h"
+#include "nvs_flash.h"
+#include "esp_partition.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "protocol_examples_common.h"
+#include "mqtt_client.h"
+#include "driver/gpio.h"
+#include "driver/rmt_tx.h"
+#include "driver/rmt_rx.h"
+#include "hal.h"
+#include "backoff.h"
+#include "task_layout.h"
+
+#define CORE_CALL_STACK_SIZE    4096
+#define TASK_LIST_MAX           32
+#define FLASH_PARTITIONS_MAX    4
+#define NVS_NAMESPACE           "door"
+
+// The network stack belongs on TASK_NET_CORE; sdkconfig.defaults says so, an sdkconfig may not
+#if !CONFIG_FREERTOS_UNICORE
+#if !CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED || !CONFIG_MQTT_USE_CORE_0
+#warning "esp-mqtt task is not pinned to core 0: set CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED and CONFIG_MQTT_USE_CORE_0"
+#endif
+#if !CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU0
+#warning "lwIP tcpip task is not pinned to core 0: set CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU0"
+#endif
+#endif
+
+static const char *TAG = "hal_esp";
+
+struct hal_mqtt_client {
+    esp_mqtt_client_handle_t handle;
+    hal_mqtt_event_cb_t cb;
+    void *arg;
+    SemaphoreHandle_t props_lock;   // held from setting publish properties to queueing the message
+    StaticSemaphore_t props_lock_buf;
+    _Atomic bool aliases_refused;   // the broker accepts fewer topic aliases, until reconnect
+    esp_timer_handle_t reconnect_timer;
+    backoff_t backoff;              // MQTT task only
+};
+
+// Only one broker connection is used by the firmware
+static struct hal_mqtt_client s_mqtt_client;
+
+struct hal_flash {
+    const esp_partition_t *partition;
+};
+
+static struct hal_flash s_flash[FLASH_PARTITIONS_MAX];
+static nvs_handle_t s_nvs;
+
+#define ECHO_RESOLUTION_HZ      1000000     // 1 tick = 1 us
+#define ECHO_TRIGGER_US         10
+#define ECHO_RX_SYMBOLS         64
+
+static struct {
+    rmt_channel_handle_t tx;
+    rmt_channel_handle_t rx;
+    rmt_encoder_handle_t encoder;
+    rmt_receive_config_t rx_config;
+    rmt_symbol_word_t rx_symbols[ECHO_RX_SYMBOLS];
+    bool armed;
+    hal_echo_cb_t cb;
+    void *arg;
+} s_echo;
+
+esp_err_t hal_storage_init(void)
+{
+    esp_err_t err = nvs_flash_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    return nvs_open(NVS_NAMESPACE, NVS_READWRITE, &s_nvs);
+}
+
+esp_err_t hal_platform_init(void)
+{
+    esp_err_t err = esp_netif_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    return esp_event_loop_create_default();
+}
+
+esp_err_t hal_network_connect(void)
+{
+    return example_connect();
+}
+
+esp_err_t hal_nvs_get_u16(const char *key, uint16_t *value)
+{
+    return nvs_get_u16(s_nvs, key, value);
+}
+
+esp_err_t hal_nvs_set_u16(const char *key, uint16_t value)
+{
+    esp_err_t err = nvs_set_u16(s_nvs, key, value);
+    return err == ESP_OK ? nvs_commit(s_nvs) : err;
+}
+
+uint32_t hal_free_heap_size(void)
+{
+    return esp_get_free_heap_size();
+}
+
+uint32_t hal_min_free_heap_size(void)
+{
+    return esp_get_minimum_free_heap_size();
+}
+
+const char *hal_platform_version(void)
+{
+    return esp_get_idf_version();
+}
+
+const char *hal_firmware_version(void)
+{
+    return esp_app_get_description()->version;
+}
+
+int64_t hal_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+hal_task_t *hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size,
+                            void *arg, int priority, int core)
+{
+    TaskHandle_t handle = NULL;
+    BaseType_t core_id = core == HAL_CORE_ANY ? tskNO_AFFINITY : core;
+
+    if (xTaskCreatePinnedToCore(fn, name, stack_size, arg, priority, &handle, core_id) != pdPASS) {
+        return NULL;
+    }
+    return (hal_task_t *)handle;
+}
+
+hal_task_t *hal_task_create_static(hal_task_fn_t fn, const char *name, hal_task_storage_t *storage,
+                                   void *arg, int priority, int core)
+{
+    BaseType_t core_id = core == HAL_CORE_ANY ? tskNO_AFFINITY : core;
+    // Stack depth is counted in StackType_t, which is a byte on ESP-IDF
+    return (hal_task_t *)xTaskCreateStaticPinnedToCore(fn, name, storage->stack_size / sizeof(StackType_t), arg,
+                                                       priority, storage->stack, &storage->tcb, core_id);
+}
+
+void hal_task_notify(hal_task_t *task)
+{
+    xTaskNotifyGive((TaskHandle_t)task);
+}
+
+void hal_task_notify_from_isr(hal_task_t *task)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR((TaskHandle_t)task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+bool hal_task_wait_notify(uint32_t timeout_ms)
+{
+    // Round up: a short timeout must not become a zero-tick poll
+    TickType_t ticks = timeout_ms == HAL_WAIT_FOREVER ? portMAX_DELAY :
+                       (timeout_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    return ulTaskNotifyTake(pdTRUE, ticks) != 0;
+}
+
+int hal_core_id(void)
+{
+    return xPortGetCoreID();
+}
+
+typedef struct {
+    hal_core_fn_t fn;
+    void *arg;
+    esp_err_t result;
+    TaskHandle_t caller;
+} core_call_t;
+
+static void core_call_task(void *arg)
+{
+    core_call_t *call = arg;
+    call->result = call->fn(call->arg);
+    xTaskNotifyGive(call->caller);
+    vTaskDelete(NULL);
+}
+
+esp_err_t hal_run_on_core(int core, hal_core_fn_t fn, void *arg)
+{
+    if (core == HAL_CORE_ANY) {
+        return fn(arg);
+    }
+    // A short-lived pinned task: the caller may not be pinned itself
+    core_call_t call = { .fn = fn, .arg = arg, .result = ESP_FAIL, .caller = xTaskGetCurrentTaskHandle() };
+    if (xTaskCreatePinnedToCore(core_call_task, "core_call", CORE_CALL_STACK_SIZE, &call,
+                                uxTaskPriorityGet(NULL), NULL, core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return call.result;
+}
+
+int hal_task_list(hal_task_info_t *tasks, int max)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    static TaskStatus_t s_status[TASK_LIST_MAX];
+    // Zero when the array is too small for all tasks
+    int count = (int)uxTaskGetSystemState(s_status, TASK_LIST_MAX, NULL);
+    if (count == 0 || count > max) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        const TaskStatus_t *status = &s_status[i];
+        tasks[i] = (hal_task_info_t) {
+            .name = status->pcTaskName,
+            .id = status->xTaskNumber,
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+            .core = status->xCoreID == tskNO_AFFINITY ? HAL_CORE_ANY : (int)status->xCoreID,
+#else
+            .core = HAL_CORE_ANY,
+#endif
+            .priority = (int)status->uxCurrentPriority,
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+            .run_time_us = (uint32_t)status->ulRunTimeCounter,
+#endif
+            // StackType_t is a byte on ESP-IDF, so the high-water mark is in bytes
+            .stack_free_min = status->usStackHighWaterMark,
+        };
+    }
+    return count;
+#else
+    return -1;
+#endif
+}
+
+bool hal_core_idle_us(int core, uint32_t *idle_us)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER
+    *idle_us = (uint32_t)ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint32_t hal_core_lock(void)
+{
+    return portSET_INTERRUPT_MASK_FROM_ISR();
+}
+
+void hal_core_unlock(uint32_t state)
+{
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+esp_err_t hal_gpio_config_output(int pin)
+{
+    gpio_config_t io_config = {
+        .pin_bit_mask = (1ULL << pin),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+
+    return gpio_config(&io_config);
+}
+
+void hal_gpio_set_level(int pin, int level)
+{
+    gpio_set_level((gpio_num_t)pin, level);
+}
+
+esp_err_t hal_gpio_config_input(int pin, bool pull_up, hal_gpio_isr_t isr, void *arg)
+{
+    gpio_config_t io_config = {
+        .pin_bit_mask = (1ULL << pin),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = pull_up ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = isr != NULL ? GPIO_INTR_ANYEDGE : GPIO_INTR_DISABLE
+    };
+
+    esp_err_t err = gpio_config(&io_config);
+    if (err != ESP_OK || isr == NULL) {
+        return err;
+    }
+    // The per-pin dispatch service is shared; it is already installed after the first input
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+    return gpio_isr_handler_add((gpio_num_t)pin, isr, arg);
+}
+
+int hal_gpio_get_level(int pin)
+{
+    return gpio_get_level((gpio_num_t)pin);
+}
+
+/**
+ * @brief RMT receive complete: report the width of the first high pulse
+ */
+static bool echo_rx_done(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *data, void *user_ctx)
+{
+    s_echo.armed = false;
+    for (size_t i = 0; i < data->num_symbols; i++) {
+        const rmt_symbol_word_t *symbol = &data->received_symbols[i];
+        if (symbol->level0 == 1) {
+            s_echo.cb(symbol->duration0, s_echo.arg);
+            break;
+        }
+        if (symbol->level1 == 1) {
+            s_echo.cb(symbol->duration1, s_echo.arg);
+            break;
+        }
+    }
+    return false;   // the callback yields through hal_task_notify_from_isr()
+}
+
+esp_err_t hal_echo_init(int trigger_pin, int echo_pin, uint32_t max_width_us, hal_echo_cb_t cb, void *arg)
+{
+    rmt_tx_channel_config_t tx_config = {
+        .gpio_num = trigger_pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = ECHO_RESOLUTION_HZ,
+        .mem_block_symbols = 64,
+        .trans_queue_depth = 1,
+    };
+    rmt_rx_channel_config_t rx_config = {
+        .gpio_num = echo_pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = ECHO_RESOLUTION_HZ,
+        .mem_block_symbols = ECHO_RX_SYMBOLS,
+    };
+    rmt_copy_encoder_config_t encoder_config = {};
+    rmt_rx_event_callbacks_t callbacks = {
+        .on_recv_done = echo_rx_done,
+    };
+
+    s_echo.cb = cb;
+    s_echo.arg = arg;
+    // Reception ends once the line has been idle longer than the longest echo of interest
+    s_echo.rx_config.signal_range_min_ns = 1000;
+    s_echo.rx_config.signal_range_max_ns = max_width_us * 1000;
+
+    esp_err_t err = rmt_new_tx_channel(&tx_config, &s_echo.tx);
+    if (err == ESP_OK) {
+        err = rmt_new_rx_channel(&rx_config, &s_echo.rx);
+    }
+    if (err == ESP_OK) {
+        err = rmt_new_copy_encoder(&encoder_config, &s_echo.encoder);
+    }
+    if (err == ESP_OK) {
+        err = rmt_rx_register_event_callbacks(s_echo.rx, &callbacks, NULL);
+    }
+    if (err == ESP_OK) {
+        err = rmt_enable(s_echo.tx);
+    }
+    if (err == ESP_OK) {
+        err = rmt_enable(s_echo.rx);
+    }
+    return err;
+}
+
+esp_err_t hal_echo_trigger(void)
+{
+    static const rmt_symbol_word_t trigger = {
+        .level0 = 1, .duration0 = ECHO_TRIGGER_US,
+        .level1 = 0, .duration1 = 1,
+    };
+    static const rmt_transmit_config_t tx_config = { 0 };
+
+    if (s_echo.armed) {
+        // The previous trigger got no echo: restart the receiver
+        rmt_disable(s_echo.rx);
+        rmt_enable(s_echo.rx);
+    }
+    esp_err_t err = rmt_receive(s_echo.rx, s_echo.rx_symbols, sizeof(s_echo.rx_symbols), &s_echo.rx_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_echo.armed = true;
+    return rmt_transmit(s_echo.tx, s_echo.encoder, &trigger, sizeof(trigger), &tx_config);
+}
+
+hal_flash_t *hal_flash_open(const char *label)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < FLASH_PARTITIONS_MAX; i++) {
+        if (s_flash[i].partition == NULL || s_flash[i].partition == partition) {
+            s_flash[i].partition = partition;
+            return &s_flash[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t hal_flash_size(const hal_flash_t *flash)
+{
+    return flash->partition->size;
+}
+
+esp_err_t hal_flash_read(hal_flash_t *flash, uint32_t offset, void *dst, size_t len)
+{
+    return esp_partition_read(flash->partition, offset, dst, len);
+}
+
+esp_err_t hal_flash_write(hal_flash_t *flash, uint32_t offset, const void *src, size_t len)
+{
+    return esp_partition_write(flash->partition, offset, src, len);
+}
+
+esp_err_t hal_flash_erase(hal_flash_t *flash, uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range(flash->partition, offset, len);
+}
+
+#define SEQ_PROPERTY_KEY        "seq"
+#define USER_PROPERTIES_MAX     8
+
+/**
+ * @brief Find the "seq" user property of a DATA event and parse it
+ *
+ * esp-mqtt hands out copies of the user properties that the caller frees.
+ * @return false if the property is absent or not an unsigned decimal
+ */
+static bool get_seq_property(mqtt5_user_property_handle_t user_property, uint32_t *seq)
+{
+    esp_mqtt5_user_property_item_t items[USER_PROPERTIES_MAX];
+    uint8_t count = esp_mqtt5_client_get_user_property_len(user_property);
+    if (count == 0) {
+        return false;
+    }
+    if (count > USER_PROPERTIES_MAX) {
+        count = USER_PROPERTIES_MAX;
+    }
+    if (esp_mqtt5_client_get_user_property(user_property, items, &count) != ESP_OK) {
+        return false;
+    }
+
+    bool found = false;
+    for (int i = 0; i < count; i++) {
+        if (!found && strcmp(items[i].key, SEQ_PROPERTY_KEY) == 0) {
+            char *end;
+            *seq = (uint32_t)strtoul(items[i].value, &end, 10);
+            found = end != items[i].value && *end == '\0';
+        }
+        free((char *)items[i].key);
+        free((char *)items[i].value);
+    }
+    return found;
+}
+
+/**
+ * @brief Reconnect timer: end the client's wait for its next connection attempt
+ */
+static void reconnect_timer_cb(void *arg)
+{
+    hal_mqtt_client_t *client = arg;
+    esp_mqtt_client_reconnect(client->handle);
+}
+
+/**
+ * @brief Arm the reconnect timer with the next backoff delay
+ *
+ * esp-mqtt dispatches DISCONNECTED after every lost connection and failed
+ * attempt, then waits its fixed reconnect_timeout_ms (set to the backoff
+ * cap); the timer cuts that wait short.
+ */
+static void schedule_reconnect(hal_mqtt_client_t *client)
+{
+    uint32_t delay_ms = backoff_next_ms(&client->backoff, esp_random());
+    esp_timer_stop(client->reconnect_timer);
+    if (esp_timer_start_once(client->reconnect_timer, (uint64_t)delay_ms * 1000) == ESP_OK) {
+        ESP_LOGI(TAG, "Reconnecting in %" PRIu32 " ms", delay_ms);
+    }
+}
+
+/**
+ * @brief Translate esp-mqtt events into HAL events
+ */
+static void mqtt_event_trampoline(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%" PRIi32, base, event_id);
+    hal_mqtt_client_t *client = handler_args;
+    esp_mqtt_event_handle_t event = event_data;
+
+    hal_mqtt_event_t hal_event = {
+        .raw_event_id = event->event_id,
+        .client = client,
+        .msg_id = event->msg_id,
+        .topic = event->topic,
+        .topic_len = event->topic_len,
+        .data = event->data,
+        .data_len = event->data_len,
+        .current_data_offset = event->current_data_offset,
+        .total_data_len = event->total_data_len,
+        .dup = event->dup,
+    };
+
+    if (event->property != NULL) {
+        hal_event.response_topic = event->property->response_topic;
+        hal_event.response_topic_len = event->property->response_topic_len;
+        hal_event.correlation_data = (const char *)event->property->correlation_data;
+        hal_event.correlation_data_len = event->property->correlation_data_len;
+        if (event_id == MQTT_EVENT_DATA && event->current_data_offset == 0) {
+            hal_event.has_seq = get_seq_property(event->property->user_property, &hal_event.seq);
+        }
+    }
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        hal_event.event_id = HAL_MQTT_EVENT_CONNECTED;
+        hal_event.session_present = event->session_present;
+        client->aliases_refused = false;
+        backoff_reset(&client->backoff);
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        hal_event.event_id = HAL_MQTT_EVENT_DISCONNECTED;
+        schedule_reconnect(client);
+        break;
+    case MQTT_EVENT_SUBSCRIBED:
+        hal_event.event_id = HAL_MQTT_EVENT_SUBSCRIBED;
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        hal_event.event_id = HAL_MQTT_EVENT_PUBLISHED;
+        break;
+    case MQTT_EVENT_DATA:
+        hal_event.event_id = HAL_MQTT_EVENT_DATA;
+        break;
+    case MQTT_EVENT_ERROR:
+        hal_event.event_id = HAL_MQTT_EVENT_ERROR;
+        hal_event.connect_return_code = event->error_handle->connect_return_code;
+        hal_event.transport_error = event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT;
+        hal_event.tls_last_err = event->error_handle->esp_tls_last_esp_err;
+        hal_event.tls_stack_err = event->error_handle->esp_tls_stack_err;
+        hal_event.sock_errno = event->error_handle->esp_transport_sock_errno;
+        break;
+    default:
+        hal_event.event_id = HAL_MQTT_EVENT_OTHER;
+        break;
+    }
+
+    client->cb(&hal_event, client->arg);
+}
+
+hal_mqtt_client_t *hal_mqtt_start(const hal_mqtt_config_t *cfg, hal_mqtt_event_cb_t cb, void *arg)
+{
+    esp_mqtt_client_config_t mqtt5_cfg = {
+        .broker.address.uri = cfg->broker_uri,
+        .session.protocol_ver = MQTT_PROTOCOL_V_5,
+        .network.disable_auto_reconnect = false,
+        .network.reconnect_timeout_ms = cfg->reconnect_max_ms,
+        .session.disable_clean_session = cfg->session_expiry_s != 0,
+        .session.last_will.topic = cfg->lwt_topic,
+        .session.last_will.msg = cfg->lwt_msg,
+        .session.last_will.msg_len = cfg->lwt_msg ? strlen(cfg->lwt_msg) : 0,
+        .session.last_will.qos = cfg->lwt_qos,
+        .session.last_will.retain = cfg->lwt_retain,
+        .task.priority = TASK_MQTT_PRIORITY,
+    };
+
+    hal_mqtt_client_t *client = &s_mqtt_client;
+    client->cb = cb;
+    client->arg = arg;
+    client->props_lock = xSemaphoreCreateMutexStatic(&client->props_lock_buf);
+    client->backoff = (backoff_t) { .base_ms = cfg->reconnect_base_ms, .max_ms = cfg->reconnect_max_ms };
+    const esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_cb,
+        .arg = client,
+        .name = "mqtt_reconnect",
+    };
+    if (esp_timer_create(&timer_args, &client->reconnect_timer) != ESP_OK) {
+        return NULL;
+    }
+    client->handle = esp_mqtt_client_init(&mqtt5_cfg);
+    if (client->handle == NULL) {
+        return NULL;
+    }
+    esp_mqtt5_connection_property_config_t connect_property = {
+        .session_expiry_interval = cfg->session_expiry_s,
+        // esp-mqtt resolves the aliases the broker then uses for incoming topics
+        .topic_alias_maximum = cfg->topic_alias_maximum,
+    };
+    esp_mqtt5_client_set_connect_property(client->handle, &connect_property);
+    esp_mqtt_client_register_event(client->handle, ESP_EVENT_ANY_ID, mqtt_event_trampoline, client);
+    if (esp_mqtt_client_start(client->handle) != ESP_OK) {
+        return NULL;
+    }
+    return client;
+}
+
+/**
+ * @brief Load the properties used by the next publish; caller holds props_lock
+ *
+ * Every publish sets them, empty when props is NULL, so no message relies on
+ * what an earlier one left in the client. The set and the publish are two
+ * API calls and several tasks publish: props_lock keeps another task's
+ * publish from taking these properties, or replacing them, in between. It is
+ * never taken on the MQTT task, which holds esp-mqtt's API lock while it runs
+ * the event callback.
+ * @return ESP_OK, or the error of esp_mqtt5_client_set_publish_property()
+ */
+static esp_err_t set_publish_props(hal_mqtt_client_t *client, const hal_mqtt_publish_props_t *props)
+{
+    esp_mqtt5_publish_property_config_t property = { 0 };
+    if (props != NULL) {
+        property.correlation_data = props->correlation_data;
+        property.correlation_data_len = props->correlation_data_len;
+        property.topic_alias = client->aliases_refused ? 0 : props->topic_alias;
+    }
+    return esp_mqtt5_client_set_publish_property(client->handle, &property);
+}
+
+int hal_mqtt_publish(hal_mqtt_client_t *client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    int msg_id = -1;
+    xSemaphoreTake(client->props_lock, portMAX_DELAY);
+    if (set_publish_props(client, NULL) == ESP_OK) {
+        msg_id = esp_mqtt_client_publish(client->handle, topic, data, len, qos, retain);
+    }
+    xSemaphoreGive(client->props_lock);
+    return msg_id;
+}
+
+int hal_mqtt_enqueue(hal_mqtt_client_t *client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    return hal_mqtt_enqueue_with_props(client, topic, data, len, qos, retain, NULL);
+}
+
+int hal_mqtt_enqueue_with_props(hal_mqtt_client_t *client, const char *topic, const char *data, int len,
+                                int qos, int retain, const hal_mqtt_publish_props_t *props)
+{
+    xSemaphoreTake(client->props_lock, portMAX_DELAY);
+    esp_err_t err = set_publish_props(client, props);
+    if (err != ESP_OK && props != NULL && props->topic_alias != 0 && !client->aliases_refused) {
+        // esp-mqtt rejects aliases above the Topic Alias Maximum of the broker's CONNACK
+        ESP_LOGW(TAG, "Topic alias %u refused by the broker, sending full topics", props->topic_alias);
+        client->aliases_refused = true;
+        err = set_publish_props(client, props);
+    }
+    int msg_id = err == ESP_OK ? esp_mqtt_client_enqueue(client->handle, topic, data, len, qos, retain, true) : -1;
+    xSemaphoreGive(client->props_lock);
+    return msg_id;
+}
+
+int hal_mqtt_subscribe(hal_mqtt_client_t *client, const char *topic, int qos)
+{
+    return esp_mqtt_client_subscribe(client->handle, topic, qos);
+}
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,1250 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file hal_posix.c
+ * @brief Linux backend of the door HAL
+ *
+ * GPIO writes are recorded in memory and the MQTT client is replaced by a
+ * UDP broker stand-in: every datagram is one PUBLISH, framed as
+ *
+ *     <topic>\n
+ *     <property>:<value>\n     (zero or more, unknown ones are ignored)
+ *     \n
+ *     <payload>
+ *
+ * Recognised properties are response-topic (text) and correlation-data
+ * (hex encoded), in both directions. Incoming commands may also carry
+ * packet-id and dup:1, as a broker redelivering a QoS1 message would, and
+ * seq for the MQTT5 user property of that name. Outgoing publishes with a
+ * topic alias carry a topic-alias line; like on the wire, the topic line is
+ * left empty once the alias has been sent with its topic. The peer accepts
+ * DOOR_HOST_TOPIC_ALIAS_MAX aliases (default 10, 0 for none).
+ *
+ * Input pins are driven through the same socket: a datagram on the reserved
+ * topic $hal/gpio with payload "<pin>=<level>[ <pin>=<level>...]" applies the
+ * levels in order and runs the pin's interrupt handler on every change, from
+ * the client thread. $hal/echo with payload "<width_us>" sets the echo every
+ * later trigger returns (0 for no echo); the echo callback runs inside
+ * hal_echo_trigger().
+ *
+ * $hal/broker with payload "<down_ms>" restarts the broker: the connection
+ * drops and attempts fail for down_ms, so the client reconnects on the same
+ * backoff schedule as on the target. While disconnected, publishes fail and
+ * incoming datagrams other than $hal/ ones are dropped, except those on a
+ * QoS 1 subscription: within the session expiry interval the broker keeps
+ * the session (HAL_POSIX_SESSION_QUEUE of them, up to
+ * HAL_POSIX_SESSION_MSG_MAX bytes each) and the subscriptions, reports
+ * session_present and delivers them after the CONNECTED event, as a broker
+ * with persistence would.
+ *
+ * Flash partitions are anonymous memory, or files under DOOR_HOST_FLASH_DIR
+ * mapped shared, so a journal or queue can be inspected and survives a
+ * restart. Writes AND into the contents like NOR programming does. NVS
+ * values live in nvs.bin next to them. hal_network_connect() takes
+ * DOOR_HOST_NET_DELAY_MS (default 0), standing in for Wi-Fi and DHCP.
+ *
+ * Incoming datagrams are received on DOOR_HOST_PORT (default 18830) and
+ * delivered to the application when their topic was subscribed; outgoing
+ * publishes are sent to DOOR_HOST_PEER (default 127.0.0.1:18831). Events are
+ * dispatched from a single client thread, like the esp-mqtt task. Payloads
+ * larger than DOOR_HOST_RX_BUFFER (default 1024, the esp-mqtt buffer size)
+ * are split over several DATA events the way esp-mqtt does.
+ */
+
+#ifndef ESP_PLATFORM
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include "hal.h"
+#include "backoff.h"
+
+#define HAL_POSIX_DEFAULT_PORT          18830
+#define HAL_POSIX_DEFAULT_PEER          "127.0.0.1:18831"
+#define HAL_POSIX_MAX_DATAGRAM          65507
+#define HAL_POSIX_MAX_SUBSCRIPTIONS     8
+#define HAL_POSIX_MAX_TOPIC_LEN         128
+#define HAL_POSIX_MAX_TOPIC_ALIASES     16
+#define HAL_POSIX_DEFAULT_ALIAS_MAX     10          // mosquitto's default max_topic_alias
+#define HAL_POSIX_PENDING_EVENTS        64
+#define HAL_POSIX_POLL_MS               100
+#define HAL_POSIX_DEFAULT_RX_BUFFER     1024
+#define HAL_POSIX_GPIO_COUNT            40
+#define HAL_POSIX_MAX_TASKS             8
+#define HAL_POSIX_MAX_PROPERTY_LEN      64      // decoded correlation-data bytes
+#define HAL_POSIX_FLASH_PARTITIONS      4
+#define HAL_POSIX_DEFAULT_FLASH_SIZE    (64 * 1024)
+#define HAL_POSIX_SESSION_QUEUE         16      // mosquitto's max_queued_messages is 1000
+#define HAL_POSIX_SESSION_MSG_MAX       512
+
+static const char *TAG = "hal_posix";
+
+void app_main(void);
+
+typedef struct {
+    hal_mqtt_event_id_t event_id;
+    int msg_id;
+} pending_event_t;
+
+struct hal_flash {
+    char label[17];
+    uint8_t *data;
+    uint32_t size;
+};
+
+struct hal_task {
+    pthread_t thread;
+    sem_t notify;
+    hal_task_fn_t fn;           // NULL for threads that only wait for notifications
+    void *arg;
+    char name[16];
+};
+
+struct hal_mqtt_client {
+    int sock;
+    int wake_pipe[2];       // lets other threads interrupt poll()
+    struct sockaddr_in peer;
+    hal_mqtt_event_cb_t cb;
+    void *arg;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    atomic_int next_msg_id;
+    int rx_buffer_size;
+    hal_mqtt_config_t cfg;
+    // Guarded by lock
+    char subscriptions[HAL_POSIX_MAX_SUBSCRIPTIONS][HAL_POSIX_MAX_TOPIC_LEN];
+    int subscription_qos[HAL_POSIX_MAX_SUBSCRIPTIONS];
+    int subscription_count;
+    pending_event_t pending[HAL_POSIX_PENDING_EVENTS];
+    unsigned pending_head;
+    unsigned pending_tail;
+    int topic_alias_max;            // of the peer, as if from its CONNACK
+    char topic_aliases[HAL_POSIX_MAX_TOPIC_ALIASES][HAL_POSIX_MAX_TOPIC_LEN];
+    atomic_bool connected;
+    // Client thread only
+    backoff_t backoff;
+    int64_t reconnect_at_us;        // next attempt while disconnected
+    int64_t disconnected_at_us;     // of the session
+    int64_t broker_down_until_us;   // attempts fail until then
+    bool session;                   // the broker keeps a session for us
+    struct {
+        int len;
+        char data[HAL_POSIX_SESSION_MSG_MAX + 1];
+    } session_queue[HAL_POSIX_SESSION_QUEUE];  // QoS 1 datagrams received while disconnected
+    int session_queue_count;
+};
+
+static struct hal_mqtt_client s_mqtt_client;
+static bool s_mqtt_started;
+static volatile sig_atomic_t s_stop;
+static esp_log_level_t s_log_level = ESP_LOG_INFO;
+static _Atomic int s_gpio_level[HAL_POSIX_GPIO_COUNT];
+static hal_gpio_isr_t s_gpio_isr[HAL_POSIX_GPIO_COUNT];
+static void *s_gpio_isr_arg[HAL_POSIX_GPIO_COUNT];
+static atomic_uint s_echo_width_us;
+static uint32_t s_echo_max_width_us;
+static hal_echo_cb_t s_echo_cb;
+static void *s_echo_arg;
+static struct hal_task s_tasks[HAL_POSIX_MAX_TASKS];
+static atomic_int s_task_count;
+static __thread hal_task_t *s_current_task;
+static pthread_mutex_t s_core_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ------------------------------------------------------------------------- */
+/* Logging                                                                   */
+/* ------------------------------------------------------------------------- */
+
+void hal_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    if (level > s_log_level) {
+        return;
+    }
+
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    fprintf(stderr, "%c (%" PRId64 ") %s: %s\n", letters[level], hal_time_us() / 1000, tag, line);
+}
+
+void hal_log_level_set(const char *tag, esp_log_level_t level)
+{
+    // Per-tag levels are not modelled; only the wildcard changes the threshold
+    if (strcmp(tag, "*") == 0) {
+        s_log_level = level;
+    }
+}
+
+void hal_abort_on_error(const char *expr, esp_err_t err, const char *file, int line)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x at %s:%d\nexpression: %s\n", err, file, line, expr);
+    abort();
+}
+
+/* ------------------------------------------------------------------------- */
+/* System                                                                    */
+/* ------------------------------------------------------------------------- */
+
+esp_err_t hal_platform_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t hal_network_connect(void)
+{
+    const char *delay_env = getenv("DOOR_HOST_NET_DELAY_MS");
+    if (delay_env != NULL) {
+        long delay_ms = strtol(delay_env, NULL, 0);
+        struct timespec delay = { .tv_sec = delay_ms / 1000, .tv_nsec = delay_ms % 1000 * 1000000L };
+        nanosleep(&delay, NULL);
+    }
+    return ESP_OK;
+}
+
+uint32_t hal_free_heap_size(void)
+{
+    // No meaningful equivalent on the host
+    return 0;
+}
+
+uint32_t hal_min_free_heap_size(void)
+{
+    return 0;
+}
+
+const char *hal_platform_version(void)
+{
+    return "posix-host";
+}
+
+const char *hal_firmware_version(void)
+{
+    return "host";
+}
+
+int64_t hal_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Tasks                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Take a task slot from the static pool
+ */
+static hal_task_t *alloc_task(void)
+{
+    int index = atomic_fetch_add(&s_task_count, 1);
+    if (index >= HAL_POSIX_MAX_TASKS) {
+        return NULL;
+    }
+    hal_task_t *task = &s_tasks[index];
+    sem_init(&task->notify, 0, 0);
+    return task;
+}
+
+static void *task_trampoline(void *arg)
+{
+    hal_task_t *task = arg;
+    s_current_task = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+hal_task_t *hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size,
+                            void *arg, int priority, int core)
+{
+    // Priorities, core affinity and stack sizes are FreeRTOS concepts; threads use defaults
+    (void)stack_size;
+    (void)priority;
+    (void)core;
+
+    hal_task_t *task = alloc_task();
+    if (task == NULL) {
+        return NULL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&task->thread, NULL, task_trampoline, task) != 0) {
+        return NULL;
+    }
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    pthread_setname_np(task->thread, task->name);
+    pthread_detach(task->thread);
+    return task;
+}
+
+hal_task_t *hal_task_create_static(hal_task_fn_t fn, const char *name, hal_task_storage_t *storage,
+                                   void *arg, int priority, int core)
+{
+    // Task slots come from a static pool already; thread stacks are mapped, not taken from the heap
+    return hal_task_create(fn, name, storage->stack_size, arg, priority, core);
+}
+
+void hal_task_notify(hal_task_t *task)
+{
+    int value = 0;
+    // Notifications do not count, matching xTaskNotifyGive + ulTaskNotifyTake(pdTRUE)
+    if (sem_getvalue(&task->notify, &value) == 0 && value == 0) {
+        sem_post(&task->notify);
+    }
+}
+
+void hal_task_notify_from_isr(hal_task_t *task)
+{
+    hal_task_notify(task);
+}
+
+bool hal_task_wait_notify(uint32_t timeout_ms)
+{
+    if (s_current_task == NULL) {
+        s_current_task = alloc_task();
+        if (s_current_task == NULL) {
+            return false;
+        }
+    }
+
+    int ret;
+    if (timeout_ms == HAL_WAIT_FOREVER) {
+        while ((ret = sem_wait(&s_current_task->notify)) != 0 && errno == EINTR) {
+        }
+    } else {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while ((ret = sem_timedwait(&s_current_task->notify, &deadline)) != 0 && errno == EINTR) {
+        }
+    }
+    return ret == 0;
+}
+
+int hal_core_id(void)
+{
+    return 0;
+}
+
+esp_err_t hal_run_on_core(int core, hal_core_fn_t fn, void *arg)
+{
+    return fn(arg);
+}
+
+int hal_task_list(hal_task_info_t *tasks, int max)
+{
+    int created = atomic_load(&s_task_count);
+    int count = 0;
+    for (int i = 0; i < created && i < HAL_POSIX_MAX_TASKS; i++) {
+        hal_task_t *task = &s_tasks[i];
+        clockid_t clock;
+        struct timespec cpu;
+        if (task->fn == NULL || pthread_getcpuclockid(task->thread, &clock) != 0 ||
+            clock_gettime(clock, &cpu) != 0) {
+            continue;
+        }
+        if (count == max) {
+            return -1;
+        }
+        // Threads have no priority, affinity or stack watermark of interest here
+        tasks[count++] = (hal_task_info_t) {
+            .name = task->name,
+            .id = (uint32_t)i,
+            .core = HAL_CORE_ANY,
+            .run_time_us = (uint32_t)((int64_t)cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000),
+        };
+    }
+    return count;
+}
+
+bool hal_core_idle_us(int core, uint32_t *idle_us)
+{
+    struct timespec wall;
+    struct timespec cpu;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    int64_t idle = ((int64_t)wall.tv_sec - cpu.tv_sec) * 1000000 + (wall.tv_nsec - cpu.tv_nsec) / 1000;
+    *idle_us = (uint32_t)idle;
+    return true;
+}
+
+uint32_t hal_core_lock(void)
+{
+    pthread_mutex_lock(&s_core_lock);
+    return 0;
+}
+
+void hal_core_unlock(uint32_t state)
+{
+    (void)state;
+    pthread_mutex_unlock(&s_core_lock);
+}
+
+/* ------------------------------------------------------------------------- */
+/* GPIO                                                                      */
+/* ------------------------------------------------------------------------- */
+
+esp_err_t hal_gpio_config_output(int pin)
+{
+    if (pin < 0 || pin >= HAL_POSIX_GPIO_COUNT) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void hal_gpio_set_level(int pin, int level)
+{
+    if (pin >= 0 && pin < HAL_POSIX_GPIO_COUNT) {
+        s_gpio_level[pin] = level;
+    }
+}
+
+esp_err_t hal_gpio_config_input(int pin, bool pull_up, hal_gpio_isr_t isr, void *arg)
+{
+    if (pin < 0 || pin >= HAL_POSIX_GPIO_COUNT) {
+        return ESP_FAIL;
+    }
+    s_gpio_level[pin] = pull_up ? 1 : 0;
+    s_gpio_isr_arg[pin] = arg;
+    s_gpio_isr[pin] = isr;
+    return ESP_OK;
+}
+
+int hal_gpio_get_level(int pin)
+{
+    return pin >= 0 && pin < HAL_POSIX_GPIO_COUNT ? s_gpio_level[pin] : 0;
+}
+
+/**
+ * @brief Apply "<pin>=<level>" pairs from a $hal/gpio datagram, firing interrupt handlers
+ */
+static void inject_gpio(const char *payload, int len)
+{
+    char text[256];
+    if (len >= (int)sizeof(text)) {
+        ESP_LOGW(TAG, "GPIO injection too long");
+        return;
+    }
+    memcpy(text, payload, len);
+    text[len] = '\0';
+
+    char *save = NULL;
+    for (char *pair = strtok_r(text, " \n", &save); pair != NULL; pair = strtok_r(NULL, " \n", &save)) {
+        int pin, level;
+        if (sscanf(pair, "%d=%d", &pin, &level) != 2 || pin < 0 || pin >= HAL_POSIX_GPIO_COUNT) {
+            ESP_LOGW(TAG, "Bad GPIO injection '%s'", pair);
+            return;
+        }
+        level = level != 0;
+        if (atomic_exchange(&s_gpio_level[pin], level) != level && s_gpio_isr[pin] != NULL) {
+            s_gpio_isr[pin](s_gpio_isr_arg[pin]);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Echo ranging                                                              */
+/* ------------------------------------------------------------------------- */
+
+esp_err_t hal_echo_init(int trigger_pin, int echo_pin, uint32_t max_width_us, hal_echo_cb_t cb, void *arg)
+{
+    if (trigger_pin < 0 || trigger_pin >= HAL_POSIX_GPIO_COUNT || echo_pin < 0 || echo_pin >= HAL_POSIX_GPIO_COUNT) {
+        return ESP_FAIL;
+    }
+    s_echo_max_width_us = max_width_us;
+    s_echo_arg = arg;
+    s_echo_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t hal_echo_trigger(void)
+{
+    uint32_t width = atomic_load(&s_echo_width_us);
+    if (s_echo_cb != NULL && width != 0 && width <= s_echo_max_width_us) {
+        s_echo_cb(width, s_echo_arg);
+    }
+    return ESP_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Flash partitions                                                          */
+/* ------------------------------------------------------------------------- */
+
+static struct hal_flash s_flash[HAL_POSIX_FLASH_PARTITIONS];
+static pthread_mutex_t s_flash_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Map a partition: $DOOR_HOST_FLASH_DIR/<label>.bin, or anonymous memory
+ * @return Mapping of size bytes, erased if new, or NULL
+ */
+static uint8_t *flash_map(const char *label, uint32_t size)
+{
+    const char *dir = getenv("DOOR_HOST_FLASH_DIR");
+    if (dir == NULL) {
+        uint8_t *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            return NULL;
+        }
+        memset(data, 0xFF, size);
+        return data;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.bin", dir, label);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "open(%s) failed: %s", path, strerror(errno));
+        return NULL;
+    }
+    off_t old_size = lseek(fd, 0, SEEK_END);
+    uint8_t *data = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        ESP_LOGE(TAG, "Cannot map %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    if (old_size != (off_t)size) {
+        // New or resized: start from an erased partition
+        memset(data, 0xFF, size);
+    }
+    return data;
+}
+
+hal_flash_t *hal_flash_open(const char *label)
+{
+    const char *size_env = getenv("DOOR_HOST_FLASH_SIZE");
+    uint32_t size = size_env ? (uint32_t)strtoul(size_env, NULL, 0) : HAL_POSIX_DEFAULT_FLASH_SIZE;
+    size -= size % HAL_FLASH_SECTOR_SIZE;
+    if (size == 0 || strlen(label) >= sizeof(s_flash[0].label)) {
+        return NULL;
+    }
+
+    hal_flash_t *flash = NULL;
+    pthread_mutex_lock(&s_flash_lock);
+    for (int i = 0; i < HAL_POSIX_FLASH_PARTITIONS && flash == NULL; i++) {
+        if (s_flash[i].data == NULL) {
+            s_flash[i].data = flash_map(label, size);
+            if (s_flash[i].data != NULL) {
+                strcpy(s_flash[i].label, label);
+                s_flash[i].size = size;
+                flash = &s_flash[i];
+            }
+            break;
+        }
+        if (strcmp(s_flash[i].label, label) == 0) {
+            flash = &s_flash[i];
+        }
+    }
+    pthread_mutex_unlock(&s_flash_lock);
+    return flash;
+}
+
+uint32_t hal_flash_size(const hal_flash_t *flash)
+{
+    return flash->size;
+}
+
+esp_err_t hal_flash_read(hal_flash_t *flash, uint32_t offset, void *dst, size_t len)
+{
+    if (offset > flash->size || len > flash->size - offset) {
+        return ESP_FAIL;
+    }
+    memcpy(dst, flash->data + offset, len);
+    return ESP_OK;
+}
+
+esp_err_t hal_flash_write(hal_flash_t *flash, uint32_t offset, const void *src, size_t len)
+{
+    if (offset > flash->size || len > flash->size - offset) {
+        return ESP_FAIL;
+    }
+    const uint8_t *bytes = src;
+    for (size_t i = 0; i < len; i++) {
+        flash->data[offset + i] &= bytes[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t hal_flash_erase(hal_flash_t *flash, uint32_t offset, size_t len)
+{
+    if (offset % HAL_FLASH_SECTOR_SIZE != 0 || len % HAL_FLASH_SECTOR_SIZE != 0 ||
+        offset > flash->size || len > flash->size - offset) {
+        return ESP_FAIL;
+    }
+    memset(flash->data + offset, 0xFF, len);
+    return ESP_OK;
+}
+
+// NVS: fixed slots in a mapped sector, persistent under DOOR_HOST_FLASH_DIR
+typedef struct {
+    char key[16];               // first byte 0xFF when free
+    uint16_t value;
+} nvs_entry_t;
+
+static nvs_entry_t *s_nvs;
+
+esp_err_t hal_storage_init(void)
+{
+    s_nvs = (nvs_entry_t *)flash_map("nvs", HAL_FLASH_SECTOR_SIZE);
+    return s_nvs != NULL ? ESP_OK : ESP_FAIL;
+}
+
+static nvs_entry_t *nvs_find(const char *key, bool create)
+{
+    if (strlen(key) >= sizeof(s_nvs[0].key)) {
+        return NULL;
+    }
+    for (size_t i = 0; i < HAL_FLASH_SECTOR_SIZE / sizeof(nvs_entry_t); i++) {
+        if ((uint8_t)s_nvs[i].key[0] == 0xFF) {
+            if (!create) {
+                return NULL;
+            }
+            memset(&s_nvs[i], 0, sizeof(s_nvs[i]));
+            strcpy(s_nvs[i].key, key);
+            return &s_nvs[i];
+        }
+        if (strcmp(s_nvs[i].key, key) == 0) {
+            return &s_nvs[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t hal_nvs_get_u16(const char *key, uint16_t *value)
+{
+    const nvs_entry_t *entry = nvs_find(key, false);
+    if (entry == NULL) {
+        return ESP_FAIL;
+    }
+    *value = entry->value;
+    return ESP_OK;
+}
+
+esp_err_t hal_nvs_set_u16(const char *key, uint16_t value)
+{
+    nvs_entry_t *entry = nvs_find(key, true);
+    if (entry == NULL) {
+        return ESP_FAIL;
+    }
+    entry->value = value;
+    return ESP_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+/* MQTT broker stand-in                                                      */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Parse "host:port" into a socket address
+ */
+static bool parse_peer(const char *text, struct sockaddr_in *addr)
+{
+    char host[64];
+    const char *colon = strrchr(text, ':');
+    if (colon == NULL || (size_t)(colon - text) >= sizeof(host)) {
+        return false;
+    }
+    memcpy(host, text, colon - text);
+    host[colon - text] = '\0';
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)atoi(colon + 1));
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1;
+}
+
+/**
+ * @brief Queue an acknowledgement event for delivery from the client thread
+ */
+static void queue_pending_event(hal_mqtt_client_t *client, hal_mqtt_event_id_t event_id, int msg_id)
+{
+    pthread_mutex_lock(&client->lock);
+    if (client->pending_head - client->pending_tail < HAL_POSIX_PENDING_EVENTS) {
+        pending_event_t *slot = &client->pending[client->pending_head % HAL_POSIX_PENDING_EVENTS];
+        slot->event_id = event_id;
+        slot->msg_id = msg_id;
+        client->pending_head++;
+    }
+    pthread_mutex_unlock(&client->lock);
+
+    const char wake = 1;
+    (void)!write(client->wake_pipe[1], &wake, 1);
+}
+
+/**
+ * @brief Deliver queued SUBSCRIBED/PUBLISHED events
+ */
+static void drain_pending_events(hal_mqtt_client_t *client)
+{
+    for (;;) {
+        pending_event_t ev;
+        pthread_mutex_lock(&client->lock);
+        if (client->pending_tail == client->pending_head) {
+            pthread_mutex_unlock(&client->lock);
+            return;
+        }
+        ev = client->pending[client->pending_tail % HAL_POSIX_PENDING_EVENTS];
+        client->pending_tail++;
+        pthread_mutex_unlock(&client->lock);
+
+        hal_mqtt_event_t event = {
+            .event_id = ev.event_id,
+            .raw_event_id = ev.event_id,
+            .client = client,
+            .msg_id = ev.msg_id,
+        };
+        client->cb(&event, client->arg);
+    }
+}
+
+/**
+ * @brief QoS of the (exact, wildcard-free) subscription matching a topic
+ * @return -1 if the topic is not subscribed
+ */
+static int subscription_qos(hal_mqtt_client_t *client, const char *topic, int topic_len)
+{
+    int qos = -1;
+    pthread_mutex_lock(&client->lock);
+    for (int i = 0; i < client->subscription_count && qos < 0; i++) {
+        if ((int)strlen(client->subscriptions[i]) == topic_len &&
+            memcmp(client->subscriptions[i], topic, topic_len) == 0) {
+            qos = client->subscription_qos[i];
+        }
+    }
+    pthread_mutex_unlock(&client->lock);
+    return qos;
+}
+
+/**
+ * @brief Decode a hex string into out
+ * @return Decoded length, or -1 on odd length, bad digit or overflow
+ */
+static int hex_decode(const char *hex, int hex_len, char *out, int out_size)
+{
+    if (hex_len % 2 != 0 || hex_len / 2 > out_size) {
+        return -1;
+    }
+    for (int i = 0; i < hex_len; i++) {
+        char c = hex[i];
+        int nibble = c >= '0' && c <= '9' ? c - '0' :
+                     c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                     c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (nibble < 0) {
+            return -1;
+        }
+        if (i % 2 == 0) {
+            out[i / 2] = (char)(nibble << 4);
+        } else {
+            out[i / 2] |= (char)nibble;
+        }
+    }
+    return hex_len / 2;
+}
+
+/**
+ * @brief Drop the connection and schedule the next attempt, like esp-mqtt after a lost connection or failed attempt
+ */
+static void connection_lost(hal_mqtt_client_t *client)
+{
+    int64_t now = hal_time_us();
+    if (atomic_exchange(&client->connected, false)) {
+        client->disconnected_at_us = now;
+    }
+    // random() yields 31 bits
+    uint32_t delay_ms = backoff_next_ms(&client->backoff, (uint32_t)random() << 1 ^ (uint32_t)random());
+    client->reconnect_at_us = now + (int64_t)delay_ms * 1000;
+    ESP_LOGI(TAG, "Reconnecting in %" PRIu32 " ms", delay_ms);
+
+    hal_mqtt_event_t disconnected = {
+        .event_id = HAL_MQTT_EVENT_DISCONNECTED,
+        .raw_event_id = HAL_MQTT_EVENT_DISCONNECTED,
+        .client = client,
+    };
+    client->cb(&disconnected, client->arg);
+}
+
+/**
+ * @brief Split a stand-in datagram and dispatch it as a DATA event
+ */
+static void handle_datagram(hal_mqtt_client_t *client, char *buf, int len)
+{
+    char *end = buf + len;
+    char *topic_end = memchr(buf, '\n', len);
+    if (topic_end == NULL) {
+        ESP_LOGW(TAG, "Dropping datagram without topic line");
+        return;
+    }
+
+    // Parse property lines up to the blank separator line
+    static char correlation[HAL_POSIX_MAX_PROPERTY_LEN];
+    hal_mqtt_event_t first = { 0 };
+    char *line = topic_end + 1;
+    while (line < end && *line != '\n') {
+        char *eol = memchr(line, '\n', end - line);
+        if (eol == NULL) {
+            ESP_LOGW(TAG, "Dropping datagram without header terminator");
+            return;
+        }
+        char *value = memchr(line, ':', eol - line);
+        if (value != NULL) {
+            int name_len = (int)(value - line);
+            int value_len = (int)(eol - ++value);
+            if (name_len == 14 && memcmp(line, "response-topic", 14) == 0) {
+                first.response_topic = value;
+                first.response_topic_len = value_len;
+            } else if (name_len == 16 && memcmp(line, "correlation-data", 16) == 0) {
+                first.correlation_data = correlation;
+                first.correlation_data_len = hex_decode(value, value_len, correlation, sizeof(correlation));
+                if (first.correlation_data_len < 0) {
+                    ESP_LOGW(TAG, "Dropping datagram with malformed correlation-data");
+                    return;
+                }
+            } else if (name_len == 9 && memcmp(line, "packet-id", 9) == 0) {
+                first.msg_id = atoi(value);
+            } else if (name_len == 3 && memcmp(line, "dup", 3) == 0) {
+                first.dup = *value == '1';
+            } else if (name_len == 3 && memcmp(line, "seq", 3) == 0) {
+                first.has_seq = true;
+                first.seq = (uint32_t)strtoul(value, NULL, 10);
+            }
+        }
+        line = eol + 1;
+    }
+    if (line >= end) {
+        ESP_LOGW(TAG, "Dropping datagram without header terminator");
+        return;
+    }
+    char *payload = line + 1;
+
+    int topic_len = (int)(topic_end - buf);
+    if (topic_len == 9 && memcmp(buf, "$hal/gpio", 9) == 0) {
+        inject_gpio(payload, (int)(end - payload));
+        return;
+    }
+    if (topic_len == 9 && memcmp(buf, "$hal/echo", 9) == 0) {
+        *end = '\0';
+        atomic_store(&s_echo_width_us, (unsigned)strtoul(payload, NULL, 10));
+        return;
+    }
+    if (topic_len == 11 && memcmp(buf, "$hal/broker", 11) == 0) {
+        *end = '\0';
+        long down_ms = strtol(payload, NULL, 10);
+        ESP_LOGW(TAG, "Broker restarting, down for %ld ms", down_ms);
+        client->broker_down_until_us = hal_time_us() + (int64_t)down_ms * 1000;
+        if (atomic_load(&client->connected)) {
+            connection_lost(client);
+        }
+        return;
+    }
+    int qos = subscription_qos(client, buf, topic_len);
+    if (qos < 0) {
+        return;
+    }
+    if (!atomic_load(&client->connected)) {
+        if (qos == 0 || !client->session) {
+            return;
+        }
+        if (client->session_queue_count == HAL_POSIX_SESSION_QUEUE || len > HAL_POSIX_SESSION_MSG_MAX) {
+            ESP_LOGW(TAG, "Session queue full or message too long, dropped");
+            return;
+        }
+        client->session_queue[client->session_queue_count].len = len;
+        memcpy(client->session_queue[client->session_queue_count++].data, buf, len);
+        return;
+    }
+
+    int payload_len = (int)(end - payload);
+    int offset = 0;
+    do {
+        int chunk = payload_len - offset;
+        if (chunk > client->rx_buffer_size) {
+            chunk = client->rx_buffer_size;
+        }
+        // Like esp-mqtt, only the first fragment carries the topic
+        hal_mqtt_event_t event = {
+            .event_id = HAL_MQTT_EVENT_DATA,
+            .raw_event_id = HAL_MQTT_EVENT_DATA,
+            .client = client,
+            .topic = offset == 0 ? buf : NULL,
+            .topic_len = offset == 0 ? topic_len : 0,
+            .data = payload + offset,
+            .data_len = chunk,
+            .current_data_offset = offset,
+            .total_data_len = payload_len,
+            .msg_id = first.msg_id,
+            .dup = first.dup,
+        };
+        if (offset == 0) {
+            event.response_topic = first.response_topic;
+            event.response_topic_len = first.response_topic_len;
+            event.correlation_data = first.correlation_data;
+            event.correlation_data_len = first.correlation_data_len;
+            event.has_seq = first.has_seq;
+            event.seq = first.seq;
+        }
+        client->cb(&event, client->arg);
+        offset += chunk;
+    } while (offset < payload_len);
+}
+
+/**
+ * @brief Connect to the stand-in broker, or fail while it is down
+ */
+static void connect_attempt(hal_mqtt_client_t *client)
+{
+    int64_t now = hal_time_us();
+    if (now < client->broker_down_until_us) {
+        hal_mqtt_event_t error = {
+            .event_id = HAL_MQTT_EVENT_ERROR,
+            .raw_event_id = HAL_MQTT_EVENT_ERROR,
+            .client = client,
+            .transport_error = true,
+            .sock_errno = ECONNREFUSED,
+        };
+        client->cb(&error, client->arg);
+        connection_lost(client);
+        return;
+    }
+
+    int64_t expiry_us = (int64_t)client->cfg.session_expiry_s * 1000000;
+    bool session_present = client->session && now - client->disconnected_at_us <= expiry_us;
+    pthread_mutex_lock(&client->lock);
+    if (!session_present) {
+        client->subscription_count = 0;
+        client->session_queue_count = 0;
+    }
+    // Aliases last for one connection in both directions
+    memset(client->topic_aliases, 0, sizeof(client->topic_aliases));
+    pthread_mutex_unlock(&client->lock);
+    client->session = expiry_us != 0;
+    backoff_reset(&client->backoff);
+    atomic_store(&client->connected, true);
+
+    hal_mqtt_event_t connected = {
+        .event_id = HAL_MQTT_EVENT_CONNECTED,
+        .raw_event_id = HAL_MQTT_EVENT_CONNECTED,
+        .client = client,
+        .session_present = session_present,
+    };
+    client->cb(&connected, client->arg);
+
+    // Messages held for the session follow the CONNACK
+    int queued = client->session_queue_count;
+    client->session_queue_count = 0;
+    for (int i = 0; i < queued; i++) {
+        handle_datagram(client, client->session_queue[i].data, client->session_queue[i].len);
+    }
+}
+
+/**
+ * @brief Client thread: receive datagrams and deliver events until shutdown
+ */
+static void *mqtt_client_thread(void *arg)
+{
+    hal_mqtt_client_t *client = arg;
+    static char buf[HAL_POSIX_MAX_DATAGRAM + 1];
+
+    connect_attempt(client);
+
+    struct pollfd pfd[2] = {
+        { .fd = client->sock, .events = POLLIN },
+        { .fd = client->wake_pipe[0], .events = POLLIN },
+    };
+    while (!s_stop) {
+        drain_pending_events(client);
+        int timeout_ms = HAL_POSIX_POLL_MS;
+        if (!atomic_load(&client->connected)) {
+            int64_t wait_us = client->reconnect_at_us - hal_time_us();
+            if (wait_us <= 0) {
+                connect_attempt(client);
+                continue;
+            }
+            if (wait_us < timeout_ms * 1000) {
+                timeout_ms = (int)((wait_us + 999) / 1000);
+            }
+        }
+        int ready = poll(pfd, 2, timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            hal_mqtt_event_t error = {
+                .event_id = HAL_MQTT_EVENT_ERROR,
+                .raw_event_id = HAL_MQTT_EVENT_ERROR,
+                .client = client,
+                .transport_error = true,
+                .sock_errno = errno,
+            };
+            client->cb(&error, client->arg);
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        if (pfd[1].revents & POLLIN) {
+            char drain[64];
+            (void)!read(client->wake_pipe[0], drain, sizeof(drain));
+        }
+        if (!(pfd[0].revents & POLLIN)) {
+            continue;
+        }
+        ssize_t len = recv(client->sock, buf, HAL_POSIX_MAX_DATAGRAM, 0);
+        if (len > 0) {
+            handle_datagram(client, buf, (int)len);
+        }
+    }
+    drain_pending_events(client);
+
+    if (atomic_load(&client->connected)) {
+        atomic_store(&client->connected, false);
+        hal_mqtt_event_t disconnected = {
+            .event_id = HAL_MQTT_EVENT_DISCONNECTED,
+            .raw_event_id = HAL_MQTT_EVENT_DISCONNECTED,
+            .client = client,
+        };
+        client->cb(&disconnected, client->arg);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Append the properties and payload to a datagram holding the topic line and send it
+ */
+static bool send_with_header(hal_mqtt_client_t *client, char *buf, int header_len, const char *data, int len,
+                             const hal_mqtt_publish_props_t *props)
+{
+    static const char hex[] = "0123456789abcdef";
+    if (props != NULL && props->correlation_data_len > 0) {
+        if (props->correlation_data_len > HAL_POSIX_MAX_PROPERTY_LEN) {
+            return false;
+        }
+        header_len += sprintf(buf + header_len, "correlation-data:");
+        for (int i = 0; i < props->correlation_data_len; i++) {
+            uint8_t byte = (uint8_t)props->correlation_data[i];
+            buf[header_len++] = hex[byte >> 4];
+            buf[header_len++] = hex[byte & 0x0F];
+        }
+        buf[header_len++] = '\n';
+    }
+    buf[header_len++] = '\n';
+    if (header_len + len > HAL_POSIX_MAX_DATAGRAM) {
+        return false;
+    }
+    memcpy(buf + header_len, data, len);
+    return sendto(client->sock, buf, header_len + len, 0,
+                  (const struct sockaddr *)&client->peer, sizeof(client->peer)) >= 0;
+}
+
+/**
+ * @brief Send one stand-in datagram to the peer
+ */
+static bool send_datagram(hal_mqtt_client_t *client, const char *topic, const char *data, int len,
+                          const hal_mqtt_publish_props_t *props)
+{
+    char buf[HAL_POSIX_MAX_DATAGRAM];
+    int alias = props != NULL && props->topic_alias <= client->topic_alias_max ? props->topic_alias : 0;
+    if (alias == 0) {
+        return send_with_header(client, buf, sprintf(buf, "%.*s\n", HAL_POSIX_MAX_TOPIC_LEN, topic),
+                                data, len, props);
+    }
+
+    // Held until sent, so the peer never sees a bare alias before its topic
+    pthread_mutex_lock(&client->lock);
+    char *mapped = client->topic_aliases[alias - 1];
+    int header_len;
+    if (strcmp(mapped, topic) == 0) {
+        header_len = sprintf(buf, "\ntopic-alias:%d\n", alias);
+    } else {
+        snprintf(mapped, HAL_POSIX_MAX_TOPIC_LEN, "%s", topic);
+        header_len = sprintf(buf, "%s\ntopic-alias:%d\n", mapped, alias);
+    }
+    bool sent = send_with_header(client, buf, header_len, data, len, props);
+    pthread_mutex_unlock(&client->lock);
+    return sent;
+}
+
+hal_mqtt_client_t *hal_mqtt_start(const hal_mqtt_config_t *cfg, hal_mqtt_event_cb_t cb, void *arg)
+{
+    hal_mqtt_client_t *client = &s_mqtt_client;
+    const char *port_env = getenv("DOOR_HOST_PORT");
+    const char *peer_env = getenv("DOOR_HOST_PEER");
+    const char *rx_buffer_env = getenv("DOOR_HOST_RX_BUFFER");
+    int port = port_env ? atoi(port_env) : HAL_POSIX_DEFAULT_PORT;
+
+    if (!parse_peer(peer_env ? peer_env : HAL_POSIX_DEFAULT_PEER, &client->peer)) {
+        ESP_LOGE(TAG, "Invalid DOOR_HOST_PEER");
+        return NULL;
+    }
+
+    client->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (client->sock < 0) {
+        ESP_LOGE(TAG, "socket() failed: %s", strerror(errno));
+        return NULL;
+    }
+    // A real broker buffers bursts in TCP; give the stand-in socket similar headroom
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(client->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(client->sock, (const struct sockaddr *)&local, sizeof(local)) < 0) {
+        ESP_LOGE(TAG, "bind(%d) failed: %s", port, strerror(errno));
+        close(client->sock);
+        return NULL;
+    }
+
+    if (pipe2(client->wake_pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        close(client->sock);
+        return NULL;
+    }
+
+    client->rx_buffer_size = rx_buffer_env ? atoi(rx_buffer_env) : HAL_POSIX_DEFAULT_RX_BUFFER;
+    if (client->rx_buffer_size <= 0) {
+        client->rx_buffer_size = HAL_POSIX_DEFAULT_RX_BUFFER;
+    }
+    const char *alias_env = getenv("DOOR_HOST_TOPIC_ALIAS_MAX");
+    client->topic_alias_max = alias_env ? atoi(alias_env) : HAL_POSIX_DEFAULT_ALIAS_MAX;
+    if (client->topic_alias_max < 0) {
+        client->topic_alias_max = 0;
+    } else if (client->topic_alias_max > HAL_POSIX_MAX_TOPIC_ALIASES) {
+        client->topic_alias_max = HAL_POSIX_MAX_TOPIC_ALIASES;
+    }
+    client->cfg = *cfg;
+    client->cb = cb;
+    client->arg = arg;
+    client->backoff = (backoff_t) { .base_ms = cfg->reconnect_base_ms, .max_ms = cfg->reconnect_max_ms };
+    srandom((unsigned)getpid() ^ (unsigned)hal_time_us());
+    atomic_init(&client->next_msg_id, 1);
+    pthread_mutex_init(&client->lock, NULL);
+    ESP_LOGI(TAG, "Broker stand-in listening on 127.0.0.1:%d", port);
+    if (pthread_create(&client->thread, NULL, mqtt_client_thread, client) != 0) {
+        close(client->sock);
+        return NULL;
+    }
+    s_mqtt_started = true;
+    return client;
+}
+
+int hal_mqtt_publish(hal_mqtt_client_t *client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    return hal_mqtt_enqueue_with_props(client, topic, data, len, qos, retain, NULL);
+}
+
+int hal_mqtt_enqueue(hal_mqtt_client_t *client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    // A UDP send never waits for the peer, so the publish path is already non-blocking
+    return hal_mqtt_enqueue_with_props(client, topic, data, len, qos, retain, NULL);
+}
+
+int hal_mqtt_enqueue_with_props(hal_mqtt_client_t *client, const char *topic, const char *data, int len,
+                                int qos, int retain, const hal_mqtt_publish_props_t *props)
+{
+    (void)retain;
+    if (!atomic_load(&client->connected)) {
+        return -1;
+    }
+    if (len == 0 && data != NULL) {
+        len = (int)strlen(data);
+    }
+    if (!send_datagram(client, topic, data, len, props)) {
+        return -1;
+    }
+    if (qos == 0) {
+        return 0;
+    }
+    int msg_id = atomic_fetch_add(&client->next_msg_id, 1);
+    queue_pending_event(client, HAL_MQTT_EVENT_PUBLISHED, msg_id);
+    return msg_id;
+}
+
+int hal_mqtt_subscribe(hal_mqtt_client_t *client, const char *topic, int qos)
+{
+    int msg_id = atomic_fetch_add(&client->next_msg_id, 1);
+
+    pthread_mutex_lock(&client->lock);
+    // A repeated subscription replaces the existing one
+    int i = 0;
+    while (i < client->subscription_count && strcmp(client->subscriptions[i], topic) != 0) {
+        i++;
+    }
+    if (i == client->subscription_count) {
+        if (client->subscription_count >= HAL_POSIX_MAX_SUBSCRIPTIONS ||
+            strlen(topic) >= HAL_POSIX_MAX_TOPIC_LEN) {
+            pthread_mutex_unlock(&client->lock);
+            return -1;
+        }
+        strcpy(client->subscriptions[client->subscription_count++], topic);
+    }
+    client->subscription_qos[i] = qos;
+    pthread_mutex_unlock(&client->lock);
+
+    queue_pending_event(client, HAL_MQTT_EVENT_SUBSCRIBED, msg_id);
+    return msg_id;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Process entry point                                                       */
+/* ------------------------------------------------------------------------- */
+
+static void handle_stop_signal(int signo)
+{
+    (void)signo;
+    s_stop = 1;
+}
+
+int main(void)
+{
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+
+    app_main();
+
+    while (!s_stop) {
+        struct timespec interval = { .tv_sec = 0, .tv_nsec = HAL_POSIX_POLL_MS * 1000000L };
+        nanosleep(&interval, NULL);
+    }
+
+    if (s_mqtt_started) {
+        hal_mqtt_client_t *client = &s_mqtt_client;
+        pthread_join(client->thread, NULL);
+        // Emulate the broker delivering the last will on disconnect
+        if (client->cfg.lwt_topic != NULL && client->cfg.lwt_msg != NULL) {
+            send_datagram(client, client->cfg.lwt_topic, client->cfg.lwt_msg, (int)strlen(client->cfg.lwt_msg), NULL);
+        }
+        close(client->sock);
+        close(client->wake_pipe[0]);
+        close(client->wake_pipe[1]);
+        pthread_mutex_destroy(&client->lock);
+    }
+    return 0;
+}
+
+#endif // !ESP_PLATFORM
@@ -0,0 +1,144 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "config.h"
+#include "journal.h"
+
+#if CONFIG_DOOR_JOURNAL
+
+#include "crc16.h"
+
+#define RECORDS_PER_SECTOR      (HAL_FLASH_SECTOR_SIZE / sizeof(journal_record_t))
+
+static const char *TAG = "journal";
+
+// Control task only, after journal_start()
+static hal_flash_t *s_flash;
+static uint32_t s_sector_count;
+static uint32_t s_sector;               // being written
+static uint32_t s_slot;                 // next free record in s_sector
+static uint32_t s_seq;                  // of the next record
+static uint16_t s_boot;
+
+static uint32_t slot_offset(uint32_t sector, uint32_t slot)
+{
+    return sector * HAL_FLASH_SECTOR_SIZE + slot * sizeof(journal_record_t);
+}
+
+static bool record_valid(const journal_record_t *rec)
+{
+    return rec->seq != JOURNAL_SEQ_ERASED &&
+           rec->crc == crc16_ccitt(CRC16_INIT, rec, offsetof(journal_record_t, crc));
+}
+
+/**
+ * @brief Find the newest record; the journal continues in the slot after it
+ */
+static void recover(void)
+{
+    journal_record_t rec;
+    bool found = false;
+    uint32_t newest_seq = 0;
+
+    // Sectors are filled in order, so the newest record is in the sector whose first record is newest
+    for (uint32_t sector = 0; sector < s_sector_count; sector++) {
+        if (hal_flash_read(s_flash, slot_offset(sector, 0), &rec, sizeof(rec)) == ESP_OK && record_valid(&rec) &&
+            (!found || rec.seq > newest_seq)) {
+            found = true;
+            newest_seq = rec.seq;
+            s_sector = sector;
+        }
+    }
+    if (!found) {
+        s_sector = 0;
+        s_slot = 0;
+        s_seq = 1;
+        s_boot = 0;
+        hal_flash_erase(s_flash, 0, HAL_FLASH_SECTOR_SIZE);
+        return;
+    }
+
+    s_slot = RECORDS_PER_SECTOR;
+    for (uint32_t slot = 0; slot < RECORDS_PER_SECTOR; slot++) {
+        if (hal_flash_read(s_flash, slot_offset(s_sector, slot), &rec, sizeof(rec)) != ESP_OK) {
+            break;
+        }
+        if (rec.seq == JOURNAL_SEQ_ERASED) {
+            // A torn record leaves no all-ones sequence behind, so the rest of the sector is free
+            s_slot = slot;
+            break;
+        }
+        if (record_valid(&rec) && rec.seq >= newest_seq) {
+            newest_seq = rec.seq;
+            s_boot = rec.boot;
+        }
+    }
+    s_seq = newest_seq + 1;
+    s_boot++;
+}
+
+esp_err_t journal_start(uint8_t state)
+{
+    s_flash = hal_flash_open(JOURNAL_PARTITION);
+    if (s_flash == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition, door events are not recorded", JOURNAL_PARTITION);
+        return ESP_OK;
+    }
+    s_sector_count = hal_flash_size(s_flash) / HAL_FLASH_SECTOR_SIZE;
+    if (s_sector_count < 2) {
+        s_flash = NULL;
+        return ESP_FAIL;
+    }
+    recover();
+    ESP_LOGI(TAG, "Boot %u, next record %" PRIu32 " in sector %" PRIu32 " of %" PRIu32,
+             s_boot, s_seq, s_sector, s_sector_count);
+    journal_append(JOURNAL_BOOT, state, 0);
+    return ESP_OK;
+}
+
+void journal_append(journal_event_t event, uint8_t state, uint32_t value)
+{
+    if (s_flash == NULL) {
+        return;
+    }
+    if (s_slot == RECORDS_PER_SECTOR) {
+        // Overwrite the oldest sector
+        s_sector = (s_sector + 1) % s_sector_count;
+        s_slot = 0;
+        if (hal_flash_erase(s_flash, slot_offset(s_sector, 0), HAL_FLASH_SECTOR_SIZE) != ESP_OK) {
+            ESP_LOGE(TAG, "Erasing sector %" PRIu32 " failed", s_sector);
+            s_slot = RECORDS_PER_SECTOR;
+            return;
+        }
+    }
+    journal_record_t rec = {
+        .seq = s_seq,
+        .time_ms = (uint32_t)(hal_time_us() / 1000),
+        .boot = s_boot,
+        .event = (uint8_t)event,
+        .state = state,
+        .value = value > UINT16_MAX ? UINT16_MAX : (uint16_t)value,
+    };
+    rec.crc = crc16_ccitt(CRC16_INIT, &rec, offsetof(journal_record_t, crc));
+    if (hal_flash_write(s_flash, slot_offset(s_sector, s_slot), &rec, sizeof(rec)) != ESP_OK) {
+        ESP_LOGE(TAG, "Writing record %" PRIu32 " failed", s_seq);
+    }
+    // A failed slot is skipped, not retried: it may be partly programmed
+    s_slot++;
+    s_seq++;
+}
+
+#else // !CONFIG_DOOR_JOURNAL
+
+esp_err_t journal_start(uint8_t state)
+{
+    return ESP_OK;
+}
+
+void journal_append(journal_event_t event, uint8_t state, uint32_t value)
+{
+}
+
+#endif // CONFIG_DOOR_JOURNAL
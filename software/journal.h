@@ -0,0 +1,68 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file journal.h
+ * @brief Append-only door event journal in flash
+ *
+ * Every state change (open, close, stop, fault) and every obstruction that
+ * reversed the door is appended by the control task as one fixed 16-byte
+ * record to the "journal" data partition. The partition is a ring: when the
+ * writer reaches a used sector it erases it, so the journal keeps the most
+ * recent partition size / 16 records (8192 with partitions.csv). Records are
+ * programmed, never rewritten; each carries a sequence number that keeps
+ * counting across boots and a CRC, so a record torn by a power loss is
+ * skipped rather than misread.
+ *
+ * There is no wall clock: times are milliseconds since boot, with a boot
+ * number the journal keeps itself (one JOURNAL_BOOT record per start).
+ *
+ * A partition image (parttool.py read_partition --partition-name journal,
+ * or DOOR_HOST_FLASH_DIR/journal.bin on the host) is an array of
+ * journal_record_t that software/tools/journal_query.c maps and queries.
+ * Erased slots read as all ones. Recording takes a sector erase, which
+ * stalls both cores for tens of milliseconds, once per 256 records.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+#define JOURNAL_PARTITION       "journal"
+#define JOURNAL_SEQ_ERASED      UINT32_MAX
+
+typedef enum {
+    JOURNAL_BOOT,               // state: door state at boot, value: 0
+    JOURNAL_STATE,              // state: from << 4 | to, value: ms spent in from, saturated
+    JOURNAL_OBSTRUCTION,        // state: door state after reversing, value: distance in mm
+    JOURNAL_EVENT_COUNT
+} journal_event_t;
+
+typedef struct {
+    uint32_t seq;               // counts across boots; JOURNAL_SEQ_ERASED for an empty slot
+    uint32_t time_ms;           // since boot
+    uint16_t boot;
+    uint8_t event;              // journal_event_t
+    uint8_t state;
+    uint16_t value;
+    uint16_t crc;               // crc16_ccitt() of the preceding 14 bytes
+} journal_record_t;
+
+_Static_assert(sizeof(journal_record_t) == 16, "journal records are 16 bytes in flash");
+
+/**
+ * @brief Open the partition, find the end of the journal and record the boot
+ *
+ * Call before the control task starts. Without the partition nothing is
+ * recorded.
+ * @param state Door state at boot
+ */
+esp_err_t journal_start(uint8_t state);
+
+/**
+ * @brief Append a record; control task only
+ * @param value Saturated to 16 bits
+ */
+void journal_append(journal_event_t event, uint8_t state, uint32_t value);
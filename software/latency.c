@@ -0,0 +1,172 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include "hal.h"
+#include "latency.h"
+#include "spsc_ring.h"
+
+#define LATENCY_SUB_BITS        3
+#define LATENCY_SUB_BUCKETS     (1u << LATENCY_SUB_BITS)
+#define LATENCY_GROUPS          24      // covers up to ~134 s, larger values share the last bucket
+#define LATENCY_BUCKETS         (LATENCY_GROUPS * LATENCY_SUB_BUCKETS)
+#define LATENCY_PENDING_ACKS    16
+#define LATENCY_ACK_RING_SLOTS  16      // must be a power of two
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_hist_t;
+
+typedef struct {
+    int msg_id;                 // 0 when free
+    int64_t time_us;
+} pending_ack_t;
+
+static const char *const s_stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_RX_TO_DISPATCH] = "rx_dispatch",
+    [LATENCY_DISPATCH_TO_GPIO] = "dispatch_gpio",
+    [LATENCY_RX_TO_GPIO] = "rx_gpio",
+    [LATENCY_RX_TO_ACK] = "rx_ack",
+    [LATENCY_LIMIT_TO_STOP] = "limit_stop",
+    [LATENCY_TIMER_LATE] = "timer_late",
+};
+
+static latency_hist_t s_hist[LATENCY_STAGE_COUNT];
+static pending_ack_t s_pending[LATENCY_PENDING_ACKS];
+static unsigned s_pending_next;
+static pending_ack_t s_ack_slots[LATENCY_ACK_RING_SLOTS];
+static spsc_ring_t s_ack_ring;
+
+/**
+ * @brief Bucket index of a value
+ */
+static unsigned bucket_of(uint32_t value)
+{
+    if (value < LATENCY_SUB_BUCKETS) {
+        return value;
+    }
+    unsigned msb = 31 - __builtin_clz(value);
+    unsigned shift = msb - LATENCY_SUB_BITS;
+    unsigned index = (shift + 1) * LATENCY_SUB_BUCKETS + ((value >> shift) & (LATENCY_SUB_BUCKETS - 1));
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+/**
+ * @brief Highest value that falls into a bucket
+ */
+static uint32_t bucket_upper(unsigned index)
+{
+    if (index < LATENCY_SUB_BUCKETS) {
+        return index;
+    }
+    unsigned shift = index / LATENCY_SUB_BUCKETS - 1;
+    uint32_t mantissa = LATENCY_SUB_BUCKETS + index % LATENCY_SUB_BUCKETS;
+    return (mantissa << shift) + ((1u << shift) - 1);
+}
+
+void latency_init(void)
+{
+    spsc_ring_init(&s_ack_ring, s_ack_slots, sizeof(pending_ack_t), LATENCY_ACK_RING_SLOTS);
+}
+
+void latency_record(latency_stage_t stage, int64_t start_us, int64_t end_us)
+{
+    int64_t delta = end_us - start_us;
+    uint32_t value = delta < 0 ? 0 : delta > UINT32_MAX ? UINT32_MAX : (uint32_t)delta;
+    latency_hist_t *hist = &s_hist[stage];
+
+    hist->buckets[bucket_of(value)]++;
+    hist->count++;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+void latency_ack_expect(int msg_id, int64_t rx_time_us)
+{
+    if (msg_id <= 0) {
+        return;
+    }
+    // Oldest entries are overwritten if acks never come back
+    pending_ack_t *slot = &s_pending[s_pending_next++ % LATENCY_PENDING_ACKS];
+    slot->msg_id = msg_id;
+    slot->time_us = rx_time_us;
+}
+
+void latency_ack_received(int msg_id, int64_t now_us)
+{
+    pending_ack_t *ack = spsc_ring_reserve(&s_ack_ring);
+    if (ack == NULL) {
+        return;
+    }
+    ack->msg_id = msg_id;
+    ack->time_us = now_us;
+    spsc_ring_commit(&s_ack_ring);
+}
+
+void latency_process_acks(void)
+{
+    pending_ack_t *ack;
+    while ((ack = spsc_ring_peek(&s_ack_ring)) != NULL) {
+        for (int i = 0; i < LATENCY_PENDING_ACKS; i++) {
+            pending_ack_t *slot = &s_pending[i];
+            if (slot->msg_id == ack->msg_id) {
+                latency_record(LATENCY_RX_TO_ACK, slot->time_us, ack->time_us);
+                slot->msg_id = 0;
+                break;
+            }
+        }
+        spsc_ring_release(&s_ack_ring);
+    }
+}
+
+uint32_t latency_percentile(latency_stage_t stage, unsigned permille)
+{
+    const latency_hist_t *hist = &s_hist[stage];
+    uint32_t count = hist->count;
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = ((uint64_t)count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint32_t upper = bucket_upper(i);
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+int latency_format_json(char *buf, size_t size)
+{
+    size_t len = 0;
+    int n = snprintf(buf, size, "{\"fw\":\"%s\"", hal_firmware_version());
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+    len = n;
+
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        n = snprintf(buf + len, size - len,
+                     ",\"%s\":{\"n\":%" PRIu32 ",\"p50\":%" PRIu32 ",\"p99\":%" PRIu32 ",\"max\":%" PRIu32 "}",
+                     s_stage_names[stage], s_hist[stage].count,
+                     latency_percentile(stage, 500), latency_percentile(stage, 990), s_hist[stage].max);
+        if (n < 0 || (size_t)n >= size - len) {
+            return -1;
+        }
+        len += n;
+    }
+
+    if (len + 2 > size) {
+        return -1;
+    }
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return (int)len;
+}
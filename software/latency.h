@@ -0,0 +1,66 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file latency.h
+ * @brief Command latency histograms
+ *
+ * Each stage keeps a log-linear histogram in static memory: values are
+ * grouped by power of two and every group is split into 8 linear buckets,
+ * so a reported percentile is within 12.5% of the true value. All stages
+ * are recorded and reported from the control task. PUBLISHED acks arrive in
+ * the MQTT task and are handed over through a lock-free ring, matched by
+ * latency_process_acks().
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    LATENCY_RX_TO_DISPATCH,     // MQTT_EVENT_DATA arrival -> control task picks it up
+    LATENCY_DISPATCH_TO_GPIO,   // control task pick-up -> GPIO write
+    LATENCY_RX_TO_GPIO,         // end-to-end actuation latency
+    LATENCY_RX_TO_ACK,          // arrival -> MQTT_EVENT_PUBLISHED of the response
+    LATENCY_LIMIT_TO_STOP,      // limit switch interrupt -> motor relays released
+    LATENCY_TIMER_LATE,         // control loop deadline (relay dead time, end of travel, ...) -> running
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+/**
+ * @brief Prepare the ack hand-over ring; call before any other function
+ */
+void latency_init(void);
+
+/**
+ * @brief Add one sample to a stage histogram
+ */
+void latency_record(latency_stage_t stage, int64_t start_us, int64_t end_us);
+
+/**
+ * @brief Remember that a response with msg_id answers a command received at rx_time_us
+ */
+void latency_ack_expect(int msg_id, int64_t rx_time_us);
+
+/**
+ * @brief Report a PUBLISHED event (MQTT task); the caller then wakes the control task
+ */
+void latency_ack_received(int msg_id, int64_t now_us);
+
+/**
+ * @brief Match reported acks against expected responses (control task)
+ */
+void latency_process_acks(void);
+
+/**
+ * @brief Approximate percentile of a stage in microseconds
+ * @param permille 500 for p50, 990 for p99
+ */
+uint32_t latency_percentile(latency_stage_t stage, unsigned permille);
+
+/**
+ * @brief Render all stages as JSON: {"fw":..,"<stage>":{"n":..,"p50":..,"p99":..,"max":..},..}
+ * @return Length written (excluding NUL), or -1 if buf is too small
+ */
+int latency_format_json(char *buf, size_t size);
@@ -0,0 +1,99 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "config.h"
+#include "binlog.h"
+#include "motor_control.h"
+
+#define RELAY_ON        CONFIG_DOOR_RELAY_ACTIVE_LEVEL
+#define RELAY_OFF       (!CONFIG_DOOR_RELAY_ACTIVE_LEVEL)
+#define DEAD_TIME_US    ((int64_t)CONFIG_DOOR_RELAY_DEAD_TIME_MS * 1000)
+
+static const char *TAG = "motor";
+
+static motor_dir_t s_active;
+static motor_dir_t s_target;
+static int64_t s_active_since_us;
+static int64_t s_released_us;       // when both relays were last released
+
+/**
+ * @brief Drive the relay outputs for a direction
+ */
+static void relays_write(motor_dir_t dir)
+{
+    // Release before energising so both are never on at the same time
+    if (dir != MOTOR_OPENING) {
+        hal_gpio_set_level(CONFIG_DOOR_RELAY_OPEN_GPIO, RELAY_OFF);
+    }
+    if (dir != MOTOR_CLOSING) {
+        hal_gpio_set_level(CONFIG_DOOR_RELAY_CLOSE_GPIO, RELAY_OFF);
+    }
+    if (dir == MOTOR_OPENING) {
+        hal_gpio_set_level(CONFIG_DOOR_RELAY_OPEN_GPIO, RELAY_ON);
+    } else if (dir == MOTOR_CLOSING) {
+        hal_gpio_set_level(CONFIG_DOOR_RELAY_CLOSE_GPIO, RELAY_ON);
+    }
+    BINLOG(MOTOR_DIR, dir);
+}
+
+esp_err_t motor_init(void)
+{
+    esp_err_t err = hal_gpio_config_output(CONFIG_DOOR_RELAY_OPEN_GPIO);
+    if (err == ESP_OK) {
+        err = hal_gpio_config_output(CONFIG_DOOR_RELAY_CLOSE_GPIO);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    relays_write(MOTOR_OFF);
+    s_active = s_target = MOTOR_OFF;
+    // Treat power-up as a long-released state so the first move is immediate
+    s_released_us = -DEAD_TIME_US;
+    ESP_LOGI(TAG, "Relays on GPIO %d (open) / %d (close), dead time %d ms",
+             CONFIG_DOOR_RELAY_OPEN_GPIO, CONFIG_DOOR_RELAY_CLOSE_GPIO, CONFIG_DOOR_RELAY_DEAD_TIME_MS);
+    return ESP_OK;
+}
+
+bool motor_set(motor_dir_t dir, int64_t now_us)
+{
+    bool changed = false;
+
+    s_target = dir;
+    if (s_active != MOTOR_OFF && s_active != dir) {
+        relays_write(MOTOR_OFF);
+        s_active = MOTOR_OFF;
+        s_active_since_us = 0;
+        s_released_us = now_us;
+        changed = true;
+    }
+    if (dir != MOTOR_OFF && s_active == MOTOR_OFF && now_us - s_released_us >= DEAD_TIME_US) {
+        relays_write(dir);
+        s_active = dir;
+        s_active_since_us = now_us;
+        changed = true;
+    }
+    return changed;
+}
+
+void motor_poll(int64_t now_us)
+{
+    if (s_target != s_active) {
+        motor_set(s_target, now_us);
+    }
+}
+
+int64_t motor_pending_due_us(void)
+{
+    return s_target != s_active ? s_released_us + DEAD_TIME_US : 0;
+}
+
+motor_dir_t motor_active(void)
+{
+    return s_active;
+}
+
+int64_t motor_active_since_us(void)
+{
+    return s_active_since_us;
+}
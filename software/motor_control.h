@@ -0,0 +1,63 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file motor_control.h
+ * @brief Door motor driver: two SRD-05VDC relays selecting the direction
+ *
+ * One relay powers the motor in the opening direction, the other in the
+ * closing direction; with both released the motor terminals are shorted and
+ * the motor brakes. The two relays are never energised together. A change of
+ * direction first releases the active relay and only energises the other one
+ * after CONFIG_DOOR_RELAY_DEAD_TIME_MS, so the contacts have opened and the
+ * motor has spun down. Nothing blocks: a pending direction is applied by
+ * motor_poll() once its dead time has elapsed.
+ *
+ * Single caller (the control task).
+ */
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+
+typedef enum {
+    MOTOR_OFF,
+    MOTOR_OPENING,
+    MOTOR_CLOSING,
+} motor_dir_t;
+
+/**
+ * @brief Configure both relay outputs released
+ */
+esp_err_t motor_init(void);
+
+/**
+ * @brief Request a direction
+ *
+ * MOTOR_OFF releases the relays immediately. Another direction takes effect
+ * now if the relays have been released for at least the dead time, otherwise
+ * it is left pending for motor_poll().
+ * @return true if a relay output changed during this call
+ */
+bool motor_set(motor_dir_t dir, int64_t now_us);
+
+/**
+ * @brief Apply a pending direction whose dead time has elapsed
+ */
+void motor_poll(int64_t now_us);
+
+/**
+ * @brief Time at which a pending direction becomes due, 0 if none is pending
+ */
+int64_t motor_pending_due_us(void);
+
+/**
+ * @brief Direction the relays are driving now
+ */
+motor_dir_t motor_active(void);
+
+/**
+ * @brief Time the active direction was energised, 0 when MOTOR_OFF
+ */
+int64_t motor_active_since_us(void);
@@ -0,0 +1,162 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "config.h"
+#include "mqtt_reasm.h"
+
+#define MQTT_REASM_TOPIC_MAX    128
+#define MQTT_REASM_PROPERTY_MAX 64      // response topic / correlation data kept for buffered messages
+
+typedef enum {
+    REASM_IDLE,
+    REASM_BUFFERING,
+    REASM_STREAMING
+} reasm_state_t;
+
+static const char *TAG = "mqtt_reasm";
+
+static char s_arena[CONFIG_DOOR_MQTT_REASM_ARENA_SIZE];
+static char s_topic[MQTT_REASM_TOPIC_MAX];
+static char s_response_topic[MQTT_REASM_PROPERTY_MAX];
+static char s_correlation_data[MQTT_REASM_PROPERTY_MAX];
+static hal_mqtt_event_t s_message;      // first fragment, retargeted at the arena
+static reasm_state_t s_state;
+static int s_next_offset;
+static mqtt_reasm_deliver_cb_t s_deliver;
+static const mqtt_reasm_sink_t *s_sink;
+static void *s_arg;
+static mqtt_reasm_stats_t s_stats;
+
+void mqtt_reasm_init(mqtt_reasm_deliver_cb_t deliver, const mqtt_reasm_sink_t *sink, void *arg)
+{
+    s_deliver = deliver;
+    s_sink = sink;
+    s_arg = arg;
+    s_state = REASM_IDLE;
+}
+
+void mqtt_reasm_reset(void)
+{
+    if (s_state == REASM_IDLE) {
+        return;
+    }
+    if (s_state == REASM_STREAMING && s_sink != NULL) {
+        s_sink->end(false, s_arg);
+    }
+    s_stats.aborted++;
+    s_state = REASM_IDLE;
+}
+
+/**
+ * @brief Copy the request/response properties of a buffered message out of its first fragment
+ * @return false if they do not fit
+ */
+static bool copy_properties(const hal_mqtt_event_t *event)
+{
+    if (event->response_topic_len > (int)sizeof(s_response_topic) ||
+        event->correlation_data_len > (int)sizeof(s_correlation_data)) {
+        return false;
+    }
+    if (event->response_topic != NULL) {
+        memcpy(s_response_topic, event->response_topic, event->response_topic_len);
+        s_message.response_topic = s_response_topic;
+    }
+    if (event->correlation_data != NULL) {
+        memcpy(s_correlation_data, event->correlation_data, event->correlation_data_len);
+        s_message.correlation_data = s_correlation_data;
+    }
+    return true;
+}
+
+/**
+ * @brief Start a new multi-fragment message from its first fragment
+ */
+static void begin_message(const hal_mqtt_event_t *event)
+{
+    s_next_offset = event->data_len;
+    s_message = *event;
+
+    if (event->total_data_len <= (int)sizeof(s_arena) && event->topic_len < (int)sizeof(s_topic) &&
+        copy_properties(event)) {
+        memcpy(s_topic, event->topic, event->topic_len);
+        s_message.topic = s_topic;
+        memcpy(s_arena, event->data, event->data_len);
+        s_state = REASM_BUFFERING;
+        return;
+    }
+
+    if (s_sink == NULL) {
+        ESP_LOGW(TAG, "Discarding %d byte message on %.*s, no sink",
+                 event->total_data_len, event->topic_len, event->topic);
+        s_stats.aborted++;
+        s_state = REASM_IDLE;
+        return;
+    }
+    // Only valid during this event
+    s_message.topic = NULL;
+    s_message.response_topic = NULL;
+    s_message.correlation_data = NULL;
+    s_sink->begin(event, s_arg);
+    s_sink->chunk(event->data, event->data_len, 0, s_arg);
+    s_state = REASM_STREAMING;
+}
+
+void mqtt_reasm_feed(const hal_mqtt_event_t *event)
+{
+    if (event->current_data_offset == 0) {
+        if (s_state != REASM_IDLE) {
+            ESP_LOGW(TAG, "New message before previous one completed");
+            mqtt_reasm_reset();
+        }
+        if (event->data_len >= event->total_data_len) {
+            // Common case: whole message in one event, deliver in place
+            s_stats.delivered_whole++;
+            s_deliver(event, s_arg);
+            return;
+        }
+        begin_message(event);
+        return;
+    }
+
+    if (s_state == REASM_IDLE) {
+        // Tail of a message whose start was discarded; nothing to do
+        return;
+    }
+    if (event->current_data_offset != s_next_offset ||
+        s_next_offset + event->data_len > s_message.total_data_len) {
+        ESP_LOGW(TAG, "Out of order fragment (offset %d, expected %d)",
+                 event->current_data_offset, s_next_offset);
+        mqtt_reasm_reset();
+        return;
+    }
+
+    if (s_state == REASM_BUFFERING) {
+        memcpy(s_arena + event->current_data_offset, event->data, event->data_len);
+    } else {
+        s_sink->chunk(event->data, event->data_len, event->current_data_offset, s_arg);
+    }
+    s_next_offset += event->data_len;
+    if (s_next_offset < s_message.total_data_len) {
+        return;
+    }
+
+    if (s_state == REASM_BUFFERING) {
+        s_message.data = s_arena;
+        s_message.data_len = s_message.total_data_len;
+        s_message.current_data_offset = 0;
+        s_stats.delivered_reassembled++;
+        s_state = REASM_IDLE;
+        s_deliver(&s_message, s_arg);
+    } else {
+        s_stats.streamed++;
+        s_state = REASM_IDLE;
+        s_sink->end(true, s_arg);
+    }
+}
+
+const mqtt_reasm_stats_t *mqtt_reasm_stats(void)
+{
+    return &s_stats;
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file mqtt_reasm.h
+ * @brief Reassembly of MQTT messages split over several DATA events
+ *
+ * The MQTT client delivers a message larger than its receive buffer as a
+ * series of DATA events; only the first carries the topic, and each reports
+ * current_data_offset / total_data_len. Messages that arrive whole are passed
+ * on without copying. Fragmented messages that fit the static arena
+ * (CONFIG_DOOR_MQTT_REASM_ARENA_SIZE) are copied there, together with their
+ * response topic and correlation data, and delivered once complete. Larger
+ * ones are streamed fragment by fragment to a sink and never buffered.
+ *
+ * Must be fed from the MQTT client task only.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "hal.h"
+
+/**
+ * @brief Complete message callback
+ *
+ * The event describes the whole message: current_data_offset is 0 and
+ * data_len equals total_data_len. Pointers are valid during the call only.
+ */
+typedef void (*mqtt_reasm_deliver_cb_t)(const hal_mqtt_event_t *message, void *arg);
+
+/**
+ * @brief Streaming sink for messages larger than the arena
+ */
+typedef struct {
+    // First fragment; topic and total_data_len are valid
+    void (*begin)(const hal_mqtt_event_t *first, void *arg);
+    // Every fragment, including the first, in order
+    void (*chunk)(const char *data, int len, int offset, void *arg);
+    // complete is false if the stream was interrupted
+    void (*end)(bool complete, void *arg);
+} mqtt_reasm_sink_t;
+
+typedef struct {
+    uint32_t delivered_whole;       // delivered straight from the event, no copy
+    uint32_t delivered_reassembled; // reassembled in the arena
+    uint32_t streamed;              // handed to the sink
+    uint32_t aborted;               // incomplete sequences discarded
+} mqtt_reasm_stats_t;
+
+/**
+ * @brief Register the delivery callback and oversized-message sink
+ */
+void mqtt_reasm_init(mqtt_reasm_deliver_cb_t deliver, const mqtt_reasm_sink_t *sink, void *arg);
+
+/**
+ * @brief Feed one DATA event
+ */
+void mqtt_reasm_feed(const hal_mqtt_event_t *event);
+
+/**
+ * @brief Drop any partially received message (e.g. on disconnect)
+ */
+void mqtt_reasm_reset(void);
+
+/**
+ * @brief Counters since boot
+ */
+const mqtt_reasm_stats_t *mqtt_reasm_stats(void);
@@ -0,0 +1,582 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "outbox.h"
+
+#if CONFIG_DOOR_OUTBOX
+
+#include "crc16.h"
+#include "spsc_ring.h"
+#include "task_layout.h"
+
+#define OUTBOX_PARTITION        "outbox"
+#define OUTBOX_TASK_STACK_SIZE  3072
+#define OUTBOX_POST_SLOTS       8           // must be a power of two
+#define OUTBOX_ACK_SLOTS        32          // must be a power of two
+#define OUTBOX_BATCH            CONFIG_DOOR_OUTBOX_BATCH
+#define OUTBOX_ACK_TIMEOUT_MS   10000
+#define OUTBOX_RETRY_MS         1000        // the client refused a publish while connected
+
+#define SECTOR_MAGIC            0x584F4244u // "DBOX"
+#define RECORD_MAGIC            0xB0C5
+#define RECORD_ERASED           0xFFFF
+#define RECORD_PENDING          0xFF
+#define RECORD_SENT             0x00
+#define RECORD_FLAG_RETAIN      0x01
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+} sector_header_t;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t state;
+    uint8_t flags;
+    uint8_t topic_len;
+    uint8_t reserved;
+    uint16_t data_len;
+    uint16_t crc;               // CRC-16/CCITT of the header with state pending and crc 0, then the body
+} record_header_t;
+
+#define RECORD_MAX_SIZE         ((sizeof(record_header_t) + OUTBOX_TOPIC_MAX_LEN + OUTBOX_DATA_MAX_LEN + 3) & ~3u)
+
+// Position in the log: sector sequence number and offset within that sector
+typedef struct {
+    uint32_t seq;
+    uint32_t pos;
+} cursor_t;
+
+typedef struct {
+    bool retain;
+    uint8_t topic_len;
+    uint16_t len;
+    char topic[OUTBOX_TOPIC_MAX_LEN];
+    char data[OUTBOX_DATA_MAX_LEN];
+} post_msg_t;
+
+typedef struct {
+    uint32_t offset;            // of the record in the partition
+    uint16_t len;
+    int msg_id;
+    bool acked;
+} inflight_t;
+
+typedef enum {
+    SCAN_RECORD,                // valid record, loaded into s_record
+    SCAN_FREE,                  // erased: the log of this sector ends here
+    SCAN_END,                   // no room for another record, or a torn one
+} scan_t;
+
+static const char *TAG = "outbox";
+
+HAL_TASK_STORAGE(s_outbox_task_storage, OUTBOX_TASK_STACK_SIZE);
+static hal_task_t *s_task;
+static post_msg_t s_post_slots[OUTBOX_POST_SLOTS];
+static spsc_ring_t s_post_queue;        // control task -> outbox task
+static int s_ack_slots[OUTBOX_ACK_SLOTS];
+static spsc_ring_t s_ack_queue;         // MQTT task -> outbox task
+static hal_mqtt_client_t *s_client;     // written before s_connected is set
+static atomic_bool s_connected;
+static atomic_bool s_acks_wanted;       // a batch is in flight
+static atomic_uint s_pending;           // posted and neither acknowledged nor dropped
+static uint32_t s_post_dropped;         // producer only
+
+// Outbox task only
+static hal_flash_t *s_flash;
+static uint32_t s_sector_count;
+static cursor_t s_head;                 // where the next record is written
+static cursor_t s_tail;                 // no pending record before this
+static uint8_t s_record[RECORD_MAX_SIZE];
+static inflight_t s_inflight[OUTBOX_BATCH];
+static int s_inflight_count;
+static int s_inflight_acked;
+static int64_t s_inflight_deadline_us;
+static int64_t s_drain_start_us;        // 0 while not draining
+static uint32_t s_drain_records;
+static uint32_t s_drain_bytes;
+
+// Counters for the metrics, written by the outbox task and read on the control task
+static _Atomic uint32_t s_dropped;
+static _Atomic uint32_t s_drained;
+static _Atomic uint32_t s_last_drain_records;
+static _Atomic uint32_t s_last_drain_bytes;
+static _Atomic uint32_t s_last_drain_ms;
+
+static uint16_t record_crc(const record_header_t *header, const uint8_t *body)
+{
+    record_header_t fixed = *header;
+    fixed.state = RECORD_PENDING;
+    fixed.crc = 0;
+    uint16_t crc = crc16_ccitt(CRC16_INIT, &fixed, sizeof(fixed));
+    return crc16_ccitt(crc, body, header->topic_len + header->data_len);
+}
+
+static uint32_t record_size(uint32_t topic_len, uint32_t data_len)
+{
+    return (sizeof(record_header_t) + topic_len + data_len + 3) & ~3u;
+}
+
+static uint32_t sector_offset(uint32_t seq)
+{
+    return seq % s_sector_count * HAL_FLASH_SECTOR_SIZE;
+}
+
+static bool cursor_before(cursor_t a, cursor_t b)
+{
+    return a.seq < b.seq || (a.seq == b.seq && a.pos < b.pos);
+}
+
+static cursor_t sector_start(uint32_t seq)
+{
+    return (cursor_t) { seq, sizeof(sector_header_t) };
+}
+
+static bool sector_valid(uint32_t seq)
+{
+    sector_header_t header;
+    return hal_flash_read(s_flash, sector_offset(seq), &header, sizeof(header)) == ESP_OK &&
+           header.magic == SECTOR_MAGIC && header.seq == seq;
+}
+
+/**
+ * @brief Erase the sector for seq and stamp its header
+ */
+static bool sector_open(uint32_t seq)
+{
+    sector_header_t header = { .magic = SECTOR_MAGIC, .seq = seq };
+    uint32_t offset = sector_offset(seq);
+    return hal_flash_erase(s_flash, offset, HAL_FLASH_SECTOR_SIZE) == ESP_OK &&
+           hal_flash_write(s_flash, offset, &header, sizeof(header)) == ESP_OK;
+}
+
+/**
+ * @brief Load and check the record at a position into s_record
+ */
+static scan_t read_record(cursor_t at)
+{
+    record_header_t *header = (record_header_t *)s_record;
+    if (at.pos + sizeof(*header) > HAL_FLASH_SECTOR_SIZE) {
+        return SCAN_END;
+    }
+    uint32_t offset = sector_offset(at.seq) + at.pos;
+    if (hal_flash_read(s_flash, offset, header, sizeof(*header)) != ESP_OK) {
+        return SCAN_END;
+    }
+    if (header->magic == RECORD_ERASED) {
+        return SCAN_FREE;
+    }
+    if (header->magic != RECORD_MAGIC || header->topic_len > OUTBOX_TOPIC_MAX_LEN ||
+        header->data_len > OUTBOX_DATA_MAX_LEN ||
+        at.pos + record_size(header->topic_len, header->data_len) > HAL_FLASH_SECTOR_SIZE) {
+        return SCAN_END;
+    }
+    uint8_t *body = s_record + sizeof(*header);
+    if (hal_flash_read(s_flash, offset + sizeof(*header), body, header->topic_len + header->data_len) != ESP_OK ||
+        record_crc(header, body) != header->crc) {
+        ESP_LOGW(TAG, "Torn record in sector %" PRIu32 " at %" PRIu32, at.seq, at.pos);
+        return SCAN_END;
+    }
+    return SCAN_RECORD;
+}
+
+/**
+ * @brief Move to the first pending record at or after a position, loaded into s_record
+ * @return false if there is none before the head
+ */
+static bool find_pending(cursor_t *at)
+{
+    while (cursor_before(*at, s_head)) {
+        scan_t scan = at->pos == sizeof(sector_header_t) && !sector_valid(at->seq) ? SCAN_END : read_record(*at);
+        if (scan != SCAN_RECORD) {
+            *at = sector_start(at->seq + 1);
+            continue;
+        }
+        const record_header_t *header = (const record_header_t *)s_record;
+        if (header->state == RECORD_PENDING) {
+            return true;
+        }
+        at->pos += record_size(header->topic_len, header->data_len);
+    }
+    return false;
+}
+
+/**
+ * @brief Forget the batch in flight; its unacknowledged records stay pending
+ */
+static void cancel_batch(void)
+{
+    s_inflight_count = 0;
+    atomic_store(&s_acks_wanted, false);
+}
+
+/**
+ * @brief Ring full: give up the oldest sector so the writer can reuse it
+ */
+static void drop_tail_sector(void)
+{
+    uint32_t seq = s_tail.seq;
+    uint32_t dropped = 0;
+    cursor_t at = s_tail;
+    while (find_pending(&at) && at.seq == seq) {
+        const record_header_t *header = (const record_header_t *)s_record;
+        at.pos += record_size(header->topic_len, header->data_len);
+        dropped++;
+    }
+    if (dropped != 0) {
+        s_dropped += dropped;
+        atomic_fetch_sub(&s_pending, dropped);
+        ESP_LOGW(TAG, "Outbox full, dropped the %" PRIu32 " oldest messages", dropped);
+    }
+    // Acknowledgements must not mark records of the sector that replaces it
+    cancel_batch();
+    s_tail = sector_start(seq + 1);
+}
+
+/**
+ * @brief Append a posted message at the head of the log
+ */
+static bool append(const post_msg_t *msg)
+{
+    uint32_t size = record_size(msg->topic_len, msg->len);
+    if (s_head.pos + size > HAL_FLASH_SECTOR_SIZE) {
+        uint32_t seq = s_head.seq + 1;
+        if (seq - s_tail.seq >= s_sector_count) {
+            drop_tail_sector();
+        }
+        if (!sector_open(seq)) {
+            return false;
+        }
+        s_head = sector_start(seq);
+    }
+
+    record_header_t *header = (record_header_t *)s_record;
+    *header = (record_header_t) {
+        .magic = RECORD_MAGIC,
+        .state = RECORD_PENDING,
+        .flags = msg->retain ? RECORD_FLAG_RETAIN : 0,
+        .topic_len = msg->topic_len,
+        .reserved = 0xFF,
+        .data_len = msg->len,
+    };
+    uint8_t *body = s_record + sizeof(*header);
+    memcpy(body, msg->topic, msg->topic_len);
+    memcpy(body + msg->topic_len, msg->data, msg->len);
+    memset(body + msg->topic_len + msg->len, 0xFF, size - sizeof(*header) - msg->topic_len - msg->len);
+    header->crc = record_crc(header, body);
+
+    if (hal_flash_write(s_flash, sector_offset(s_head.seq) + s_head.pos, s_record, size) != ESP_OK) {
+        // Whatever was programmed ends this sector
+        s_head.pos = HAL_FLASH_SECTOR_SIZE;
+        return false;
+    }
+    s_head.pos += size;
+    return true;
+}
+
+/**
+ * @brief Publish the next batch of pending records from the tail
+ */
+static void send_batch(void)
+{
+    if (!find_pending(&s_tail)) {
+        return;
+    }
+    // Set before publishing, so no acknowledgement is missed
+    atomic_store(&s_acks_wanted, true);
+    s_inflight_acked = 0;
+    cursor_t at = s_tail;
+    while (s_inflight_count < OUTBOX_BATCH && find_pending(&at)) {
+        const record_header_t *header = (const record_header_t *)s_record;
+        const char *body = (const char *)s_record + sizeof(*header);
+        char topic[OUTBOX_TOPIC_MAX_LEN + 1];
+        memcpy(topic, body, header->topic_len);
+        topic[header->topic_len] = '\0';
+        int msg_id = hal_mqtt_enqueue(s_client, topic, body + header->topic_len, header->data_len, 1,
+                                      header->flags & RECORD_FLAG_RETAIN);
+        if (msg_id <= 0) {
+            break;
+        }
+        s_inflight[s_inflight_count++] = (inflight_t) {
+            .offset = sector_offset(at.seq) + at.pos,
+            .len = header->data_len,
+            .msg_id = msg_id,
+        };
+        at.pos += record_size(header->topic_len, header->data_len);
+    }
+    if (s_inflight_count == 0) {
+        cancel_batch();
+        return;
+    }
+    if (s_drain_start_us == 0) {
+        s_drain_start_us = hal_time_us();
+        s_drain_records = 0;
+        s_drain_bytes = 0;
+    }
+    s_inflight_deadline_us = hal_time_us() + (int64_t)OUTBOX_ACK_TIMEOUT_MS * 1000;
+}
+
+/**
+ * @brief Mark acknowledged records as sent; the batch ends when all are
+ */
+static void collect_acks(void)
+{
+    static const uint8_t sent = RECORD_SENT;
+    int *msg_id;
+    while ((msg_id = spsc_ring_peek(&s_ack_queue)) != NULL) {
+        for (int i = 0; i < s_inflight_count; i++) {
+            inflight_t *inflight = &s_inflight[i];
+            if (inflight->acked || inflight->msg_id != *msg_id) {
+                continue;
+            }
+            inflight->acked = true;
+            hal_flash_write(s_flash, inflight->offset + offsetof(record_header_t, state), &sent, 1);
+            s_inflight_acked++;
+            s_drain_records++;
+            s_drain_bytes += inflight->len;
+            s_drained++;
+            atomic_fetch_sub(&s_pending, 1);
+        }
+        spsc_ring_release(&s_ack_queue);
+    }
+    if (s_inflight_count != 0 && s_inflight_acked == s_inflight_count) {
+        cancel_batch();
+    }
+}
+
+/**
+ * @brief Recover head, tail and pending count from the partition
+ */
+static esp_err_t recover(void)
+{
+    s_sector_count = hal_flash_size(s_flash) / HAL_FLASH_SECTOR_SIZE;
+    if (s_sector_count < 2) {
+        return ESP_FAIL;
+    }
+    bool found = false;
+    uint32_t head_seq = 0;
+    for (uint32_t i = 0; i < s_sector_count; i++) {
+        sector_header_t header;
+        if (hal_flash_read(s_flash, i * HAL_FLASH_SECTOR_SIZE, &header, sizeof(header)) == ESP_OK &&
+            header.magic == SECTOR_MAGIC && header.seq % s_sector_count == i && (!found || header.seq > head_seq)) {
+            head_seq = header.seq;
+            found = true;
+        }
+    }
+    if (!found) {
+        s_head = s_tail = sector_start(1);
+        ESP_LOGI(TAG, "Formatting %" PRIu32 " sectors", s_sector_count);
+        return sector_open(1) ? ESP_OK : ESP_FAIL;
+    }
+
+    // End of the log in the head sector; a torn record closes it
+    s_head = sector_start(head_seq);
+    scan_t scan;
+    while ((scan = read_record(s_head)) == SCAN_RECORD) {
+        const record_header_t *header = (const record_header_t *)s_record;
+        s_head.pos += record_size(header->topic_len, header->data_len);
+    }
+    if (scan == SCAN_END) {
+        s_head.pos = HAL_FLASH_SECTOR_SIZE;
+    }
+
+    s_tail = sector_start(head_seq >= s_sector_count ? head_seq - s_sector_count + 1 : 1);
+    bool first = true;
+    unsigned pending = 0;
+    cursor_t at = s_tail;
+    while (find_pending(&at)) {
+        if (first) {
+            s_tail = at;
+            first = false;
+        }
+        const record_header_t *header = (const record_header_t *)s_record;
+        at.pos += record_size(header->topic_len, header->data_len);
+        pending++;
+    }
+    atomic_store(&s_pending, pending);
+    ESP_LOGI(TAG, "%u messages pending, writing sector %" PRIu32, pending, s_head.seq);
+    return ESP_OK;
+}
+
+/**
+ * @brief Outbox task: store posted messages, then drain while connected
+ */
+static void outbox_task(void *arg)
+{
+    for (;;) {
+        post_msg_t *msg;
+        while ((msg = spsc_ring_peek(&s_post_queue)) != NULL) {
+            if (!append(msg)) {
+                s_dropped++;
+                atomic_fetch_sub(&s_pending, 1);
+                ESP_LOGE(TAG, "Flash write failed, message on %.*s lost", msg->topic_len, msg->topic);
+            }
+            spsc_ring_release(&s_post_queue);
+        }
+        collect_acks();
+
+        bool connected = atomic_load(&s_connected);
+        if (s_inflight_count != 0 && (!connected || hal_time_us() >= s_inflight_deadline_us)) {
+            ESP_LOGW(TAG, "Batch not acknowledged, sending it again");
+            cancel_batch();
+        }
+        if (!connected) {
+            // A drain interrupted by a disconnect is not a throughput sample
+            s_drain_start_us = 0;
+        } else if (s_inflight_count == 0 && atomic_load(&s_pending) != 0) {
+            send_batch();
+        }
+        if (s_drain_start_us != 0 && atomic_load(&s_pending) == 0) {
+            s_last_drain_ms = (uint32_t)((hal_time_us() - s_drain_start_us) / 1000);
+            s_last_drain_records = s_drain_records;
+            s_last_drain_bytes = s_drain_bytes;
+            s_drain_start_us = 0;
+            ESP_LOGI(TAG, "Drained %" PRIu32 " messages (%" PRIu32 " bytes) in %" PRIu32 " ms",
+                     s_last_drain_records, s_last_drain_bytes, s_last_drain_ms);
+        }
+
+        uint32_t wait_ms = HAL_WAIT_FOREVER;
+        if (s_inflight_count != 0) {
+            int64_t left_us = s_inflight_deadline_us - hal_time_us();
+            wait_ms = left_us > 0 ? (uint32_t)((left_us + 999) / 1000) : 0;
+        } else if (connected && atomic_load(&s_pending) != 0) {
+            wait_ms = OUTBOX_RETRY_MS;
+        }
+        hal_task_wait_notify(wait_ms);
+    }
+}
+
+esp_err_t outbox_start(void)
+{
+    s_flash = hal_flash_open(OUTBOX_PARTITION);
+    if (s_flash == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition, publishing directly", OUTBOX_PARTITION);
+        return ESP_OK;
+    }
+    esp_err_t err = recover();
+    if (err != ESP_OK) {
+        s_flash = NULL;
+        return err;
+    }
+    spsc_ring_init(&s_post_queue, s_post_slots, sizeof(post_msg_t), OUTBOX_POST_SLOTS);
+    spsc_ring_init(&s_ack_queue, s_ack_slots, sizeof(int), OUTBOX_ACK_SLOTS);
+    s_task = hal_task_create_static(outbox_task, "outbox", &s_outbox_task_storage, NULL,
+                                    TASK_OUTBOX_PRIORITY, TASK_NET_CORE);
+    if (s_task == NULL) {
+        s_flash = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool outbox_active(void)
+{
+    return s_task != NULL && (!atomic_load(&s_connected) || atomic_load(&s_pending) != 0);
+}
+
+bool outbox_post(const char *topic, const char *data, int len, bool retain)
+{
+    size_t topic_len = strlen(topic);
+    post_msg_t *msg = NULL;
+    if (topic_len <= OUTBOX_TOPIC_MAX_LEN && len > 0 && len <= OUTBOX_DATA_MAX_LEN) {
+        msg = spsc_ring_reserve(&s_post_queue);
+    }
+    if (msg == NULL) {
+        s_post_dropped++;
+        return false;
+    }
+    msg->retain = retain;
+    msg->topic_len = (uint8_t)topic_len;
+    msg->len = (uint16_t)len;
+    memcpy(msg->topic, topic, topic_len);
+    memcpy(msg->data, data, len);
+    atomic_fetch_add(&s_pending, 1);
+    spsc_ring_commit(&s_post_queue);
+    hal_task_notify(s_task);
+    return true;
+}
+
+void outbox_connected(hal_mqtt_client_t *client)
+{
+    if (s_task == NULL) {
+        return;
+    }
+    s_client = client;
+    atomic_store(&s_connected, true);
+    hal_task_notify(s_task);
+}
+
+void outbox_disconnected(void)
+{
+    if (s_task == NULL) {
+        return;
+    }
+    atomic_store(&s_connected, false);
+    hal_task_notify(s_task);
+}
+
+void outbox_published(int msg_id)
+{
+    if (!atomic_load(&s_acks_wanted)) {
+        return;
+    }
+    int *slot = spsc_ring_reserve(&s_ack_queue);
+    if (slot != NULL) {
+        // A lost acknowledgement only delays the batch until its timeout
+        *slot = msg_id;
+        spsc_ring_commit(&s_ack_queue);
+    }
+    hal_task_notify(s_task);
+}
+
+int outbox_format_json(char *buf, size_t size)
+{
+    int len = snprintf(buf, size,
+                       "{\"pending\":%u,\"dropped\":%" PRIu32 ",\"drained\":%" PRIu32
+                       ",\"last_drain\":{\"records\":%" PRIu32 ",\"bytes\":%" PRIu32 ",\"ms\":%" PRIu32 "}}",
+                       atomic_load(&s_pending), s_dropped + s_post_dropped, s_drained,
+                       s_last_drain_records, s_last_drain_bytes, s_last_drain_ms);
+    return len < (int)size ? len : -1;
+}
+
+#else // !CONFIG_DOOR_OUTBOX
+
+esp_err_t outbox_start(void)
+{
+    return ESP_OK;
+}
+
+bool outbox_active(void)
+{
+    return false;
+}
+
+bool outbox_post(const char *topic, const char *data, int len, bool retain)
+{
+    return false;
+}
+
+void outbox_connected(hal_mqtt_client_t *client)
+{
+}
+
+void outbox_disconnected(void)
+{
+}
+
+void outbox_published(int msg_id)
+{
+}
+
+int outbox_format_json(char *buf, size_t size)
+{
+    int len = snprintf(buf, size, "null");
+    return len < (int)size ? len : -1;
+}
+
+#endif // CONFIG_DOOR_OUTBOX
@@ -0,0 +1,80 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file outbox.h
+ * @brief Flash-backed queue for publishes made while the broker is unreachable
+ *
+ * While disconnected, and until everything queued has been delivered, door
+ * state changes go through outbox_post() instead of the MQTT client. A task
+ * on the network core appends them to a ring log on the "outbox" data
+ * partition, where they survive an outage of any length and a reboot, and
+ * once connected drains the log oldest first: CONFIG_DOOR_OUTBOX_BATCH QoS 1
+ * publishes at a time, the next batch only after the broker acknowledged
+ * every message of the previous one. Delivery is at least once: a batch
+ * that is not fully acknowledged within OUTBOX_ACK_TIMEOUT_MS is sent again.
+ *
+ * The partition is a ring of sectors, each starting with {magic, sequence}
+ * and followed by records:
+ *
+ *     magic u16 | state u8 | flags u8 | topic_len u8 | 0xFF | data_len u16 | crc16 u16 | topic | data | pad to 4
+ *
+ * A record is pending while state is 0xFF; when acknowledged its state byte
+ * is programmed to 0 in place, so draining never erases. A sector is erased
+ * only when the writer wraps onto it, which spreads wear evenly over the
+ * partition; if it still holds pending records they are dropped (oldest
+ * first, counted in the metrics). A record with a bad CRC, torn by a power
+ * loss, ends its sector. A door that stays connected never writes flash.
+ * Each erase stalls code running from flash on both cores for its duration.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "hal.h"
+
+#define OUTBOX_TOPIC_MAX_LEN    63
+#define OUTBOX_DATA_MAX_LEN     256
+
+/**
+ * @brief Open the partition, recover the ring and start the drain task
+ *
+ * Call before anything is posted. Without a usable partition the outbox
+ * stays inactive and publishes go straight to the client.
+ */
+esp_err_t outbox_start(void);
+
+/**
+ * @brief Whether publishes must be posted rather than sent, to keep their order
+ * @return true while disconnected or while anything posted is undelivered
+ */
+bool outbox_active(void);
+
+/**
+ * @brief Queue a QoS 1 publish for the drain task; single producer
+ * @return false if the RAM hand-off queue is full or the message too long
+ */
+bool outbox_post(const char *topic, const char *data, int len, bool retain);
+
+/**
+ * @brief The client has connected: start draining; MQTT task
+ */
+void outbox_connected(hal_mqtt_client_t *client);
+
+/**
+ * @brief The client lost its connection; MQTT task
+ */
+void outbox_disconnected(void);
+
+/**
+ * @brief Forward a PUBLISHED event; MQTT task
+ */
+void outbox_published(int msg_id);
+
+/**
+ * @brief Render the counters:
+ *        {"pending":..,"dropped":..,"drained":..,"last_drain":{"records":..,"bytes":..,"ms":..}}
+ * @return Length written, or -1 if it does not fit
+ */
+int outbox_format_json(char *buf, size_t size);
@@ -0,0 +1,374 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: Apache-2.0
+
+import contextlib
+import logging
+import os
+import re
+import signal
+import socket
+import subprocess
+import time
+
+import pytest
+
+SOFTWARE_DIR = os.path.dirname(os.path.abspath(__file__))
+DOOR_PORT = 28830
+LOADGEN_PORT = 28831
+
+
+def build(tmp_path, output, sources, flags=('-lpthread',)):  # type: ignore
+    binary = str(tmp_path / output)
+    subprocess.check_call(['cc', '-std=gnu11', '-O2', '-I' + SOFTWARE_DIR, *sources, *flags, '-o', binary])
+    return binary
+
+
+def firmware_sources():  # type: ignore
+    return [os.path.join(SOFTWARE_DIR, f) for f in sorted(os.listdir(SOFTWARE_DIR)) if f.endswith('.c')]
+
+
+class UdpPeer:
+    """The broker side of the host build: sends datagrams to the door and receives its publishes"""
+
+    def __init__(self) -> None:
+        self.rx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.rx.bind(('127.0.0.1', LOADGEN_PORT))
+        self.rx.settimeout(0.05)
+        self.tx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+    def send(self, datagram):  # type: ignore
+        self.tx.sendto(datagram, ('127.0.0.1', DOOR_PORT))
+
+    def recv(self):  # type: ignore
+        """One publish; raises socket.timeout"""
+        return self.rx.recv(65536)
+
+    def receive(self, seconds, topic):  # type: ignore
+        """Payloads published on topic within the next seconds"""
+        received = []
+        end = time.time() + seconds
+        while time.time() < end:
+            try:
+                msg = self.recv()
+            except socket.timeout:
+                continue
+            if msg.startswith(topic + b'\n'):
+                received.append(msg.split(b'\n\n', 1)[1])
+        return received
+
+    def close(self) -> None:
+        self.rx.close()
+        self.tx.close()
+
+
+@pytest.fixture(scope='session')
+def door_host_binary(tmp_path_factory):  # type: ignore
+    return build(tmp_path_factory.mktemp('build'), 'door_host', firmware_sources())
+
+
+@pytest.fixture
+def door_env(tmp_path):  # type: ignore
+    """Host build environment: the test ports and a flash directory that survives restarts"""
+    flash_dir = tmp_path / 'flash'
+    flash_dir.mkdir()
+    return dict(os.environ, DOOR_HOST_PORT=str(DOOR_PORT), DOOR_HOST_PEER='127.0.0.1:{}'.format(LOADGEN_PORT),
+                DOOR_HOST_FLASH_DIR=str(flash_dir))
+
+
+@pytest.fixture
+def udp_peer():  # type: ignore
+    peer = UdpPeer()
+    yield peer
+    peer.close()
+
+
+@pytest.fixture
+def run_door(door_host_binary, door_env, tmp_path):  # type: ignore
+    """
+    Context manager running the host build for the body of a with block. Its stderr goes to log in tmp_path,
+    settle_s is left for it to start up and keyword arguments are added to door_env.
+    """
+    @contextlib.contextmanager
+    def run(log='door_host.log', settle_s=0.5, **env):  # type: ignore
+        with open(str(tmp_path / log), 'a') as log_file:
+            door = subprocess.Popen([door_host_binary], env=dict(door_env, **env), stdout=subprocess.DEVNULL,
+                                    stderr=log_file)
+            try:
+                time.sleep(settle_s)
+                yield door
+            finally:
+                door.terminate()
+                door.wait()
+    return run
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_door_host_command_throughput(tmp_path, run_door) -> None:  # type: ignore
+    """
+    steps: |
+      1. build the host-native firmware and the load generator
+      2. sweep /dorra/control from 10 to 1000 msg/s
+      3. check every command was acknowledged on /dorra/status
+    """
+    loadgen = build(tmp_path, 'door_loadgen', [os.path.join(SOFTWARE_DIR, 'tools', 'door_loadgen.c')])
+
+    with run_door():
+        res = subprocess.run([loadgen, '-s', '-R', '10,100,1000', '-d', '1000',
+                              '-t', '127.0.0.1:{}'.format(DOOR_PORT), '-l', str(LOADGEN_PORT)],
+                             stdout=subprocess.PIPE, universal_newlines=True, timeout=60)
+    logging.info('door_loadgen:\n{}'.format(res.stdout))
+    assert res.returncode == 0, 'commands went unanswered'
+    logging.info('door host pytest pass')
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_door_host_steady_state_allocations(tmp_path, run_door, udp_peer) -> None:  # type: ignore
+    """
+    steps: |
+      1. run the host-native firmware with the allocation counter preloaded
+      2. warm up with every command format and a metrics request
+      3. check that a further 600 commands allocate nothing
+    """
+    counter = build(tmp_path, 'alloc_count.so', [os.path.join(SOFTWARE_DIR, 'tools', 'alloc_count.c')],
+                    ('-shared', '-fPIC'))
+    commands = [b'open', b'stop', b'close', b'status',
+                bytes.fromhex('a2006470656e011832'),          # CBOR {0: "open", 1: 50}
+                b'{"cmd":"close","hold_s":1}']
+    log_path = tmp_path / 'door_host.log'
+
+    def traffic(count):  # type: ignore
+        for i in range(count):
+            udp_peer.send(b'/dorra/control\n\n' + commands[i % len(commands)])
+            time.sleep(0.002)
+        udp_peer.send(b'/dorra/metrics/get\n\n')
+        udp_peer.receive(0.5, b'/dorra/metrics')
+
+    def allocations():  # type: ignore
+        door.send_signal(signal.SIGUSR1)
+        time.sleep(0.2)
+        counts = re.findall(r'allocs=(\d+)', log_path.read_text(errors='replace'))
+        assert counts, 'no report from the allocation counter'
+        return int(counts[-1])
+
+    with run_door(LD_PRELOAD=counter) as door:
+        traffic(60)
+        before = allocations()
+        traffic(600)
+        after = allocations()
+    logging.info('heap allocations: {} at steady state start, {} after 600 commands'.format(before, after))
+    assert after == before, '{} allocations while processing commands'.format(after - before)
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_door_host_reconnect_backoff(tmp_path, run_door, udp_peer) -> None:  # type: ignore
+    """
+    steps: |
+      1. restart the broker stand-in for 2 s while sending a command every 10 ms
+      2. check the reconnect delays stay within the doubling backoff ceiling
+      3. report time to the first answered command and the door's own reconnect metrics
+    """
+    outage_s, base_ms = 2.0, 500
+    udp_peer.rx.settimeout(0.01)
+
+    with run_door():
+        udp_peer.send(b'$hal/broker\n\n%d' % (outage_s * 1000))
+        start = time.time()
+        answered = None
+        seq = 0
+        while answered is None and time.time() - start < 20:
+            seq += 1
+            udp_peer.send(b'/dorra/control\nresponse-topic:/test/reply\ncorrelation-data:%08x\n\nstatus' % seq)
+            try:
+                while answered is None:
+                    if udp_peer.recv().startswith(b'/test/reply\n'):
+                        answered = time.time() - start
+            except socket.timeout:
+                pass
+        udp_peer.send(b'/dorra/metrics/get\n\n')
+        metrics = udp_peer.receive(1, b'/dorra/metrics')
+
+    assert answered is not None, 'no command answered after the broker came back'
+    assert answered >= outage_s, 'command answered while the broker was down'
+    log_text = (tmp_path / 'door_host.log').read_text(errors='replace')
+    delays = [int(d) for d in re.findall(r'Reconnecting in (\d+) ms', log_text)]
+    assert delays, 'no reconnect was scheduled'
+    for attempt, delay in enumerate(delays):
+        assert delay <= base_ms << attempt, 'attempt {} waited {} ms'.format(attempt, delay)
+    match = re.search(rb'"mqtt":(\{[^}]*\})', metrics[0] if metrics else b'')
+    assert match, 'no metrics after reconnecting'
+    logging.info('reconnect delays {} ms, first command answered {:.3f} s after a {} s outage, door metrics {}'.format(
+        delays, answered, outage_s, match.group(1).decode()))
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_door_host_session_resume(tmp_path, run_door, udp_peer) -> None:  # type: ignore
+    """
+    steps: |
+      1. restart the broker stand-in for 1 s and send five commands while it is down
+      2. check the door resumes its session without subscribing again
+      3. check the commands queued for the session are answered after the reconnect
+    """
+    answered = {}
+    with run_door():
+        udp_peer.send(b'$hal/broker\n\n1000')
+        start = time.time()
+        for seq in range(1, 6):
+            udp_peer.send(b'/dorra/control\nresponse-topic:/test/reply\ncorrelation-data:%08x\n\nstatus' % seq)
+            time.sleep(0.1)
+        while len(answered) < 5 and time.time() - start < 20:
+            try:
+                reply = udp_peer.recv()
+            except socket.timeout:
+                continue
+            match = re.match(rb'/test/reply\ncorrelation-data:([0-9a-f]{8})\n', reply)
+            if match:
+                answered[int(match.group(1), 16)] = time.time() - start
+
+    log_text = (tmp_path / 'door_host.log').read_text(errors='replace')
+    assert 'Session resumed' in log_text, 'session not resumed'
+    assert log_text.count('Subscribed to /dorra/control') == 1, 'subscribed again after resuming the session'
+    assert sorted(answered) == [1, 2, 3, 4, 5], 'commands lost during the outage: {}'.format(sorted(answered))
+    assert min(answered.values()) >= 1.0, 'command answered while the broker was down'
+    logging.info('commands queued during a 1 s outage answered after {:.3f}..{:.3f} s'.format(
+        min(answered.values()), max(answered.values())))
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_door_host_offline_outbox(tmp_path, run_door, udp_peer) -> None:  # type: ignore
+    """
+    steps: |
+      1. take the broker down and move the door with the override button and limit switches
+      2. stop the door while it is still offline and start it again on the same flash partition
+      3. check the state changes are delivered once, in order, and reported as drained
+    """
+    # Override press, open limit reached, press again, closed limit reached
+    inputs = [b'14=0', b'14=1', b'33=1 32=0', b'14=0', b'14=1', b'32=1 33=0']
+    expected = [b'opening', b'open', b'closing', b'closed']
+
+    with run_door(log='offline.log'):
+        udp_peer.send(b'$hal/broker\n\n60000')
+        time.sleep(0.2)
+        for pins in inputs:
+            udp_peer.send(b'$hal/gpio\n\n' + pins)
+            time.sleep(0.2)
+        offline = udp_peer.receive(0.5, b'/dorra/door/state')
+    assert offline == [], 'state published while the broker was down'
+
+    with run_door(log='drain.log', settle_s=0):
+        states = udp_peer.receive(2, b'/dorra/door/state')
+        udp_peer.send(b'/dorra/metrics/get\n\n')
+        metrics = udp_peer.receive(1, b'/dorra/metrics')
+
+    names = [re.search(rb'"state":"(\w+)"', state).group(1) for state in states]
+    assert names == expected, 'state changes lost or reordered across the restart: {}'.format(names)
+    match = re.search(rb'"outbox":\{"pending":0,"dropped":0,"drained":4,', metrics[0] if metrics else b'')
+    assert match, 'outbox metrics: {}'.format(metrics)
+    drain_log = (tmp_path / 'drain.log').read_text(errors='replace')
+    logging.info([line for line in drain_log.splitlines() if 'Drained' in line])
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_door_host_event_journal(tmp_path, door_env, run_door, udp_peer) -> None:  # type: ignore
+    """
+    steps: |
+      1. drive the door through an obstructed close and a full cycle, then restart it
+      2. query the journal partition the host build wrote with journal_query
+      3. time the same query over a synthetic journal of a million records
+    """
+    journal_query = build(tmp_path, 'journal_query', [os.path.join(SOFTWARE_DIR, 'tools', 'journal_query.c')], ())
+    press = [b'$hal/gpio\n\n14=0', b'$hal/gpio\n\n14=1']
+    reach_open = [b'$hal/gpio\n\n33=1 32=0']
+    reach_closed = [b'$hal/gpio\n\n32=1 33=0']
+    # Open; close onto an obstacle, which reopens; close; then one full cycle from closed
+    steps = ([b'$hal/echo\n\n10000'] + press + reach_open + press +
+             [b'$hal/echo\n\n1000', b'$hal/echo\n\n10000', b'$hal/gpio\n\n32=1', b'$hal/gpio\n\n32=0'] +
+             press + reach_closed + press + reach_open + press + reach_closed)
+
+    for boot_steps in (steps, []):
+        with run_door():
+            for step in boot_steps:
+                udp_peer.send(step)
+                time.sleep(0.3)
+
+    journal = os.path.join(door_env['DOOR_HOST_FLASH_DIR'], 'journal.bin')
+    res = subprocess.run([journal_query, journal], stdout=subprocess.PIPE, universal_newlines=True, check=True)
+    logging.info('journal_query:\n{}'.format(res.stdout))
+    assert 'records 14 valid, 0 torn, 2 boots' in res.stdout
+    assert 'events 12,' in res.stdout
+    assert 'cycles 1,' in res.stdout
+    assert 'obstructions 1,' in res.stdout
+
+    synthetic = str(tmp_path / 'synthetic.bin')
+    subprocess.check_call([journal_query, '-g', '1000000', synthetic], stdout=subprocess.DEVNULL)
+    res = subprocess.run([journal_query, synthetic], stdout=subprocess.PIPE, universal_newlines=True, check=True)
+    assert 'records 1000000 valid, 0 torn, 10 boots' in res.stdout
+    logging.info(res.stdout.splitlines()[-1])
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_door_host_fast_boot(tmp_path, run_door, udp_peer) -> None:  # type: ignore
+    """
+    steps: |
+      1. open the door, then restart it with a 1.5 s network bring-up
+      2. check the saved state is restored and the boot timeline is logged
+      3. check the override button works before the network is up
+    """
+    with run_door():
+        for pins in (b'14=0', b'14=1', b'33=1 32=0'):
+            udp_peer.send(b'$hal/gpio\n\n' + pins)
+            time.sleep(0.2)
+
+    with run_door(log='restart.log', settle_s=0.3, DOOR_HOST_NET_DELAY_MS='1500'):
+        for pins in (b'14=0', b'14=1'):
+            udp_peer.send(b'$hal/gpio\n\n' + pins)
+            time.sleep(0.05)
+        states = udp_peer.receive(2.5, b'/dorra/door/state')
+
+    restart = (tmp_path / 'restart.log').read_text(errors='replace')
+    assert 'Saved door state open at 100 %' in restart
+    assert 'Door starts stopped at 100 %' in restart, 'no limit switch active, so stopped near the open end'
+    timeline = re.search(r'Boot: local control after (\d+) ms, connected after (\d+) ms', restart)
+    assert timeline, 'no boot timeline'
+    control_ms, connected_ms = int(timeline.group(1)), int(timeline.group(2))
+    assert control_ms < 100 and connected_ms >= 1500
+    # The button press, made while the network was still coming up, was acted on at once and delivered later
+    match = re.search(rb'"state":"opening","from":"stopped","ms":(\d+)', states[0] if states else b'')
+    assert match and int(match.group(1)) < 1500, 'override not handled before the network: {}'.format(states)
+    logging.info(re.search(r'Boot timeline: .*', restart).group(0))
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_door_host_plant_sim(tmp_path) -> None:  # type: ignore
+    """
+    steps: |
+      1. run door_sim for 2000 open/close cycles, half of them with a person stepping into the closing door
+      2. check it ends without faults, relay overlaps or collisions and that reversals stay fast
+      3. run it again with the same seed and check the report is identical apart from the wall time
+    """
+    door_sim = build(tmp_path, 'door_sim', [os.path.join(SOFTWARE_DIR, 'tools', 'door_sim.c')] +
+                     [os.path.join(SOFTWARE_DIR, f) for f in ('door_fsm.c', 'motor_control.c', 'door_inputs.c')],
+                     ('-lm',))
+    reports = []
+    for _ in range(2):
+        res = subprocess.run([door_sim, '-n', '2000', '-p', '0.5', '-s', '7'], stdout=subprocess.PIPE,
+                             universal_newlines=True, timeout=60)
+        logging.info('door_sim:\n{}'.format(res.stdout))
+        assert res.returncode == 0
+        reports.append([line for line in res.stdout.splitlines() if not line.startswith('wall ')])
+
+    report = '\n'.join(reports[0])
+    assert 'cycles 2000,' in report
+    assert 'faults 0, relay overlaps 0, collisions 0' in report
+    reversal = re.search(r'reversal +ms: n (\d+) p50 (\d+) p99 (\d+) max (\d+)', report)
+    # Sampled at 10 Hz, so a reversal takes one sample, or a few when echoes are lost
+    assert reversal and int(reversal.group(1)) > 500 and int(reversal.group(4)) < 500, report
+    assert reports[0] == reports[1], 'not deterministic for one seed'
@@ -0,0 +1,184 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "binlog.h"
+#include "spsc_ring.h"
+#include "task_layout.h"
+#include "sensors.h"
+
+#define SENSOR_TASK_STACK_SIZE  2560
+#define SENSOR_EVENT_SLOTS      8           // must be a power of two
+#define SENSOR_PERIOD_US        (1000000 / CONFIG_DOOR_SENSOR_RATE_HZ)
+// Inverse of sensor_width_to_mm(), rounded up
+#define SENSOR_MAX_WIDTH_US     (((uint32_t)CONFIG_DOOR_SENSOR_MAX_RANGE_MM << 16) / 11239u + 1)
+// The capture reports an echo after the line has also been idle this long
+#define SENSOR_ECHO_TIMEOUT_MS  (2 * SENSOR_MAX_WIDTH_US / 1000 + 5)
+
+typedef struct {
+    uint32_t samples;
+    uint32_t no_echo;
+    uint32_t last_mm;
+    uint32_t cpu_us_max;
+    uint64_t cpu_us_total;
+    int64_t start_us;
+} sensor_stats_t;
+
+static const char *TAG = "sensors";
+
+static hal_task_t *s_sensor_task;
+HAL_TASK_STORAGE(s_sensor_task_storage, SENSOR_TASK_STACK_SIZE);
+static hal_task_t *s_consumer;
+static atomic_uint s_echo_width_us;     // 0 until the echo callback has run
+static atomic_uint s_echo_cpu_us;       // time spent in the echo callback
+static sensor_event_t s_event_slots[SENSOR_EVENT_SLOTS];
+static spsc_ring_t s_events;
+static bool s_obstacle;
+static sensor_stats_t s_stats;
+
+/**
+ * @brief Echo callback (interrupt context): hand the width to the sensor task
+ */
+static void echo_done(uint32_t width_us, void *arg)
+{
+    int64_t start = hal_time_us();
+    atomic_store_explicit(&s_echo_width_us, width_us, memory_order_relaxed);
+    atomic_store_explicit(&s_echo_cpu_us, (unsigned)(hal_time_us() - start), memory_order_release);
+    hal_task_notify_from_isr(s_sensor_task);
+}
+
+/**
+ * @brief Apply the obstacle threshold with hysteresis and report changes
+ */
+static void process_sample(uint32_t distance_mm, int64_t time_us)
+{
+    bool obstacle = sensor_obstacle(s_obstacle, distance_mm);
+    if (obstacle == s_obstacle) {
+        return;
+    }
+
+    sensor_event_t *event = spsc_ring_reserve(&s_events);
+    if (event == NULL) {
+        // Keep the old state so the change is reported with the next sample
+        return;
+    }
+    s_obstacle = obstacle;
+    BINLOG(OBSTACLE, obstacle, distance_mm);
+    event->time_us = time_us;
+    event->distance_mm = distance_mm;
+    event->obstacle = obstacle;
+    spsc_ring_commit(&s_events);
+    hal_task_notify(s_consumer);
+}
+
+/**
+ * @brief Sensor task: one trigger per period, convert, threshold
+ */
+static void sensor_task(void *arg)
+{
+    // The echo callback needs s_sensor_task, which is set once the task exists
+    hal_task_wait_notify(HAL_WAIT_FOREVER);
+    int64_t next_us = hal_time_us();
+    uint32_t state = hal_core_lock();
+    s_stats.start_us = next_us;
+    hal_core_unlock(state);
+
+    for (;;) {
+        int64_t trigger_start = hal_time_us();
+        atomic_store(&s_echo_width_us, 0);
+        atomic_store(&s_echo_cpu_us, 0);
+        if (hal_echo_trigger() != ESP_OK) {
+            ESP_LOGW(TAG, "Trigger failed");
+        }
+        int64_t trigger_end = hal_time_us();
+
+        // The capture runs without the CPU; sleep until the echo callback wakes us
+        uint32_t width = atomic_load(&s_echo_width_us);
+        if (width == 0 && hal_task_wait_notify(SENSOR_ECHO_TIMEOUT_MS)) {
+            width = atomic_load(&s_echo_width_us);
+        }
+
+        int64_t process_start = hal_time_us();
+        uint32_t distance_mm = width != 0 ? sensor_width_to_mm(width) : SENSOR_OUT_OF_RANGE;
+        process_sample(distance_mm, process_start);
+        int64_t process_end = hal_time_us();
+
+        uint32_t cpu_us = (uint32_t)(trigger_end - trigger_start) + (uint32_t)(process_end - process_start) +
+                          atomic_load_explicit(&s_echo_cpu_us, memory_order_acquire);
+        // The 64-bit sum takes two stores on the ESP32; a reader on this core must not see half of it
+        uint32_t state = hal_core_lock();
+        s_stats.samples++;
+        s_stats.no_echo += width == 0;
+        s_stats.last_mm = distance_mm;
+        s_stats.cpu_us_total += cpu_us;
+        if (cpu_us > s_stats.cpu_us_max) {
+            s_stats.cpu_us_max = cpu_us;
+        }
+        hal_core_unlock(state);
+
+        // Fixed rate: a late sample does not shift the ones after it
+        next_us += SENSOR_PERIOD_US;
+        int64_t now = hal_time_us();
+        if (next_us < now) {
+            next_us = now;
+        }
+        while (now < next_us) {
+            hal_task_wait_notify((uint32_t)((next_us - now + 999) / 1000));
+            now = hal_time_us();
+        }
+    }
+}
+
+esp_err_t sensors_start(hal_task_t *consumer)
+{
+    s_consumer = consumer;
+    spsc_ring_init(&s_events, s_event_slots, sizeof(sensor_event_t), SENSOR_EVENT_SLOTS);
+
+    esp_err_t err = hal_echo_init(CONFIG_DOOR_SENSOR_TRIGGER_GPIO, CONFIG_DOOR_SENSOR_ECHO_GPIO,
+                                  SENSOR_MAX_WIDTH_US, echo_done, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Echo capture setup failed (%d)", err);
+        return err;
+    }
+    s_sensor_task = hal_task_create_static(sensor_task, "door_sensor", &s_sensor_task_storage, NULL,
+                                    TASK_SENSOR_PRIORITY, TASK_CONTROL_CORE);
+    if (s_sensor_task == NULL) {
+        return ESP_FAIL;
+    }
+    hal_task_notify(s_sensor_task);
+    ESP_LOGI(TAG, "Ultrasonic sensor at %d Hz, range %d mm, obstacle below %d mm",
+             CONFIG_DOOR_SENSOR_RATE_HZ, CONFIG_DOOR_SENSOR_MAX_RANGE_MM, CONFIG_DOOR_OBSTACLE_MM);
+    return ESP_OK;
+}
+
+bool sensors_next(sensor_event_t *event)
+{
+    sensor_event_t *queued = spsc_ring_peek(&s_events);
+    if (queued == NULL) {
+        return false;
+    }
+    *event = *queued;
+    spsc_ring_release(&s_events);
+    return true;
+}
+
+int sensors_format_json(char *buf, size_t size)
+{
+    uint32_t state = hal_core_lock();
+    sensor_stats_t stats = s_stats;
+    hal_core_unlock(state);
+    int64_t elapsed_us = hal_time_us() - stats.start_us;
+    uint32_t load_ppm = elapsed_us > 0 ? (uint32_t)(stats.cpu_us_total * 1000000 / elapsed_us) : 0;
+
+    int n = snprintf(buf, size,
+                     "{\"rate_hz\":%d,\"samples\":%" PRIu32 ",\"no_echo\":%" PRIu32 ",\"last_mm\":%" PRId32
+                     ",\"cpu_us_avg\":%" PRIu32 ",\"cpu_us_max\":%" PRIu32 ",\"load_ppm\":%" PRIu32 "}",
+                     CONFIG_DOOR_SENSOR_RATE_HZ, stats.samples, stats.no_echo,
+                     stats.last_mm == SENSOR_OUT_OF_RANGE ? -1 : (int32_t)stats.last_mm,
+                     stats.samples ? (uint32_t)(stats.cpu_us_total / stats.samples) : 0,
+                     stats.cpu_us_max, load_ppm);
+    return n < 0 || (size_t)n >= size ? -1 : n;
+}
@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file sensors.h
+ * @brief Ultrasonic obstacle sensing
+ *
+ * A sensor task triggers the HC-SR04 at CONFIG_DOOR_SENSOR_RATE_HZ. Trigger
+ * pulse and echo width are timed by hardware (hal_echo_*); the task only
+ * converts the width to millimetres in fixed point and applies the obstacle
+ * threshold with hysteresis. Obstacle changes are handed to the control task
+ * through a lock-free ring. The CPU time spent per sample (trigger call, echo
+ * callback, conversion) is measured so the cost of sensing is known.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "hal.h"
+
+typedef struct {
+    int64_t time_us;            // sample time
+    uint32_t distance_mm;       // SENSOR_OUT_OF_RANGE when there was no echo
+    bool obstacle;
+} sensor_event_t;
+
+#define SENSOR_OUT_OF_RANGE     UINT32_MAX
+
+/**
+ * @brief Echo width to distance: 0.1715 mm/us (343 m/s, there and back) in Q16
+ *
+ * 32-bit math does not overflow below 380 ms, far beyond any echo.
+ */
+static inline uint32_t sensor_width_to_mm(uint32_t width_us)
+{
+    return (width_us * 11239u + 32768u) >> 16;
+}
+
+/**
+ * @brief Obstacle threshold with hysteresis: set at CONFIG_DOOR_OBSTACLE_MM, cleared 1/8 beyond it
+ * @param obstacle Result for the previous sample
+ */
+static inline bool sensor_obstacle(bool obstacle, uint32_t distance_mm)
+{
+    uint32_t clear_mm = CONFIG_DOOR_OBSTACLE_MM + CONFIG_DOOR_OBSTACLE_MM / 8;
+    return obstacle ? distance_mm <= clear_mm : distance_mm <= CONFIG_DOOR_OBSTACLE_MM;
+}
+
+/**
+ * @brief Start sampling
+ * @param consumer Task woken when the obstacle state changes
+ */
+esp_err_t sensors_start(hal_task_t *consumer);
+
+/**
+ * @brief Fetch the next obstacle change (consumer task)
+ * @return false when there is none
+ */
+bool sensors_next(sensor_event_t *event);
+
+/**
+ * @brief Render sampling statistics:
+ *        {"rate_hz":..,"samples":..,"no_echo":..,"last_mm":..,"cpu_us_avg":..,"cpu_us_max":..,"load_ppm":..}
+ *
+ * The statistics are copied under hal_core_lock(), which only excludes the
+ * sensor task when called from its core (TASK_CONTROL_CORE, the control task).
+ * @return Length written (excluding NUL), or -1 if buf is too small
+ */
+int sensors_format_json(char *buf, size_t size);
@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file spsc_ring.h
+ * @brief Lock-free single-producer/single-consumer ring of fixed-size slots
+ *
+ * Storage is supplied by the caller, so rings can live in static memory.
+ * Exactly one context may produce and one may consume; the producer may be an
+ * ISR. Slots are filled and drained in place (reserve/commit, peek/release)
+ * to avoid an extra copy.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+typedef struct {
+    uint8_t *storage;
+    size_t slot_size;
+    uint32_t mask;          // capacity - 1, capacity is a power of two
+    atomic_uint head;       // next slot to write, owned by the producer
+    atomic_uint tail;       // next slot to read, owned by the consumer
+} spsc_ring_t;
+
+/**
+ * @brief Initialise a ring over caller-provided storage
+ * @param storage slot_size * capacity bytes
+ * @param capacity Number of slots, must be a power of two
+ */
+static inline void spsc_ring_init(spsc_ring_t *ring, void *storage, size_t slot_size, uint32_t capacity)
+{
+    ring->storage = storage;
+    ring->slot_size = slot_size;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+/**
+ * @brief Producer: get the next free slot, or NULL if the ring is full
+ */
+static inline void *spsc_ring_reserve(spsc_ring_t *ring)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask) {
+        return NULL;
+    }
+    return ring->storage + (size_t)(head & ring->mask) * ring->slot_size;
+}
+
+/**
+ * @brief Producer: publish the slot returned by spsc_ring_reserve()
+ */
+static inline void spsc_ring_commit(spsc_ring_t *ring)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Consumer: get the oldest filled slot, or NULL if the ring is empty
+ */
+static inline void *spsc_ring_peek(spsc_ring_t *ring)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail == head) {
+        return NULL;
+    }
+    return ring->storage + (size_t)(tail & ring->mask) * ring->slot_size;
+}
+
+/**
+ * @brief Consumer: hand the slot returned by spsc_ring_peek() back to the producer
+ */
+static inline void spsc_ring_release(spsc_ring_t *ring)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * @brief Number of filled slots (approximate when called concurrently)
+ */
+static inline uint32_t spsc_ring_count(spsc_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
@@ -0,0 +1,39 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file task_layout.h
+ * @brief Core and priority of every task and interrupt
+ *
+ * The ESP32 has two cores. The network stack and everything that talks to
+ * it stays on the PRO core (0); door control owns the APP core (1), so a
+ * Wi-Fi or MQTT burst never delays a limit switch or a relay:
+ *
+ *     core  task / interrupt          priority  notes
+ *     0     Wi-Fi, lwIP tcpip         18..23    ESP-IDF, pinned by sdkconfig (see README)
+ *     0     esp-mqtt client           5         CONFIG_MQTT_USE_CORE_0
+ *     0     outbox                    3         flash log of offline publishes
+ *     0     telemetry                 2         /dorra/diag reports
+ *     0     binlog drain              1         console output
+ *     1     door_ctrl                 10        commands, inputs, FSM, relay dead time
+ *     1     door_sensor               6         ultrasonic trigger and threshold
+ *     1     GPIO and RMT interrupts   -         installed from core 1 (hal_run_on_core)
+ *
+ * Relay timing has no timer of its own: the dead time and end of travel are
+ * deadlines of door_fsm_poll() on the control task. On single-core chips
+ * everything runs on core 0 with the same priorities.
+ */
+#pragma once
+
+#include "hal.h"
+
+#define TASK_NET_CORE               0
+#define TASK_CONTROL_CORE           (HAL_CORE_COUNT > 1 ? 1 : 0)
+
+#define TASK_MQTT_PRIORITY          5           // esp-mqtt default
+#define TASK_CONTROL_PRIORITY       10          // above esp-mqtt
+#define TASK_SENSOR_PRIORITY        6           // below the control task, above esp-mqtt
+#define TASK_OUTBOX_PRIORITY        3           // below esp-mqtt, whose acks it waits for
+#define TASK_TELEMETRY_PRIORITY     2
+#define TASK_BINLOG_PRIORITY        1
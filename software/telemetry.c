@@ -0,0 +1,107 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include "config.h"
+#include "task_layout.h"
+#include "telemetry.h"
+
+#define TELEMETRY_TASK_STACK_SIZE   3072
+#define TELEMETRY_MAX_TASKS         24
+#define TELEMETRY_MSG_MAX_LEN       1536
+
+typedef struct {
+    uint32_t id;
+    uint32_t run_time_us;
+} run_time_sample_t;
+
+static const char *TAG = "telemetry";
+
+HAL_TASK_STORAGE(s_telemetry_task_storage, TELEMETRY_TASK_STACK_SIZE);
+static hal_mqtt_client_t *s_client;
+static const char *s_topic;
+// Telemetry task only
+static hal_task_info_t s_tasks[TELEMETRY_MAX_TASKS];
+static run_time_sample_t s_prev[TELEMETRY_MAX_TASKS];
+static int s_prev_count;
+static int64_t s_prev_time_us;
+static char s_msg[TELEMETRY_MSG_MAX_LEN];
+
+/**
+ * @brief Run time of a task at the previous report, 0 if it is new
+ */
+static uint32_t prev_run_time(uint32_t id)
+{
+    for (int i = 0; i < s_prev_count; i++) {
+        if (s_prev[i].id == id) {
+            return s_prev[i].run_time_us;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Render one report and remember run times for the next
+ * @return Length written, or -1 if tasks cannot be listed or do not fit
+ */
+static int format_report(char *buf, size_t size)
+{
+    int count = hal_task_list(s_tasks, TELEMETRY_MAX_TASKS);
+    if (count < 0) {
+        return -1;
+    }
+    int64_t now = hal_time_us();
+    uint32_t elapsed_us = (uint32_t)(now - s_prev_time_us);
+
+    int len = snprintf(buf, size, "{\"up_s\":%" PRId64 ",\"period_s\":%d,\"heap\":[%" PRIu32 ",%" PRIu32 "],\"tasks\":[",
+                       now / 1000000, CONFIG_DOOR_DIAG_PERIOD_S, hal_free_heap_size(), hal_min_free_heap_size());
+    for (int i = 0; i < count && len < (int)size; i++) {
+        const hal_task_info_t *task = &s_tasks[i];
+        // Unsigned difference: the run-time counter wraps
+        uint32_t run_us = task->run_time_us - prev_run_time(task->id);
+        uint32_t cpu_ppm = elapsed_us == 0 ? 0 : (uint32_t)((uint64_t)run_us * 1000000 / elapsed_us);
+        len += snprintf(buf + len, size - len, "%s[\"%s\",%d,%d,%" PRIu32 ",%" PRIu32 "]", i ? "," : "",
+                        task->name, task->core, task->priority, cpu_ppm, task->stack_free_min);
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "]}");
+    }
+
+    for (int i = 0; i < count; i++) {
+        s_prev[i] = (run_time_sample_t) { s_tasks[i].id, s_tasks[i].run_time_us };
+    }
+    s_prev_count = count;
+    s_prev_time_us = now;
+    return len < (int)size ? len : -1;
+}
+
+static void telemetry_task(void *arg)
+{
+    // Baseline run times, so the first report covers one period
+    format_report(s_msg, sizeof(s_msg));
+    for (;;) {
+        hal_task_wait_notify((uint32_t)CONFIG_DOOR_DIAG_PERIOD_S * 1000);
+        int len = format_report(s_msg, sizeof(s_msg));
+        if (len < 0) {
+            ESP_LOGW(TAG, "Task list unavailable or over %d bytes", TELEMETRY_MSG_MAX_LEN);
+            continue;
+        }
+        // QoS 0 is not queued while offline; a lost report is replaced by the next
+        if (hal_mqtt_publish(s_client, s_topic, s_msg, len, 0, 0) < 0) {
+            ESP_LOGD(TAG, "Report not sent");
+        }
+    }
+}
+
+esp_err_t telemetry_start(hal_mqtt_client_t *client, const char *topic)
+{
+    s_client = client;
+    s_topic = topic;
+    if (hal_task_create_static(telemetry_task, "telemetry", &s_telemetry_task_storage, NULL,
+                        TASK_TELEMETRY_PRIORITY, TASK_NET_CORE) == NULL) {
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Diagnostics on %s every %d s", topic, CONFIG_DOOR_DIAG_PERIOD_S);
+    return ESP_OK;
+}
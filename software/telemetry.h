@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file telemetry.h
+ * @brief Periodic task and heap diagnostics
+ *
+ * A low-priority task on the network core wakes every
+ * CONFIG_DOOR_DIAG_PERIOD_S and publishes (QoS 0) one line per task with
+ * its CPU share over the period, core, priority and lowest-ever free
+ * stack, plus free and lowest-ever free heap:
+ *
+ *     {"up_s":..,"period_s":..,"heap":[free,min_free],
+ *      "tasks":[[name,core,priority,cpu_ppm,stack_free_min],..]}
+ *
+ * cpu_ppm is the share of one core; core is -1 for an unpinned task. Rows
+ * are arrays rather than objects to keep a full report within one MQTT
+ * packet. A report is skipped while the client is offline.
+ */
+#pragma once
+
+#include "hal.h"
+
+/**
+ * @brief Start the diagnostics task
+ * @param topic Publish topic, must stay valid
+ */
+esp_err_t telemetry_start(hal_mqtt_client_t *client, const char *topic);
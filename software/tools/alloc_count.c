@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file alloc_count.c
+ * @brief Heap call counter for the host build, loaded with LD_PRELOAD
+ *
+ * Counts every malloc, calloc, realloc and aligned allocation of the
+ * process. SIGUSR1 writes "allocs=<n> bytes=<n>" to stderr, so a test can
+ * sample the count before and after a stretch of steady-state traffic:
+ *
+ *     cc -std=gnu11 -O2 -shared -fPIC software/tools/alloc_count.c -o alloc_count.so
+ *     LD_PRELOAD=./alloc_count.so ./door_host 2>alloc.log &
+ *     kill -USR1 $!
+ *
+ * Forwards to glibc's internal entry points, so it only works with glibc.
+ */
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static atomic_ulong s_allocs;
+static atomic_ulong s_bytes;
+
+static void count(size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_bytes, size, memory_order_relaxed);
+}
+
+void *malloc(size_t size)
+{
+    count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count_, size_t size)
+{
+    count(count_ * size);
+    return __libc_calloc(count_, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    void *p = memalign(alignment, size);
+    if (p == NULL) {
+        return 12;      // ENOMEM
+    }
+    *ptr = p;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+/**
+ * @brief Append a decimal number; async-signal-safe
+ */
+static size_t put_ulong(char *buf, unsigned long value)
+{
+    char digits[24];
+    size_t n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = digits[n - 1 - i];
+    }
+    return n;
+}
+
+static void report(int signo)
+{
+    (void)signo;
+    char line[80];
+    size_t len = 0;
+    memcpy(line, "allocs=", 7);
+    len = 7 + put_ulong(line + 7, atomic_load(&s_allocs));
+    memcpy(line + len, " bytes=", 7);
+    len += 7;
+    len += put_ulong(line + len, atomic_load(&s_bytes));
+    line[len++] = '\n';
+    (void)!write(STDERR_FILENO, line, len);
+}
+
+__attribute__((constructor)) static void install(void)
+{
+    struct sigaction action = { .sa_handler = report, .sa_flags = SA_RESTART };
+    sigaction(SIGUSR1, &action, NULL);
+}
@@ -0,0 +1,478 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file door_loadgen.c
+ * @brief Command-path load generator and throughput benchmark for the host build
+ *
+ * Sends commands to the door's control topic through the UDP broker stand-in
+ * of hal_posix.c at a fixed open-loop rate and reports ack throughput, drops
+ * and round-trip percentiles.
+ *
+ * By default every command carries an MQTT5 response topic and an 8-byte
+ * correlation id. The door echoes the correlation data in its reply, so every
+ * reply is matched to its request exactly and the round-trip time is measured
+ * per command. With -s the commands carry no properties and the acks are
+ * taken from /dorra/status, as a plain MQTT client sees them; they are matched
+ * in order, so after a drop the following round trips are attributed to
+ * earlier commands and read high.
+ *
+ * -R runs one step per rate (1 to 10000 msg/s) and prints a table, so a
+ * regression in the command path shows up as a number:
+ *     rate  sent  acks  drops  ack/s  p50 us  p90 us  p99 us  p99.9 us  max us
+ *
+ * Build and run (door_host listening on the default ports):
+ *     cc -std=gnu11 -O2 -Isoftware software/tools/door_loadgen.c -lpthread -o door_loadgen
+ *     ./door_loadgen -n 10000 -r 2000 -c open
+ *     ./door_loadgen -s -R 1,10,100,1000,5000,10000 -d 2000
+ * The exit status is non-zero if any command went unanswered.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define LOADGEN_CONTROL_TOPIC   "/dorra/control"
+#define LOADGEN_REPLY_TOPIC     "/dorra/loadgen/reply"
+#define LOADGEN_STATUS_TOPIC    "/dorra/status"
+#define LOADGEN_MAX_DATAGRAM    65507
+#define LOADGEN_MAX_RATE        10000
+#define LOADGEN_MAX_STEPS       16
+#define LOADGEN_STEP_PAUSE_MS   200     // lets the door drain between sweep steps
+#define LOADGEN_MAX_ALIASES     16
+#define LOADGEN_MAX_TOPIC_LEN   128
+
+typedef struct {
+    int count;
+    int rate;                   // commands per second, 0 for as fast as possible
+    const char *command;
+    struct sockaddr_in door;
+    int listen_port;
+    int drain_ms;               // how long to wait for late replies
+    bool status_acks;           // match acks on the status topic in order
+    int duration_ms;            // per sweep step, overrides count when set
+    int rates[LOADGEN_MAX_STEPS];
+    int rate_count;             // 0: single run at rate
+} loadgen_opts_t;
+
+typedef struct {
+    int rate;
+    int sent;
+    size_t acks;
+    int64_t send_ns;            // first to last send
+    int64_t ack_ns;             // first send to last ack, at least the scheduled duration
+    int64_t rtt_ns[6];          // min, p50, p90, p99, p99.9, max
+} loadgen_result_t;
+
+static loadgen_opts_t s_opts = {
+    .count = 1000,
+    .rate = 1000,
+    .command = "status",
+    .listen_port = 18831,
+    .drain_ms = 1000,
+};
+
+static int64_t *s_sent_ns;      // send time per sequence number
+static int64_t *s_rtt_ns;       // round-trip time, -1 until the reply arrives
+static volatile int s_count;    // commands in the current step
+static volatile bool s_sending_done;
+static int s_sock;
+static unsigned long s_replies;
+static unsigned long s_unmatched;
+static unsigned long s_duplicates;
+static int64_t s_last_ack_ns;
+static char s_aliases[LOADGEN_MAX_ALIASES][LOADGEN_MAX_TOPIC_LEN];     // receiver thread only
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Parse "host:port" into an IPv4 address
+ */
+static bool parse_addr(const char *text, struct sockaddr_in *addr)
+{
+    char host[64];
+    const char *colon = strrchr(text, ':');
+    if (colon == NULL || colon - text >= (int)sizeof(host)) {
+        return false;
+    }
+    memcpy(host, text, colon - text);
+    host[colon - text] = '\0';
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)atoi(colon + 1));
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1;
+}
+
+/**
+ * @brief Check the topic of a datagram, resolving MQTT5 topic aliases
+ * @return Start of the property lines, NULL if the topic differs
+ */
+static const char *match_topic(const char *buf, int len, const char *topic)
+{
+    const char *end = buf + len;
+    const char *line = memchr(buf, '\n', len);
+    if (line == NULL) {
+        return NULL;
+    }
+    const char *name = buf;
+    int name_len = (int)(line - buf);
+    const char *props = line + 1;
+
+    static const char key[] = "topic-alias:";
+    for (const char *prop = props; prop < end && *prop != '\n';) {
+        const char *eol = memchr(prop, '\n', end - prop);
+        if (eol == NULL) {
+            break;
+        }
+        if (eol - prop > (int)sizeof(key) - 1 && memcmp(prop, key, sizeof(key) - 1) == 0) {
+            int alias = atoi(prop + sizeof(key) - 1);
+            if (alias < 1 || alias > LOADGEN_MAX_ALIASES) {
+                return NULL;
+            }
+            char *mapped = s_aliases[alias - 1];
+            if (name_len > 0) {
+                // First use of the alias on this connection: learn its topic
+                snprintf(mapped, LOADGEN_MAX_TOPIC_LEN, "%.*s", name_len, name);
+            } else {
+                name = mapped;
+                name_len = (int)strlen(mapped);
+            }
+            break;
+        }
+        prop = eol + 1;
+    }
+
+    if (name_len != (int)strlen(topic) || memcmp(name, topic, name_len) != 0) {
+        return NULL;
+    }
+    return props;
+}
+
+/**
+ * @brief Find a header property and decode its 8-byte hex correlation id
+ * @return false if the datagram is not a reply carrying our correlation data
+ */
+static bool parse_reply(const char *buf, int len, uint64_t *seq)
+{
+    const char *end = buf + len;
+    const char *line = match_topic(buf, len, LOADGEN_REPLY_TOPIC);
+    if (line == NULL) {
+        return false;
+    }
+    while (line < end && *line != '\n') {
+        const char *eol = memchr(line, '\n', end - line);
+        if (eol == NULL) {
+            return false;
+        }
+        static const char key[] = "correlation-data:";
+        if (eol - line == (int)sizeof(key) - 1 + 16 && memcmp(line, key, sizeof(key) - 1) == 0) {
+            char hex[17];
+            memcpy(hex, line + sizeof(key) - 1, 16);
+            hex[16] = '\0';
+            char *parse_end;
+            *seq = strtoull(hex, &parse_end, 16);
+            return *parse_end == '\0';
+        }
+        line = eol + 1;
+    }
+    return false;
+}
+
+/**
+ * @brief Receive replies and record round-trip times until the drain period ends
+ */
+static void *receiver_thread(void *arg)
+{
+    (void)arg;
+    static char buf[LOADGEN_MAX_DATAGRAM];
+    int64_t deadline = 0;
+
+    for (;;) {
+        if (s_sending_done && deadline == 0) {
+            deadline = now_ns() + (int64_t)s_opts.drain_ms * 1000000;
+        }
+        if (deadline != 0 && (now_ns() >= deadline || s_replies == (unsigned long)s_count)) {
+            break;
+        }
+        ssize_t len = recv(s_sock, buf, sizeof(buf), 0);
+        int64_t rx_ns = now_ns();
+        if (len <= 0) {
+            continue;       // receive timeout, re-check the deadline
+        }
+        uint64_t seq;
+        if (s_opts.status_acks) {
+            if (match_topic(buf, (int)len, LOADGEN_STATUS_TOPIC) == NULL) {
+                continue;   // door state or metrics traffic
+            }
+            seq = s_replies;
+        } else if (!parse_reply(buf, (int)len, &seq)) {
+            continue;       // status or metrics traffic from the door
+        }
+        if (seq >= (uint64_t)s_count || s_sent_ns[seq] == 0) {
+            s_unmatched++;
+        } else if (s_rtt_ns[seq] >= 0) {
+            s_duplicates++;
+        } else {
+            s_rtt_ns[seq] = rx_ns - s_sent_ns[seq];
+            s_last_ack_ns = rx_ns;
+            s_replies++;
+        }
+    }
+    return NULL;
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Summarise the round-trip distribution of the answered commands
+ */
+static void summarise(loadgen_result_t *result)
+{
+    int64_t *sorted = malloc(sizeof(int64_t) * (s_count ? s_count : 1));
+    size_t n = 0;
+    for (int i = 0; i < s_count; i++) {
+        if (s_rtt_ns[i] >= 0) {
+            sorted[n++] = s_rtt_ns[i];
+        }
+    }
+    qsort(sorted, n, sizeof(int64_t), compare_i64);
+
+    result->acks = n;
+    memset(result->rtt_ns, 0, sizeof(result->rtt_ns));
+    if (n > 0) {
+        static const double percentiles[] = { 50, 90, 99, 99.9 };
+        result->rtt_ns[0] = sorted[0];
+        for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+            size_t rank = (size_t)(percentiles[i] / 100 * n + 0.5);
+            size_t index = rank == 0 ? 0 : rank - 1;
+            result->rtt_ns[i + 1] = sorted[index < n ? index : n - 1];
+        }
+        result->rtt_ns[5] = sorted[n - 1];
+    }
+    free(sorted);
+}
+
+/**
+ * @brief Send one step of commands at a fixed rate and collect the acks
+ */
+static void run_step(int rate, int count, loadgen_result_t *result)
+{
+    memset(s_sent_ns, 0, sizeof(int64_t) * count);
+    memset(s_rtt_ns, 0xFF, sizeof(int64_t) * count);
+    s_count = count;
+    s_replies = s_unmatched = s_duplicates = 0;
+    s_sending_done = false;
+
+    pthread_t receiver;
+    pthread_create(&receiver, NULL, receiver_thread, NULL);
+
+    char datagram[256];
+    int64_t interval_ns = rate > 0 ? 1000000000 / rate : 0;
+    int64_t start_ns = now_ns();
+    s_last_ack_ns = start_ns;
+    for (int seq = 0; seq < count; seq++) {
+        // Open-loop pacing: the schedule does not slip when the door is slow
+        int64_t due_ns = start_ns + seq * interval_ns;
+        int64_t now = now_ns();
+        if (due_ns - now > 2000000) {
+            // Low rates: sleep most of the gap instead of spinning through it
+            struct timespec gap = { 0, due_ns - now - 1000000 };
+            nanosleep(&gap, NULL);
+        }
+        while (now_ns() < due_ns) {
+            ;
+        }
+        int len;
+        if (s_opts.status_acks) {
+            len = snprintf(datagram, sizeof(datagram), LOADGEN_CONTROL_TOPIC "\n\n%s", s_opts.command);
+        } else {
+            len = snprintf(datagram, sizeof(datagram),
+                           LOADGEN_CONTROL_TOPIC "\nresponse-topic:" LOADGEN_REPLY_TOPIC
+                           "\ncorrelation-data:%016x\n\n%s", seq, s_opts.command);
+        }
+        s_sent_ns[seq] = now_ns();
+        sendto(s_sock, datagram, len, 0, (struct sockaddr *)&s_opts.door, sizeof(s_opts.door));
+    }
+    result->send_ns = now_ns() - start_ns;
+    s_sending_done = true;
+    pthread_join(receiver, NULL);
+
+    result->rate = rate;
+    result->sent = count;
+    result->ack_ns = s_last_ack_ns - start_ns;
+    if (result->ack_ns < count * interval_ns) {
+        result->ack_ns = count * interval_ns;
+    }
+    summarise(result);
+}
+
+/**
+ * @brief Acknowledged commands per second over the step
+ */
+static double ack_rate(const loadgen_result_t *result)
+{
+    return result->ack_ns > 0 ? result->acks / (result->ack_ns / 1e9) : 0;
+}
+
+/**
+ * @brief Print a single run in full
+ */
+static void report(const loadgen_result_t *result)
+{
+    printf("sent %d '%s' in %.3f s (%.0f msg/s), acks %zu (%.0f msg/s), lost %zu, duplicates %lu, unmatched %lu\n",
+           result->sent, s_opts.command, result->send_ns / 1e9, result->sent / (result->send_ns / 1e9),
+           result->acks, ack_rate(result), result->sent - result->acks, s_duplicates, s_unmatched);
+    if (result->acks > 0) {
+        printf("rtt us: min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+               result->rtt_ns[0] / 1e3, result->rtt_ns[1] / 1e3, result->rtt_ns[2] / 1e3,
+               result->rtt_ns[3] / 1e3, result->rtt_ns[4] / 1e3, result->rtt_ns[5] / 1e3);
+    }
+}
+
+/**
+ * @brief Print one row of the sweep table
+ */
+static void report_row(const loadgen_result_t *result)
+{
+    printf("%6d %8d %8zu %6zu %8.0f %9.1f %8.1f %8.1f %9.1f %8.1f\n",
+           result->rate, result->sent, result->acks, result->sent - result->acks, ack_rate(result),
+           result->rtt_ns[1] / 1e3, result->rtt_ns[2] / 1e3, result->rtt_ns[3] / 1e3,
+           result->rtt_ns[4] / 1e3, result->rtt_ns[5] / 1e3);
+}
+
+/**
+ * @brief Parse a comma-separated rate list for -R
+ */
+static bool parse_rates(const char *text)
+{
+    s_opts.rate_count = 0;
+    while (*text != '\0') {
+        char *end;
+        long rate = strtol(text, &end, 10);
+        if (end == text || rate < 1 || rate > LOADGEN_MAX_RATE || s_opts.rate_count == LOADGEN_MAX_STEPS ||
+            (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        s_opts.rates[s_opts.rate_count++] = (int)rate;
+        text = *end == ',' ? end + 1 : end;
+    }
+    return s_opts.rate_count > 0;
+}
+
+/**
+ * @brief Commands in a step: count, or rate x duration when -d is given
+ */
+static int step_count(int rate)
+{
+    if (s_opts.duration_ms <= 0) {
+        return s_opts.count;
+    }
+    int64_t count = (int64_t)rate * s_opts.duration_ms / 1000;
+    return count > 0 ? (int)count : 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n count] [-r rate/s, 0 = flood] [-R rate,rate,... (1-%d)] [-d step ms] "
+            "[-s acks on status topic] [-c command] [-t door host:port] [-l listen port] [-w drain ms]\n",
+            prog, LOADGEN_MAX_RATE);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    parse_addr("127.0.0.1:18830", &s_opts.door);
+    while ((opt = getopt(argc, argv, "n:r:R:d:sc:t:l:w:h")) != -1) {
+        switch (opt) {
+        case 'n': s_opts.count = atoi(optarg); break;
+        case 'r': s_opts.rate = atoi(optarg); break;
+        case 'R':
+            if (!parse_rates(optarg)) {
+                fprintf(stderr, "bad rate list %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'd': s_opts.duration_ms = atoi(optarg); break;
+        case 's': s_opts.status_acks = true; break;
+        case 'c': s_opts.command = optarg; break;
+        case 't':
+            if (!parse_addr(optarg, &s_opts.door)) {
+                fprintf(stderr, "bad address %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'l': s_opts.listen_port = atoi(optarg); break;
+        case 'w': s_opts.drain_ms = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (s_opts.count <= 0 || s_opts.rate < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int max_count = s_opts.rate_count ? 0 : step_count(s_opts.rate);
+    for (int i = 0; i < s_opts.rate_count; i++) {
+        int count = step_count(s_opts.rates[i]);
+        max_count = count > max_count ? count : max_count;
+    }
+    s_sent_ns = malloc(sizeof(int64_t) * max_count);
+    s_rtt_ns = malloc(sizeof(int64_t) * max_count);
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)s_opts.listen_port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int rcvbuf = 4 * 1024 * 1024;
+    struct timeval timeout = { .tv_usec = 100000 };
+    setsockopt(s_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    setsockopt(s_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (bind(s_sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    loadgen_result_t result;
+    bool lost = false;
+    if (s_opts.rate_count == 0) {
+        run_step(s_opts.rate, step_count(s_opts.rate), &result);
+        report(&result);
+        lost = result.acks != (size_t)result.sent;
+    } else {
+        printf("'%s', acks on %s\n", s_opts.command,
+               s_opts.status_acks ? LOADGEN_STATUS_TOPIC : LOADGEN_REPLY_TOPIC);
+        printf("  rate     sent     acks  drops    ack/s    p50 us   p90 us   p99 us  p99.9 us   max us\n");
+        for (int i = 0; i < s_opts.rate_count; i++) {
+            run_step(s_opts.rates[i], step_count(s_opts.rates[i]), &result);
+            report_row(&result);
+            fflush(stdout);
+            lost |= result.acks != (size_t)result.sent;
+            usleep(LOADGEN_STEP_PAUSE_MS * 1000);
+        }
+    }
+    close(s_sock);
+    return lost ? 1 : 0;
+}
@@ -0,0 +1,610 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file door_sim.c
+ * @brief Deterministic door plant for closed-loop tests of the control logic
+ *
+ * Links the firmware's door_fsm.c, motor_control.c and door_inputs.c against
+ * a HAL whose clock is virtual and closes the loop through a model of the
+ * mechanism, stepped every millisecond:
+ *
+ *  - gear motor with a linear torque-speed curve, driven by the two relay
+ *    outputs; with both released its shorted winding brakes the leaf
+ *  - leaf mass, Coulomb friction and hard end stops
+ *  - limit switches with contact bounce, raising the input interrupts
+ *  - ultrasonic sensor sampled at CONFIG_DOOR_SENSOR_RATE_HZ with Gaussian
+ *    noise and lost echoes, through the firmware's width-to-mm conversion
+ *    and obstacle hysteresis
+ *  - people stepping into the doorway while the door closes
+ *
+ * An operator opens the door, holds it open and closes it again, cycle
+ * after cycle, feeding inputs and obstacles to the state machine the way
+ * the control task does on the target. While the door rests, time skips to
+ * the next thing due. All randomness comes from one seeded generator, so a
+ * run is reproducible: apart from the wall time line, the output depends on
+ * the options only. Exits with 1 on a fault, both relays energised, a
+ * reversal faster than the relay dead time, or the door closing on a person.
+ *
+ * Build and run:
+ *     cc -std=gnu11 -O2 -Isoftware software/tools/door_sim.c software/door_fsm.c \
+ *        software/motor_control.c software/door_inputs.c -lm -o door_sim
+ *     ./door_sim -n 10000 -p 0.2 -s 1
+ *     ./door_sim -v -n 3                      # with the firmware's log output
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "binlog.h"
+#include "config.h"
+#include "door_fsm.h"
+#include "door_inputs.h"
+#include "motor_control.h"
+#include "sensors.h"
+
+#define TICK_US             1000
+#define DT_S                (TICK_US / 1e6)
+#define SENSOR_PERIOD_US    (1000000 / CONFIG_DOOR_SENSOR_RATE_HZ)
+#define HOLD_OPEN_US        2000000         // operator waits this long before closing, and before opening again
+#define GPIO_COUNT          40
+#define HIST_MS             20000
+#define FAULTS_MAX          100             // give up rather than cycle through faults for ever
+
+// Mechanism: about 5.9 s of travel with no load, close to CONFIG_DOOR_TRAVEL_TIME_MS
+#define TRAVEL_M            1.0
+#define MASS_KG             40.0
+#define STALL_FORCE_N       400.0
+#define FREE_SPEED_MPS      0.2
+#define FRICTION_N          60.0
+#define LIMIT_M             0.003           // switch travel before each end stop
+#define BOUNCE_EDGES_MAX    6
+
+// Ultrasonic sensor across the opening
+#define BACKGROUND_MM       1500            // far jamb
+#define NOISE_MM            8.0             // standard deviation
+#define ECHO_LOSS           0.02            // probability a sample gets no echo
+
+// People, at a position in the opening measured from the closing jamb
+#define PERSON_MIN_M        0.1
+#define PERSON_MAX_M        0.6
+#define PERSON_HALF_M       0.15
+#define PERSON_MARGIN_M     0.2             // nobody steps in front of a leaf closer than this
+#define PERSON_MIN_US       500000
+#define PERSON_MAX_US       3000000
+
+typedef enum {
+    OP_RESTING,                             // closed, opening at s_op_due_us
+    OP_OPENING,
+    OP_HOLDING,                             // open, closing at s_op_due_us
+    OP_CLOSING,
+} operator_state_t;
+
+typedef struct {
+    int pin;
+    bool contact;                           // actuated by the leaf
+    int bounces;                            // edges still to come before the level settles
+    int64_t bounce_us;
+} limit_switch_t;
+
+typedef struct {
+    uint32_t ms[HIST_MS + 1];
+    unsigned long count;
+} histogram_t;
+
+static const char *TAG = "door_sim";
+
+// Virtual HAL
+static int64_t s_now_us;
+static int s_level[GPIO_COUNT];
+static hal_gpio_isr_t s_isr[GPIO_COUNT];
+static void *s_isr_arg[GPIO_COUNT];
+static bool s_notified;
+static int s_control_task;                  // stands in for the hal_task_t handle
+static esp_log_level_t s_log_level = ESP_LOG_ERROR;
+
+// Plant
+static uint64_t s_random;
+static double s_x;                          // opening width
+static double s_v;
+static bool s_relay[2];                     // open, close
+static int64_t s_released_us[2];
+static int s_last_relay = -1;
+static limit_switch_t s_limits[2] = {
+    { .pin = CONFIG_DOOR_LIMIT_OPEN_GPIO },
+    { .pin = CONFIG_DOOR_LIMIT_CLOSED_GPIO },
+};
+static bool s_person;
+static bool s_person_hit;
+static double s_person_m;
+static uint32_t s_person_mm;                // distance from the sensor
+static double s_person_arrive_m;            // steps in when the leaf closes past this; 0 when nobody is coming
+static int64_t s_person_since_us;
+static int64_t s_person_leave_us;
+
+// Control and operator
+static bool s_obstacle;
+static int64_t s_sensor_due_us;
+static int64_t s_control_due_us;
+static operator_state_t s_op;
+static int64_t s_op_due_us;
+static int64_t s_cmd_us;
+static int64_t s_closing_since_us;
+static bool s_reversed;
+static double s_obstacle_p = 0.2;
+
+// Results
+static unsigned long s_cycles;
+static unsigned long s_obstructed;
+static unsigned long s_faults;
+static unsigned long s_overlaps;
+static unsigned long s_collisions;
+static int64_t s_min_dead_us = INT64_MAX;
+static double s_min_clearance_m = TRAVEL_M; // leaf to person
+static histogram_t s_opening;
+static histogram_t s_closing;
+static histogram_t s_reversal;
+
+int64_t hal_time_us(void)
+{
+    return s_now_us;
+}
+
+esp_err_t hal_gpio_config_output(int pin)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Relay outputs: check the interlock and dead time, then drive the motor
+ */
+void hal_gpio_set_level(int pin, int level)
+{
+    int relay = pin == CONFIG_DOOR_RELAY_OPEN_GPIO ? 0 : pin == CONFIG_DOOR_RELAY_CLOSE_GPIO ? 1 : -1;
+    if (relay < 0) {
+        return;
+    }
+    bool on = level == CONFIG_DOOR_RELAY_ACTIVE_LEVEL;
+    if (on && !s_relay[relay]) {
+        if (s_relay[!relay]) {
+            s_overlaps++;
+            ESP_LOGE(TAG, "%.3f s: both relays energised", s_now_us / 1e6);
+        } else if (s_last_relay == !relay && s_now_us - s_released_us[!relay] < s_min_dead_us) {
+            s_min_dead_us = s_now_us - s_released_us[!relay];
+        }
+        s_last_relay = relay;
+    } else if (!on && s_relay[relay]) {
+        s_released_us[relay] = s_now_us;
+    }
+    s_relay[relay] = on;
+}
+
+esp_err_t hal_gpio_config_input(int pin, bool pull_up, hal_gpio_isr_t isr, void *arg)
+{
+    s_isr[pin] = isr;
+    s_isr_arg[pin] = arg;
+    return ESP_OK;
+}
+
+int hal_gpio_get_level(int pin)
+{
+    return s_level[pin];
+}
+
+void hal_task_notify_from_isr(hal_task_t *task)
+{
+    s_notified = true;
+}
+
+void binlog_write(binlog_id_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+}
+
+void hal_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > s_log_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s: ", tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+void hal_abort_on_error(const char *expr, esp_err_t err, const char *file, int line)
+{
+    fprintf(stderr, "%s failed (%d) at %s:%d\n", expr, err, file, line);
+    abort();
+}
+
+static uint64_t random_next(void)
+{
+    // xorshift64*
+    s_random ^= s_random >> 12;
+    s_random ^= s_random << 25;
+    s_random ^= s_random >> 27;
+    return s_random * 0x2545F4914F6CDD1Dull;
+}
+
+static double random_unit(void)
+{
+    return (random_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int64_t random_us(int64_t min_us, int64_t max_us)
+{
+    return min_us + (int64_t)(random_next() % (uint64_t)(max_us - min_us + 1));
+}
+
+static double random_gauss(void)
+{
+    // Box-Muller, one of the pair
+    double u = random_unit();
+    return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * random_unit());
+}
+
+static void histogram_add(histogram_t *hist, int64_t us)
+{
+    int64_t ms = (us + 500) / 1000;
+    hist->ms[ms > HIST_MS ? HIST_MS : ms]++;
+    hist->count++;
+}
+
+static int histogram_percentile(const histogram_t *hist, double pct)
+{
+    unsigned long rank = (unsigned long)ceil(hist->count * pct / 100.0);
+    unsigned long seen = 0;
+    for (int ms = 0; ms <= HIST_MS; ms++) {
+        seen += hist->ms[ms];
+        if (seen >= rank && seen != 0) {
+            return ms;
+        }
+    }
+    return 0;
+}
+
+static void histogram_print(const char *name, const histogram_t *hist)
+{
+    printf("%-9s ms: n %lu p50 %d p99 %d max %d\n", name, hist->count, histogram_percentile(hist, 50),
+           histogram_percentile(hist, 99), histogram_percentile(hist, 100));
+}
+
+/**
+ * @brief Drive an input pin, interrupting on every change like the GPIO edge interrupt
+ */
+static void input_set(int pin, bool active)
+{
+    int level = active ? CONFIG_DOOR_INPUT_ACTIVE_LEVEL : !CONFIG_DOOR_INPUT_ACTIVE_LEVEL;
+    if (s_level[pin] != level) {
+        s_level[pin] = level;
+        if (s_isr[pin] != NULL) {
+            s_isr[pin](s_isr_arg[pin]);
+        }
+    }
+}
+
+/**
+ * @brief One tick of leaf dynamics, switches and the person in the doorway
+ */
+static void plant_step(void)
+{
+    double drive;
+    if (s_relay[0] != s_relay[1]) {
+        double dir = s_relay[0] ? 1.0 : -1.0;
+        drive = dir * STALL_FORCE_N * (1.0 - dir * s_v / FREE_SPEED_MPS);
+    } else {
+        drive = -STALL_FORCE_N / FREE_SPEED_MPS * s_v;
+    }
+    double v = s_v;
+    if (v != 0 || fabs(drive) > FRICTION_N) {
+        double friction = copysign(FRICTION_N, v != 0 ? v : drive);
+        v += (drive - friction) / MASS_KG * DT_S;
+        // Friction and braking stop the leaf within the tick rather than reverse it
+        if (s_v != 0 && (v > 0) != (s_v > 0)) {
+            v = 0;
+        }
+    }
+    s_v = v;
+    s_x += v * DT_S;
+    if (s_x <= 0 || s_x >= TRAVEL_M) {
+        s_x = s_x <= 0 ? 0 : TRAVEL_M;
+        s_v = 0;
+    }
+
+    bool contact[2] = { s_x >= TRAVEL_M - LIMIT_M, s_x <= LIMIT_M };
+    for (int i = 0; i < 2; i++) {
+        limit_switch_t *sw = &s_limits[i];
+        if (contact[i] != sw->contact) {
+            sw->contact = contact[i];
+            input_set(sw->pin, sw->contact);
+            sw->bounces = 2 * (int)(random_next() % (BOUNCE_EDGES_MAX / 2 + 1));
+            sw->bounce_us = s_now_us + TICK_US;
+        } else if (sw->bounces != 0 && s_now_us >= sw->bounce_us) {
+            sw->bounces--;
+            input_set(sw->pin, (sw->bounces & 1) ? !sw->contact : sw->contact);
+            sw->bounce_us = s_now_us + random_us(1, 3) * TICK_US;
+        }
+    }
+
+    if (s_person && s_x - (s_person_m + PERSON_HALF_M) < s_min_clearance_m) {
+        s_min_clearance_m = s_x - (s_person_m + PERSON_HALF_M);
+    }
+    if (s_person && !s_person_hit && s_x < s_person_m + PERSON_HALF_M) {
+        s_person_hit = true;
+        s_collisions++;
+        ESP_LOGE(TAG, "%.3f s: door closed on a person at %.2f m", s_now_us / 1e6, s_person_m);
+    }
+}
+
+/**
+ * @brief People arriving and leaving; who comes is decided when the operator closes the door
+ */
+static void person_step(void)
+{
+    if (!s_person && s_person_arrive_m != 0 && s_x <= s_person_arrive_m) {
+        s_person_arrive_m = 0;
+        s_person = true;
+        s_person_hit = false;
+        s_person_since_us = s_now_us;
+        s_person_leave_us = s_now_us + random_us(PERSON_MIN_US, PERSON_MAX_US);
+        s_obstructed++;
+        ESP_LOGI(TAG, "%.3f s: person at %.2f m, leaf at %.2f m", s_now_us / 1e6, s_person_m, s_x);
+    } else if (s_person && s_now_us >= s_person_leave_us) {
+        s_person = false;
+    }
+}
+
+/**
+ * @brief One ultrasonic sample, handled like handle_sensor_event()
+ */
+static void sensor_sample(void)
+{
+    uint32_t distance_mm = SENSOR_OUT_OF_RANGE;
+    if (random_unit() >= ECHO_LOSS) {
+        double mm = (s_person ? s_person_mm : BACKGROUND_MM) + NOISE_MM * random_gauss();
+        if (mm > 0 && mm <= CONFIG_DOOR_SENSOR_MAX_RANGE_MM) {
+            distance_mm = sensor_width_to_mm((uint32_t)lround(mm / 0.1715));
+        }
+    }
+    bool obstacle = sensor_obstacle(s_obstacle, distance_mm);
+    if (obstacle != s_obstacle) {
+        s_obstacle = obstacle;
+        // Every sensor event wakes the control task, which polls the state machine again
+        s_notified = true;
+        if (obstacle && door_fsm_post(DOOR_EVT_OBSTACLE, s_now_us)) {
+            ESP_LOGI(TAG, "%.3f s: obstacle at %" PRIu32 " mm, reopening", s_now_us / 1e6, distance_mm);
+        }
+    }
+}
+
+/**
+ * @brief Limit switch edges, handled like handle_door_input(), then end_move_at_limit()
+ */
+static void control_run(void)
+{
+    door_input_event_t input;
+    while (door_inputs_next(s_now_us, &input)) {
+        if (!input.active || input.input == DOOR_INPUT_OVERRIDE) {
+            continue;
+        }
+        if (door_input_active(DOOR_INPUT_LIMIT_OPEN) && door_input_active(DOOR_INPUT_LIMIT_CLOSED)) {
+            door_fsm_post(DOOR_EVT_FAULT, s_now_us);
+        } else {
+            door_fsm_post(input.input == DOOR_INPUT_LIMIT_OPEN ? DOOR_EVT_REACHED_OPEN : DOOR_EVT_REACHED_CLOSED,
+                          s_now_us);
+        }
+    }
+    door_state_t state = door_fsm_state();
+    if (state == DOOR_OPENING && door_input_active(DOOR_INPUT_LIMIT_OPEN)) {
+        door_fsm_post(DOOR_EVT_REACHED_OPEN, s_now_us);
+    } else if (state == DOOR_CLOSING && door_input_active(DOOR_INPUT_LIMIT_CLOSED)) {
+        door_fsm_post(DOOR_EVT_REACHED_CLOSED, s_now_us);
+    }
+    uint32_t wait_ms = door_fsm_poll(s_now_us);
+    uint32_t inputs_ms = door_inputs_poll_ms(s_now_us);
+    if (inputs_ms < wait_ms) {
+        wait_ms = inputs_ms;
+    }
+    s_control_due_us = s_now_us + (int64_t)wait_ms * 1000;
+}
+
+static void door_state_changed(door_state_t from, door_state_t to, uint32_t dwell_ms, void *arg)
+{
+    ESP_LOGI(TAG, "%.3f s: %s -> %s", s_now_us / 1e6, door_state_name(from), door_state_name(to));
+    switch (to) {
+    case DOOR_CLOSING:
+        s_closing_since_us = s_now_us;
+        break;
+    case DOOR_OPENING:
+        if (from == DOOR_CLOSING) {
+            s_reversed = true;
+            if (s_person) {
+                // From the leaf closing towards the person, who may have stepped in first
+                int64_t since_us = s_person_since_us > s_closing_since_us ? s_person_since_us : s_closing_since_us;
+                histogram_add(&s_reversal, s_now_us - since_us);
+            }
+            s_op = OP_OPENING;
+        }
+        break;
+    case DOOR_OPEN:
+        if (s_op == OP_OPENING) {
+            if (!s_reversed) {
+                histogram_add(&s_opening, s_now_us - s_cmd_us);
+            }
+            s_op = OP_HOLDING;
+            s_op_due_us = s_now_us + HOLD_OPEN_US;
+        }
+        break;
+    case DOOR_CLOSED:
+        if (s_op == OP_CLOSING) {
+            if (!s_reversed) {
+                histogram_add(&s_closing, s_now_us - s_cmd_us);
+            }
+            s_cycles++;
+            s_op = OP_RESTING;
+            s_op_due_us = s_now_us + HOLD_OPEN_US;
+        }
+        break;
+    case DOOR_FAULT:
+        s_faults++;
+        ESP_LOGE(TAG, "%.3f s: fault from %s at %.3f m", s_now_us / 1e6, door_state_name(from), s_x);
+        s_op = OP_RESTING;
+        s_op_due_us = s_now_us + HOLD_OPEN_US;
+        break;
+    default:
+        break;
+    }
+}
+
+static void post(door_event_t event)
+{
+    door_fsm_post(event, s_now_us);
+    s_notified = true;
+}
+
+/**
+ * @brief Open, hold, close and rest again; a person may step in during the first close of a cycle
+ */
+static void operator_step(void)
+{
+    if (s_now_us < s_op_due_us) {
+        return;
+    }
+    switch (s_op) {
+    case OP_RESTING:
+        if (door_fsm_state() == DOOR_FAULT) {
+            post(DOOR_EVT_STOP);
+        }
+        s_reversed = false;
+        s_cmd_us = s_now_us;
+        s_op = OP_OPENING;
+        s_op_due_us = INT64_MAX;
+        post(DOOR_EVT_OPEN);
+        break;
+    case OP_HOLDING:
+        if (s_obstacle) {
+            // The close command is refused while something is in the doorway
+            s_op_due_us = s_now_us + SENSOR_PERIOD_US;
+            break;
+        }
+        if (!s_reversed && random_unit() < s_obstacle_p) {
+            s_person_m = PERSON_MIN_M + (PERSON_MAX_M - PERSON_MIN_M) * random_unit();
+            double nearest_m = s_person_m + PERSON_HALF_M + PERSON_MARGIN_M;
+            s_person_arrive_m = nearest_m + (TRAVEL_M - nearest_m) * random_unit();
+            s_person_mm = (uint32_t)random_us(100, CONFIG_DOOR_OBSTACLE_MM - 50);
+        }
+        s_cmd_us = s_now_us;
+        s_op = OP_CLOSING;
+        s_op_due_us = INT64_MAX;
+        post(DOOR_EVT_CLOSE);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Earliest time anything but the leaf needs a step, if the leaf is at rest
+ */
+static int64_t next_event_us(void)
+{
+    if (s_v != 0 || s_relay[0] || s_relay[1] || s_limits[0].bounces != 0 || s_limits[1].bounces != 0 ||
+        s_notified) {
+        return s_now_us;
+    }
+    int64_t next = s_sensor_due_us;
+    int64_t due[] = { s_control_due_us, s_op_due_us, s_person ? s_person_leave_us : INT64_MAX };
+    for (size_t i = 0; i < sizeof(due) / sizeof(due[0]); i++) {
+        if (due[i] < next) {
+            next = due[i];
+        }
+    }
+    return (next + TICK_US - 1) / TICK_US * TICK_US;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long cycles = 1000;
+    unsigned long long seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:s:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            cycles = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            s_obstacle_p = strtod(optarg, NULL);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'v':
+            s_log_level = ESP_LOG_INFO;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n cycles] [-p obstacle probability] [-s seed] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    s_random = seed * 0x9E3779B97F4A7C15ull + 1;
+
+    // Closed door at rest, nobody around
+    for (int pin = 0; pin < GPIO_COUNT; pin++) {
+        s_level[pin] = !CONFIG_DOOR_INPUT_ACTIVE_LEVEL;
+    }
+    s_limits[1].contact = true;
+    s_level[CONFIG_DOOR_LIMIT_CLOSED_GPIO] = CONFIG_DOOR_INPUT_ACTIVE_LEVEL;
+    s_released_us[0] = s_released_us[1] = -(int64_t)CONFIG_DOOR_RELAY_DEAD_TIME_MS * 1000;
+    ESP_ERROR_CHECK(motor_init());
+    ESP_ERROR_CHECK(door_inputs_init());
+    door_inputs_set_consumer((hal_task_t *)&s_control_task);
+    ESP_ERROR_CHECK(door_fsm_init(DOOR_CLOSED, 0, door_state_changed, NULL));
+    s_op = OP_RESTING;
+    control_run();
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (s_cycles < cycles && s_faults < FAULTS_MAX) {
+        s_now_us += TICK_US;
+        int64_t next = next_event_us();
+        if (next > s_now_us) {
+            s_now_us = next;
+        }
+        plant_step();
+        person_step();
+        if (s_now_us >= s_sensor_due_us) {
+            sensor_sample();
+            s_sensor_due_us += SENSOR_PERIOD_US;
+        }
+        operator_step();
+        if (s_notified || s_now_us >= s_control_due_us) {
+            s_notified = false;
+            control_run();
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double wall_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    double sim_s = s_now_us / 1e6;
+    uint32_t bounces, overflows;
+    door_inputs_counters(&bounces, &overflows);
+    printf("cycles %lu, obstructed %lu, seed %llu, %.1f s simulated\n", s_cycles, s_obstructed, seed, sim_s);
+    histogram_print("opening", &s_opening);
+    histogram_print("closing", &s_closing);
+    histogram_print("reversal", &s_reversal);
+    printf("relay dead time min %" PRId64 " ms, configured %d ms\n",
+           s_min_dead_us == INT64_MAX ? 0 : s_min_dead_us / 1000, CONFIG_DOOR_RELAY_DEAD_TIME_MS);
+    printf("clearance min %.0f mm\n", s_obstructed != 0 ? s_min_clearance_m * 1000 : 0);
+    printf("input bounces %" PRIu32 ", overflows %" PRIu32 "\n", bounces, overflows);
+    printf("faults %lu, relay overlaps %lu, collisions %lu\n", s_faults, s_overlaps, s_collisions);
+    printf("wall %.3f s, %.0f cycles/s, %.0fx real time\n", wall_s, s_cycles / wall_s, sim_s / wall_s);
+
+    bool dead_time_ok = s_min_dead_us >= (int64_t)CONFIG_DOOR_RELAY_DEAD_TIME_MS * 1000;
+    return s_faults == 0 && s_overlaps == 0 && s_collisions == 0 && dead_time_ok ? 0 : 1;
+}
@@ -0,0 +1,331 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file journal_query.c
+ * @brief Queries over door event journals exported from flash
+ *
+ * Maps each file read-only and answers in one pass over the records:
+ * events per hour of uptime, mean cycle time (leaving closed to closed
+ * again) and how often obstructions and faults occur. Every file is one
+ * journal, either a partition image, where the oldest record follows the
+ * newest, or records already in order. Erased slots and records failing
+ * their CRC are skipped.
+ *
+ * Build and run:
+ *     cc -std=gnu11 -O2 -Isoftware software/tools/journal_query.c -o journal_query
+ *     parttool.py read_partition --partition-name journal --output journal.bin
+ *     ./journal_query journal.bin [more.bin ...]
+ *     ./journal_query -H journal.bin          # also events per hour of each boot
+ *     ./journal_query -g 4000000 synth.bin    # write a synthetic journal to time queries on
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "crc16.h"
+#include "door_fsm.h"
+#include "journal.h"
+
+#define MS_PER_HOUR     3600000.0
+
+typedef struct {
+    unsigned long records;
+    unsigned long torn;
+    unsigned long boots;
+    unsigned long events;           // state changes and obstructions
+    unsigned long cycles;
+    unsigned long obstructions;
+    unsigned long faults;
+    double cycle_ms;                // sum
+    double uptime_ms;               // sum over boots of first to last record
+} stats_t;
+
+// Two bytes per step: s_crc_hi[x] is the CRC of byte x followed by a zero byte, s_crc_lo[x] of byte x
+static uint16_t s_crc_hi[256];
+static uint16_t s_crc_lo[256];
+static stats_t s_stats;
+static bool s_hourly;
+
+static void crc_table_init(void)
+{
+    for (unsigned i = 0; i < 256; i++) {
+        uint8_t bytes[2] = { (uint8_t)i, 0 };
+        s_crc_hi[i] = crc16_ccitt(0, bytes, 2);
+        s_crc_lo[i] = crc16_ccitt(0, bytes, 1);
+    }
+}
+
+static bool record_valid(const journal_record_t *rec)
+{
+    if (rec->seq == JOURNAL_SEQ_ERASED) {
+        return false;
+    }
+    const uint8_t *bytes = (const uint8_t *)rec;
+    uint16_t crc = CRC16_INIT;
+    for (size_t i = 0; i < offsetof(journal_record_t, crc); i += 2) {
+        crc ^= (uint16_t)(bytes[i] << 8 | bytes[i + 1]);
+        crc = s_crc_hi[crc >> 8] ^ s_crc_lo[crc & 0xFF];
+    }
+    return crc == rec->crc;
+}
+
+// Position in one journal while walking it
+typedef struct {
+    const char *name;
+    bool in_boot;
+    uint16_t boot;
+    uint32_t last_ms;
+    uint64_t boot_ms;               // uptime covered so far in this boot, across time_ms wraps
+    bool cycling;
+    uint64_t cycle_start_ms;
+    uint64_t hour;
+    unsigned long hour_events;
+} walk_t;
+
+static void hour_done(walk_t *walk)
+{
+    if (s_hourly && walk->hour_events != 0) {
+        printf("%s boot %u hour %" PRIu64 ": %lu events\n", walk->name, walk->boot, walk->hour, walk->hour_events);
+    }
+    walk->hour_events = 0;
+}
+
+static void boot_done(walk_t *walk)
+{
+    if (walk->in_boot) {
+        s_stats.uptime_ms += (double)walk->boot_ms;
+        hour_done(walk);
+    }
+}
+
+static void walk_records(walk_t *walk, const journal_record_t *rec, const journal_record_t *end)
+{
+    for (; rec < end; rec++) {
+        if (rec->seq == JOURNAL_SEQ_ERASED) {
+            continue;
+        }
+        if (!record_valid(rec)) {
+            s_stats.torn++;
+            continue;
+        }
+        s_stats.records++;
+        if (!walk->in_boot || rec->boot != walk->boot || rec->event == JOURNAL_BOOT) {
+            boot_done(walk);
+            walk->in_boot = true;
+            walk->boot = rec->boot;
+            walk->last_ms = rec->time_ms;
+            walk->boot_ms = 0;
+            walk->cycling = false;
+            walk->hour = 0;
+            s_stats.boots++;
+        }
+        // Unsigned difference, so the 49-day wrap of time_ms is harmless
+        walk->boot_ms += (uint32_t)(rec->time_ms - walk->last_ms);
+        walk->last_ms = rec->time_ms;
+        if (rec->event == JOURNAL_BOOT) {
+            continue;
+        }
+        if (walk->boot_ms / 3600000 != walk->hour) {
+            hour_done(walk);
+            walk->hour = walk->boot_ms / 3600000;
+        }
+        walk->hour_events++;
+        s_stats.events++;
+        if (rec->event == JOURNAL_OBSTRUCTION) {
+            s_stats.obstructions++;
+            continue;
+        }
+        door_state_t from = rec->state >> 4;
+        door_state_t to = rec->state & 0x0F;
+        if (from == DOOR_CLOSED) {
+            walk->cycling = true;
+            walk->cycle_start_ms = walk->boot_ms;
+        } else if (to == DOOR_CLOSED && walk->cycling) {
+            s_stats.cycles++;
+            s_stats.cycle_ms += (double)(walk->boot_ms - walk->cycle_start_ms);
+            walk->cycling = false;
+        }
+        if (to == DOOR_FAULT) {
+            s_stats.faults++;
+        }
+    }
+}
+
+/**
+ * @brief Walk one journal in sequence order, starting at its oldest record
+ */
+static void query(const char *name, const journal_record_t *recs, size_t count)
+{
+    size_t start = 0;
+    uint32_t oldest = JOURNAL_SEQ_ERASED;
+    for (size_t i = 0; i < count; i++) {
+        if (recs[i].seq < oldest) {
+            oldest = recs[i].seq;
+            start = i;
+        }
+    }
+    walk_t walk = { .name = name };
+    walk_records(&walk, recs + start, recs + count);
+    walk_records(&walk, recs, recs + start);
+    boot_done(&walk);
+}
+
+static uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/**
+ * @brief Write count records of door cycles, 1 % obstructed and 0.1 % faulting
+ */
+static int generate(const char *path, size_t count)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)(count * sizeof(journal_record_t))) != 0) {
+        perror(path);
+        return 1;
+    }
+    journal_record_t *recs = mmap(NULL, count * sizeof(journal_record_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (recs == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+
+    uint32_t random = 0x2545F491;
+    uint32_t time_ms = 0;
+    uint16_t boot = 0;
+    door_state_t state = DOOR_CLOSED;
+    for (size_t i = 0; i < count; i++) {
+        journal_record_t rec = { .seq = (uint32_t)i + 1, .boot = boot };
+        if (i % 100000 == 0) {
+            // A reboot every 100k records, into a closed door; time_ms wraps within some boots
+            rec.boot = ++boot;
+            time_ms = 0;
+            state = DOOR_CLOSED;
+            rec.event = JOURNAL_BOOT;
+            rec.state = state;
+        } else if (recs[i - 1].event == JOURNAL_STATE && recs[i - 1].state == (DOOR_CLOSING << 4 | DOOR_OPENING)) {
+            // Reversed by an obstacle, which is recorded after the state change as on the door
+            rec.event = JOURNAL_OBSTRUCTION;
+            rec.state = DOOR_OPENING;
+            rec.value = (uint16_t)(50 + xorshift32(&random) % 250);
+        } else {
+            uint32_t roll = xorshift32(&random) % 1000;
+            uint32_t dwell_ms;
+            door_state_t next;
+            switch (state) {
+            case DOOR_CLOSED:
+                dwell_ms = 20000 + xorshift32(&random) % 600000;
+                next = DOOR_OPENING;
+                break;
+            case DOOR_OPENING:
+                dwell_ms = 5800 + xorshift32(&random) % 400;
+                next = roll == 0 ? DOOR_FAULT : DOOR_OPEN;
+                break;
+            case DOOR_OPEN:
+                dwell_ms = 5000 + xorshift32(&random) % 10000;
+                next = DOOR_CLOSING;
+                break;
+            case DOOR_CLOSING:
+                dwell_ms = 2000 + xorshift32(&random) % 4200;
+                next = roll < 10 ? DOOR_OPENING : DOOR_CLOSED;
+                break;
+            default:
+                dwell_ms = 30000;
+                next = DOOR_CLOSED;
+                break;
+            }
+            time_ms += dwell_ms;
+            rec.event = JOURNAL_STATE;
+            rec.state = (uint8_t)(state << 4 | next);
+            rec.value = (uint16_t)dwell_ms;
+            state = next;
+        }
+        rec.time_ms = time_ms;
+        rec.crc = crc16_ccitt(CRC16_INIT, &rec, offsetof(journal_record_t, crc));
+        recs[i] = rec;
+    }
+    munmap(recs, count * sizeof(journal_record_t));
+    printf("%zu records written to %s\n", count, path);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    crc_table_init();
+    int opt;
+    size_t generate_count = 0;
+    while ((opt = getopt(argc, argv, "g:H")) != -1) {
+        switch (opt) {
+        case 'g':
+            generate_count = strtoul(optarg, NULL, 0);
+            break;
+        case 'H':
+            s_hourly = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-H] journal.bin...\n       %s -g <records> out.bin\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "no journal given\n");
+        return 2;
+    }
+    if (generate_count != 0) {
+        return generate(argv[optind], generate_count);
+    }
+
+    struct timespec t0, t1;
+    size_t bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = optind; i < argc; i++) {
+        int fd = open(argv[i], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            perror(argv[i]);
+            return 1;
+        }
+        size_t count = (size_t)st.st_size / sizeof(journal_record_t);
+        if (count == 0) {
+            close(fd);
+            continue;
+        }
+        const journal_record_t *recs = mmap(NULL, count * sizeof(journal_record_t), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (recs == MAP_FAILED) {
+            perror(argv[i]);
+            return 1;
+        }
+        madvise((void *)recs, count * sizeof(journal_record_t), MADV_SEQUENTIAL);
+        query(argv[i], recs, count);
+        munmap((void *)recs, count * sizeof(journal_record_t));
+        bytes += count * sizeof(journal_record_t);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double hours = s_stats.uptime_ms / MS_PER_HOUR;
+    double per_100_cycles = s_stats.cycles != 0 ? 100.0 / s_stats.cycles : 0;
+    printf("records %lu valid, %lu torn, %lu boots, %.2f h of uptime\n",
+           s_stats.records, s_stats.torn, s_stats.boots, hours);
+    printf("events %lu, %.1f per hour\n", s_stats.events, hours > 0 ? s_stats.events / hours : 0);
+    printf("cycles %lu, mean %.1f ms\n", s_stats.cycles, s_stats.cycles != 0 ? s_stats.cycle_ms / s_stats.cycles : 0);
+    printf("obstructions %lu, %.2f per 100 cycles\n", s_stats.obstructions, s_stats.obstructions * per_100_cycles);
+    printf("faults %lu, %.2f per 100 cycles, %.3f per hour\n", s_stats.faults, s_stats.faults * per_100_cycles,
+           hours > 0 ? s_stats.faults / hours : 0);
+    printf("query %.3f ms over %zu bytes\n",
+           (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6, bytes);
+    return 0;
+}